@@ -9,7 +9,7 @@ REM Try g++
 where g++ >nul 2>&1
 if %errorlevel% == 0 (
     echo Found g++ compiler
-    g++ -std=c++11 -Wall -Wextra -O2 -o restaurant_simulation.exe restaurant_simulation.cpp
+    g++ -std=c++11 -Wall -Wextra -O2 -pthread -o restaurant_simulation.exe restaurant_simulation.cpp
     if %errorlevel% == 0 (
         echo Compilation successful with g++
         echo Run with: restaurant_simulation.exe
@@ -21,7 +21,7 @@ REM Try clang++
 where clang++ >nul 2>&1
 if %errorlevel% == 0 (
     echo Found clang++ compiler
-    clang++ -std=c++11 -Wall -Wextra -O2 -o restaurant_simulation.exe restaurant_simulation.cpp
+    clang++ -std=c++11 -Wall -Wextra -O2 -pthread -o restaurant_simulation.exe restaurant_simulation.cpp
     if %errorlevel% == 0 (
         echo Compilation successful with clang++
         echo Run with: restaurant_simulation.exe
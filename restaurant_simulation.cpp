@@ -9,54 +9,241 @@
 #include <chrono>
 #include <ctime>
 #include <sstream>
+#include <fstream>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cerrno>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESTAURANT_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <signal.h>
+#endif
 
 using namespace std;
 
 // Forward declarations
 class Waiter;
 class Order;
+class RestaurantSnapshot;
+
+// Horizontal rule for report tables: writes the fill characters straight to
+// the stream instead of building a temporary string on every report call
+struct Rule {
+    int width;
+    char ch;
+    
+    Rule(int w, char c) : width(w), ch(c) {}
+};
+
+inline ostream& operator<<(ostream& os, const Rule& rule) {
+    char fill = os.fill(rule.ch);
+    os << setw(rule.width) << "";
+    os.fill(fill);
+    return os;
+}
 
-// Timestamp class for order tracking
+// Timestamp class for order tracking: wall-clock seconds since 01/01/1970
+// 00:00:00 (no timezone applied) packed into a single 64-bit value
 class Timestamp {
 private:
-    int year, month, day, hour, minute, second;
+    int64_t seconds;
+    
+    constexpr explicit Timestamp(int64_t secs) : seconds(secs) {}
+    
+    static constexpr int64_t floorDiv(int64_t a, int64_t b) {
+        return a / b - (a % b < 0 ? 1 : 0);
+    }
+    
+    // Civil calendar conversion (Howard Hinnant's days_from_civil and its
+    // inverse) split into single-expression steps so it stays constexpr in C++11
+    static constexpr int64_t eraStart(int64_t y) { return floorDiv(y, 400); }
+    static constexpr int64_t dayOfEraFromCivil(int64_t yoe, int m, int d) {
+        return yoe * 365 + yoe / 4 - yoe / 100 + (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    }
+    static constexpr int64_t daysFromShiftedCivil(int64_t y, int m, int d) {
+        return eraStart(y) * 146097 + dayOfEraFromCivil(y - eraStart(y) * 400, m, d) - 719468;
+    }
+    static constexpr int64_t shiftedDays(int64_t days) { return days + 719468; }
+    static constexpr int64_t dayOfEra(int64_t z) { return z - floorDiv(z, 146097) * 146097; }
+    static constexpr int64_t yearOfEra(int64_t doe) { return (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; }
+    static constexpr int64_t dayOfYear(int64_t doe) {
+        return doe - (365 * yearOfEra(doe) + yearOfEra(doe) / 4 - yearOfEra(doe) / 100);
+    }
+    static constexpr int64_t marchMonth(int64_t doe) { return (5 * dayOfYear(doe) + 2) / 153; } // March is 0
+    
+    constexpr int64_t dayNumber() const { return floorDiv(seconds, 86400); }
+    constexpr int64_t secondOfDay() const { return seconds - dayNumber() * 86400; }
+    constexpr int64_t doe() const { return dayOfEra(shiftedDays(dayNumber())); }
+    
+    static char* writeTwoDigits(char* out, int value) {
+        out[0] = static_cast<char>('0' + value / 10);
+        out[1] = static_cast<char>('0' + value % 10);
+        return out + 2;
+    }
+    
+    static char* writeYear(char* out, int year) {
+        if (year >= 0 && year <= 9999) {
+            out = writeTwoDigits(out, year / 100);
+            return writeTwoDigits(out, year % 100);
+        }
+        return out + sprintf(out, "%d", year);
+    }
+    
+    // Local wall-clock time for a UTC time_t. The local UTC offset is cached per
+    // thread until the next hour boundary, so bursts of orders do not each call localtime
+    static int64_t localSeconds(time_t utc) {
+        static thread_local int64_t offset = 0;
+        static thread_local time_t validFrom = 1;
+        static thread_local time_t validUntil = 0;
+        if (utc < validFrom || utc >= validUntil) {
+            tm info;
+            #ifdef _WIN32
+                localtime_s(&info, &utc);
+            #else
+                localtime_r(&utc, &info);
+            #endif
+            int64_t local = daysFromCivil(info.tm_year + 1900, info.tm_mon + 1, info.tm_mday) * 86400 +
+                            info.tm_hour * 3600 + info.tm_min * 60 + info.tm_sec;
+            offset = local - static_cast<int64_t>(utc);
+            validFrom = utc - utc % 3600;
+            validUntil = validFrom + 3600;
+        }
+        return static_cast<int64_t>(utc) + offset;
+    }
 
 public:
-    Timestamp() {
-        auto now = chrono::system_clock::now();
-        auto time_t = chrono::system_clock::to_time_t(now);
-        tm* timeinfo = localtime(&time_t);
-        
-        year = timeinfo->tm_year + 1900;
-        month = timeinfo->tm_mon + 1;
-        day = timeinfo->tm_mday;
-        hour = timeinfo->tm_hour;
-        minute = timeinfo->tm_min;
-        second = timeinfo->tm_sec;
-    }
+    // Buffer size that fits any formatted timestamp, including the terminator
+    static const size_t FORMAT_BUFFER_SIZE = 32;
+    
+    // Current local time
+    Timestamp() : seconds(localSeconds(chrono::system_clock::to_time_t(chrono::system_clock::now()))) {}
     
     // Constructor for simulated timestamps
-    Timestamp(int y, int m, int d, int h, int min, int s) 
-        : year(y), month(m), day(d), hour(h), minute(min), second(s) {}
+    constexpr Timestamp(int y, int m, int d, int h, int min, int s) 
+        : seconds(daysFromCivil(y, m, d) * 86400 + h * 3600 + min * 60 + s) {}
+    
+    static constexpr Timestamp fromEpochSeconds(int64_t secs) { return Timestamp(secs); }
+    constexpr int64_t toEpochSeconds() const { return seconds; }
+    
+    constexpr int getYear() const {
+        return static_cast<int>(yearOfEra(doe()) + floorDiv(shiftedDays(dayNumber()), 146097) * 400 + (getMonth() <= 2));
+    }
+    constexpr int getMonth() const {
+        return static_cast<int>(marchMonth(doe()) < 10 ? marchMonth(doe()) + 3 : marchMonth(doe()) - 9);
+    }
+    constexpr int getDay() const {
+        return static_cast<int>(dayOfYear(doe()) - (153 * marchMonth(doe()) + 2) / 5 + 1);
+    }
+    constexpr int64_t getDayNumber() const { return dayNumber(); } // days since 1970-01-01
+    constexpr int getHour() const { return static_cast<int>(secondOfDay() / 3600); }
+    constexpr int getMinute() const { return static_cast<int>(secondOfDay() / 60 % 60); }
+    constexpr int getSecond() const { return static_cast<int>(secondOfDay() % 60); }
+    
+    // The format functions write into a caller-provided buffer of at least
+    // FORMAT_BUFFER_SIZE bytes, NUL-terminate it and return the end of the text
+    char* formatTimeTo(char* out) const {
+        out = writeTwoDigits(out, getHour());
+        *out++ = ':';
+        out = writeTwoDigits(out, getMinute());
+        *out++ = ':';
+        out = writeTwoDigits(out, getSecond());
+        *out = '\0';
+        return out;
+    }
+    
+    char* formatDateTo(char* out) const {
+        int y, m, d;
+        civilFromDays(dayNumber(), y, m, d);
+        out = writeTwoDigits(out, d);
+        *out++ = '/';
+        out = writeTwoDigits(out, m);
+        *out++ = '/';
+        out = writeYear(out, y);
+        *out = '\0';
+        return out;
+    }
+    
+    // "DD/MM/YYYY HH:MM:SS"
+    char* formatTo(char* out) const {
+        out = formatDateTo(out);
+        *out++ = ' ';
+        return formatTimeTo(out);
+    }
+    
+    // ISO 8601 "YYYY-MM-DDTHH:MM:SS" for machine-readable output
+    char* formatIsoTo(char* out) const {
+        int y, m, d;
+        civilFromDays(dayNumber(), y, m, d);
+        out = writeYear(out, y);
+        *out++ = '-';
+        out = writeTwoDigits(out, m);
+        *out++ = '-';
+        out = writeTwoDigits(out, d);
+        *out++ = 'T';
+        return formatTimeTo(out);
+    }
     
     string toString() const {
-        stringstream ss;
-        ss << setfill('0') << setw(2) << day << "/" 
-           << setw(2) << month << "/" << year << " "
-           << setw(2) << hour << ":" << setw(2) << minute << ":" << setw(2) << second;
-        return ss.str();
+        char buffer[FORMAT_BUFFER_SIZE];
+        return string(buffer, formatTo(buffer));
     }
     
     string toTimeString() const {
-        stringstream ss;
-        ss << setfill('0') << setw(2) << hour << ":" << setw(2) << minute << ":" << setw(2) << second;
-        return ss.str();
+        char buffer[FORMAT_BUFFER_SIZE];
+        return string(buffer, formatTimeTo(buffer));
     }
     
     string toDateString() const {
-        stringstream ss;
-        ss << setfill('0') << setw(2) << day << "/" << setw(2) << month << "/" << year;
-        return ss.str();
+        char buffer[FORMAT_BUFFER_SIZE];
+        return string(buffer, formatDateTo(buffer));
+    }
+    
+    // Day number relative to 01/01/1970 for a proleptic Gregorian date
+    static constexpr int64_t daysFromCivil(int y, int m, int d) {
+        return daysFromShiftedCivil(y - (m <= 2), m, d);
+    }
+    
+    static constexpr bool isLeapYear(int y) {
+        return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    }
+    
+    static constexpr int daysInMonth(int y, int m) {
+        return m == 2 ? (isLeapYear(y) ? 29 : 28) : (m == 4 || m == 6 || m == 9 || m == 11) ? 30 : 31;
+    }
+    
+    static void civilFromDays(int64_t days, int& y, int& m, int& d) {
+        const int64_t z = shiftedDays(days);
+        const int64_t dayInEra = dayOfEra(z);
+        const int64_t mp = marchMonth(dayInEra);
+        d = static_cast<int>(dayOfYear(dayInEra) - (153 * mp + 2) / 5 + 1);
+        m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+        y = static_cast<int>(yearOfEra(dayInEra) + floorDiv(z, 146097) * 400 + (m <= 2));
     }
 };
 
@@ -82,492 +269,9171 @@ private:
 
 public:
     Patron(string n, PatronType t, int size = 1, bool sitIn = true) 
-        : name(n), type(t), groupSize(size), isSitIn(sitIn) {}
+        : name(move(n)), type(t), groupSize(size), isSitIn(sitIn) {}
     
-    string getName() const { return name; }
+    const string& getName() const { return name; }
     PatronType getType() const { return type; }
     int getGroupSize() const { return groupSize; }
     bool isSitInOrder() const { return isSitIn; }
     
-    string getTypeString() const {
+    const char* getTypeString() const {
         return (type == PatronType::INDIVIDUAL) ? "Individual" : "Group";
     }
 };
 
-// Order class
-class Order {
+// Compensated (Kahan) running sum so that millions of small additions do not drift
+class KahanSum {
 private:
-    int orderId;
-    shared_ptr<Patron> patron;
-    OrderType type;
-    double totalAmount;
-    shared_ptr<Waiter> waiter;
-    string items;
-    Timestamp timestamp;
+    double sum;
+    double compensation;
 
 public:
-    Order(int id, shared_ptr<Patron> p, OrderType ot, double amount, shared_ptr<Waiter> w, string orderItems)
-        : orderId(id), patron(p), type(ot), totalAmount(amount), waiter(w), items(orderItems), timestamp() {}
-    
-    // Constructor with custom timestamp for simulation
-    Order(int id, shared_ptr<Patron> p, OrderType ot, double amount, shared_ptr<Waiter> w, string orderItems, Timestamp ts)
-        : orderId(id), patron(p), type(ot), totalAmount(amount), waiter(w), items(orderItems), timestamp(ts) {}
-    
-    int getOrderId() const { return orderId; }
-    shared_ptr<Patron> getPatron() const { return patron; }
-    OrderType getType() const { return type; }
-    double getTotalAmount() const { return totalAmount; }
-    shared_ptr<Waiter> getWaiter() const { return waiter; }
-    string getItems() const { return items; }
-    Timestamp getTimestamp() const { return timestamp; }
+    KahanSum() : sum(0.0), compensation(0.0) {}
     
-    string getTypeString() const {
-        return (type == OrderType::SIT_IN) ? "Sit-in" : "Take-out";
+    void add(double value) {
+        double y = value - compensation;
+        double t = sum + y;
+        compensation = (t - sum) - y;
+        sum = t;
     }
+    
+    double value() const { return sum; }
 };
 
-// Waiter class
-class Waiter {
+// Read-only view of bytes owned elsewhere, e.g. a name in PatronStore's arena
+class StringRef {
 private:
-    int waiterId;
-    string name;
-    vector<shared_ptr<Order>> orders;
+    const char* bytes;
+    size_t length;
 
 public:
-    Waiter(int id, string n) : waiterId(id), name(n) {}
+    StringRef(const char* data, size_t size) : bytes(data), length(size) {}
+    StringRef(const string& s) : bytes(s.data()), length(s.size()) {}
+    StringRef(const char* s) : bytes(s), length(strlen(s)) {}
     
-    int getWaiterId() const { return waiterId; }
-    string getName() const { return name; }
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+    char operator[](size_t i) const { return bytes[i]; }
+    string str() const { return string(bytes, length); }
+    StringRef substr(size_t pos, size_t n) const { return StringRef(bytes + pos, min(n, length - pos)); }
     
-    void addOrder(shared_ptr<Order> order) {
-        orders.push_back(order);
+    bool operator==(const StringRef& other) const {
+        return length == other.length && memcmp(bytes, other.bytes, length) == 0;
     }
-    
-    double getTotalSales() const {
-        double total = 0.0;
-        for (const auto& order : orders) {
-            total += order->getTotalAmount();
+    bool operator!=(const StringRef& other) const { return !(*this == other); }
+};
+
+// Honours setw() and left/right like a string, without copying into one
+ostream& operator<<(ostream& os, const StringRef& s) {
+    ostream::sentry guard(os);
+    if (guard) {
+        streamsize padding = max<streamsize>(0, os.width() - static_cast<streamsize>(s.size()));
+        bool alignLeft = (os.flags() & ios::adjustfield) == ios::left;
+        streambuf* buffer = os.rdbuf();
+        bool ok = true;
+        for (streamsize i = 0; ok && !alignLeft && i < padding; i++) {
+            ok = buffer->sputc(os.fill()) != EOF;
         }
-        return total;
+        ok = ok && buffer->sputn(s.data(), static_cast<streamsize>(s.size())) == static_cast<streamsize>(s.size());
+        for (streamsize i = 0; ok && alignLeft && i < padding; i++) {
+            ok = buffer->sputc(os.fill()) != EOF;
+        }
+        if (!ok) {
+            os.setstate(ios::badbit);
+        }
+    }
+    os.width(0);
+    return os;
+}
+
+#ifdef RESTAURANT_X86_DISPATCH
+// SSE4.2 has a CRC-32C instruction; crc32c() picks it at run time
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(const void* data, size_t length, uint32_t crc) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    #ifdef __x86_64__
+        uint64_t wide = crc;
+        while (length >= 8) {
+            uint64_t word;
+            memcpy(&word, p, 8);
+            wide = _mm_crc32_u64(wide, word);
+            p += 8;
+            length -= 8;
+        }
+        crc = static_cast<uint32_t>(wide);
+    #endif
+    while (length >= 4) {
+        uint32_t word;
+        memcpy(&word, p, 4);
+        crc = _mm_crc32_u32(crc, word);
+        p += 4;
+        length -= 4;
+    }
+    while (length-- > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
     }
+    return ~crc;
+}
+#endif
+
+// Lookup tables for the slice-by-8 software CRC-32C
+struct Crc32cTables {
+    uint32_t slices[8][256];
+};
+
+// CRC-32C (Castagnoli): hardware when available, otherwise slice-by-8
+uint32_t crc32c(const void* data, size_t length, uint32_t crc = 0) {
+    #ifdef RESTAURANT_X86_DISPATCH
+        static const bool hardware = __builtin_cpu_supports("sse4.2");
+        if (hardware) {
+            return crc32cHardware(data, length, crc);
+        }
+    #endif
+
+    // A local static is initialised exactly once even when threads race here
+    static const Crc32cTables tables = [] {
+        Crc32cTables built;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value >> 1) ^ (0x82F63B78u & (0u - (value & 1)));
+            }
+            built.slices[0][i] = value;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int slice = 1; slice < 8; slice++) {
+                built.slices[slice][i] = (built.slices[slice - 1][i] >> 8) ^
+                                         built.slices[0][built.slices[slice - 1][i] & 0xFF];
+            }
+        }
+        return built;
+    }();
+    const uint32_t (&table)[8][256] = tables.slices;
     
-    double getCommission() const {
-        return getTotalSales() * 0.15; // 15% commission
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    while (length >= 8) {
+        uint32_t low, high;
+        memcpy(&low, p, 4);
+        memcpy(&high, p + 4, 4);
+        low ^= crc;
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+        p += 8;
+        length -= 8;
     }
+    while (length-- > 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+// Interned string pool: every distinct string is stored once, back to back in
+// one byte arena, and referred to by id. An open-addressing index over the
+// arena finds a string's id. Both are flat arrays, so a snapshot copies them.
+class StringPool {
+private:
+    static const uint32_t NO_STRING = ~0u;
     
-    int getOrderCount() const {
-        return orders.size();
+    struct Slot {
+        uint32_t hash;
+        uint32_t id; // NO_STRING when empty
+    };
+    
+    string bytes;
+    vector<uint64_t> ends;  // end of each string in bytes, by id
+    vector<Slot> slots;     // power-of-two sized, at most half full
+    
+    friend class RestaurantSnapshot;
+    
+    void growIndex() {
+        vector<Slot> old(max<size_t>(16, slots.size() * 2), Slot{0, NO_STRING});
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.id != NO_STRING) {
+                size_t i = slot.hash & mask;
+                while (slots[i].id != NO_STRING) {
+                    i = (i + 1) & mask;
+                }
+                slots[i] = slot;
+            }
+        }
+    }
+
+public:
+    uint32_t intern(StringRef s) {
+        if ((ends.size() + 1) * 2 > slots.size()) {
+            growIndex();
+        }
+        uint32_t hash = crc32c(s.data(), s.size());
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        for (; slots[i].id != NO_STRING; i = (i + 1) & mask) {
+            if (slots[i].hash == hash && get(slots[i].id) == s) {
+                return slots[i].id;
+            }
+        }
+        uint32_t id = static_cast<uint32_t>(ends.size());
+        bytes.append(s.data(), s.size());
+        ends.push_back(bytes.size());
+        slots[i].hash = hash;
+        slots[i].id = id;
+        return id;
     }
     
-    vector<shared_ptr<Order>> getOrders() const {
-        return orders;
+    // Views stay valid only until the next intern()
+    StringRef get(uint32_t id) const {
+        uint64_t begin = id > 0 ? ends[id - 1] : 0;
+        return StringRef(bytes.data() + begin, static_cast<size_t>(ends[id] - begin));
     }
+    
+    size_t size() const { return ends.size(); }
 };
 
-// Restaurant class
-class Restaurant {
-private:
-    string name;
-    vector<shared_ptr<Waiter>> waiters;
-    vector<shared_ptr<Order>> orders;
-    int nextOrderId;
+const uint32_t StringPool::NO_STRING;
 
+// Columnar patron store: the restaurant owns every patron's fields here and
+// orders refer to them by row. Names live once each in an append-only byte
+// arena, and an open-addressing index over the arena is the only name
+// lookup: a repeat customer resolves to the same row, and guests (one row
+// per party, e.g. simulated walk-ins) share the bytes of an equal name but
+// are never returned by find(). Each row carries loyalty totals that
+// recordVisit keeps current.
+class PatronStore {
 public:
-    Restaurant(string n) : name(n), nextOrderId(1) {}
+    static const uint32_t NO_PATRON = ~0u;
+
+private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t row; // NO_PATRON when empty; a named row whenever one has the name
+    };
     
-    void addWaiter(shared_ptr<Waiter> waiter) {
-        waiters.push_back(waiter);
+    string nameBytes;             // per name: uint32_t length, the bytes, then '\0'
+    vector<uint64_t> nameOffsets; // start of the row's name in nameBytes
+    vector<uint8_t> types;        // PatronType
+    vector<int32_t> groupSizes;
+    vector<uint8_t> sitIns;
+    vector<uint8_t> guests;       // 1 for rows that find() never returns
+    vector<uint32_t> visits[2];   // by OrderType
+    vector<KahanSum> spend[2];    // by OrderType
+    vector<Slot> slots;           // one per distinct name; power-of-two sized, at most half full
+    size_t slotCount;
+    size_t namedCount;
+    
+    friend class RestaurantSnapshot;
+    
+    static uint32_t hashName(const char* name, size_t size) {
+        return crc32c(name, size);
     }
     
-    void addOrder(shared_ptr<Patron> patron, OrderType orderType, double amount, 
-                  shared_ptr<Waiter> waiter, string items) {
-        auto order = make_shared<Order>(nextOrderId++, patron, orderType, amount, waiter, items);
-        orders.push_back(order);
-        waiter->addOrder(order);
+    StringRef nameAt(uint64_t offset) const {
+        uint32_t length;
+        memcpy(&length, nameBytes.data() + offset, sizeof(length));
+        return StringRef(nameBytes.data() + offset + sizeof(length), length);
     }
     
-    // Overloaded method for adding orders with custom timestamps
-    void addOrder(shared_ptr<Patron> patron, OrderType orderType, double amount, 
-                  shared_ptr<Waiter> waiter, string items, Timestamp timestamp) {
-        auto order = make_shared<Order>(nextOrderId++, patron, orderType, amount, waiter, items, timestamp);
-        orders.push_back(order);
-        waiter->addOrder(order);
+    uint64_t appendName(StringRef name) {
+        uint64_t offset = nameBytes.size();
+        uint32_t length = static_cast<uint32_t>(name.size());
+        nameBytes.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        nameBytes.append(name.data(), name.size());
+        nameBytes.push_back('\0');
+        return offset;
     }
     
-    // Getter methods for menu system
-    string getName() const { return name; }
-    vector<shared_ptr<Waiter>> getWaiters() const { return waiters; }
-    vector<shared_ptr<Order>> getOrders() const { return orders; }
+    // Slot holding name, or the empty slot where it would go
+    size_t probe(uint32_t hash, StringRef name) const {
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i].row != NO_PATRON && (slots[i].hash != hash || nameAt(nameOffsets[slots[i].row]) != name)) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
     
-    // Report a) Total number of sales divided into sit-in and take-out orders
-    void reportOrderCounts() const {
-        cout << "\n=== ORDER COUNT REPORT ===" << endl;
-        cout << setw(50) << left << "Report a) Total number of sales divided into sit-in and take-out orders" << endl;
-        cout << string(80, '-') << endl;
-        
-        int sitInCount = 0, takeOutCount = 0;
-        
-        for (const auto& order : orders) {
-            if (order->getType() == OrderType::SIT_IN) {
-                sitInCount++;
-            } else {
-                takeOutCount++;
+    void insertSlot(uint32_t hash, uint32_t row) {
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i].row != NO_PATRON) {
+            i = (i + 1) & mask;
+        }
+        slots[i].hash = hash;
+        slots[i].row = row;
+    }
+    
+    void growIndex() {
+        vector<Slot> old(max<size_t>(16, slots.size() * 2), Slot{0, NO_PATRON});
+        old.swap(slots);
+        for (const Slot& slot : old) {
+            if (slot.row != NO_PATRON) {
+                insertSlot(slot.hash, slot.row);
             }
         }
-        
-        cout << setw(20) << left << "Sit-in Orders:" << setw(10) << right << sitInCount << endl;
-        cout << setw(20) << left << "Take-out Orders:" << setw(10) << right << takeOutCount << endl;
-        cout << setw(20) << left << "Total Orders:" << setw(10) << right << (sitInCount + takeOutCount) << endl;
     }
     
-    // Report b) Total sales for the day, divided into sit-in and take-out sales
-    void reportTotalSales() const {
-        cout << "\n=== TOTAL SALES REPORT ===" << endl;
-        cout << setw(50) << left << "Report b) Total sales for the day, divided into sit-in and take-out sales" << endl;
-        cout << string(80, '-') << endl;
-        
-        double sitInSales = 0.0, takeOutSales = 0.0;
-        
-        for (const auto& order : orders) {
-            if (order->getType() == OrderType::SIT_IN) {
-                sitInSales += order->getTotalAmount();
-            } else {
-                takeOutSales += order->getTotalAmount();
+    uint32_t appendRow(StringRef name, PatronType type, int groupSize, bool sitIn, bool guest) {
+        if ((slotCount + 1) * 2 > slots.size()) {
+            growIndex();
+        }
+        uint32_t row = static_cast<uint32_t>(nameOffsets.size());
+        uint32_t hash = hashName(name.data(), name.size());
+        size_t slot = probe(hash, name);
+        if (slots[slot].row == NO_PATRON) {
+            nameOffsets.push_back(appendName(name));
+            slots[slot].hash = hash;
+            slots[slot].row = row;
+            slotCount++;
+        } else {
+            nameOffsets.push_back(nameOffsets[slots[slot].row]);
+            if (!guest) {
+                slots[slot].row = row;
             }
         }
-        
-        cout << setw(20) << left << "Sit-in Sales:" << "R" << setw(10) << right << fixed << setprecision(2) << sitInSales << endl;
-        cout << setw(20) << left << "Take-out Sales:" << "R" << setw(10) << right << fixed << setprecision(2) << takeOutSales << endl;
-        cout << setw(20) << left << "Total Sales:" << "R" << setw(10) << right << fixed << setprecision(2) << (sitInSales + takeOutSales) << endl;
+        types.push_back(static_cast<uint8_t>(type));
+        groupSizes.push_back(groupSize);
+        sitIns.push_back(sitIn ? 1 : 0);
+        guests.push_back(guest ? 1 : 0);
+        for (int t = 0; t < 2; t++) {
+            visits[t].push_back(0);
+            spend[t].push_back(KahanSum());
+        }
+        return row;
     }
+
+public:
+    PatronStore() : slotCount(0), namedCount(0) {}
     
-    // Report c) Total sales made by each waiter
-    void reportWaiterSales() const {
-        cout << "\n=== WAITER SALES REPORT ===" << endl;
-        cout << setw(50) << left << "Report c) Total sales made by each waiter" << endl;
-        cout << string(80, '-') << endl;
-        
-        cout << setw(5) << left << "ID" << setw(20) << left << "Waiter Name" 
-             << setw(15) << right << "Orders" << setw(15) << right << "Total Sales" << endl;
-        cout << string(80, '-') << endl;
-        
-        for (const auto& waiter : waiters) {
-            cout << setw(5) << left << waiter->getWaiterId() 
-                 << setw(20) << left << waiter->getName()
-                 << setw(15) << right << waiter->getOrderCount()
-                 << "R" << setw(14) << right << fixed << setprecision(2) << waiter->getTotalSales() << endl;
+    // Row of the named patron, or NO_PATRON
+    uint32_t find(const char* name, size_t size) const {
+        if (slots.empty()) {
+            return NO_PATRON;
         }
+        uint32_t row = slots[probe(hashName(name, size), StringRef(name, size))].row;
+        return row != NO_PATRON && !guests[row] ? row : NO_PATRON;
     }
     
-    // Report d) Commission for each waiter (15% of their total sales)
-    void reportWaiterCommission() const {
-        cout << "\n=== WAITER COMMISSION REPORT ===" << endl;
-        cout << setw(50) << left << "Report d) Commission for each waiter (15% of total sales)" << endl;
-        cout << string(80, '-') << endl;
-        
-        cout << setw(5) << left << "ID" << setw(20) << left << "Waiter Name" 
-             << setw(15) << right << "Total Sales" << setw(15) << right << "Commission" << endl;
-        cout << string(80, '-') << endl;
-        
-        for (const auto& waiter : waiters) {
-            cout << setw(5) << left << waiter->getWaiterId() 
-                 << setw(20) << left << waiter->getName()
-                 << "R" << setw(14) << right << fixed << setprecision(2) << waiter->getTotalSales()
-                 << "R" << setw(14) << right << fixed << setprecision(2) << waiter->getCommission() << endl;
+    uint32_t find(const string& name) const { return find(name.data(), name.size()); }
+    
+    // Adds a named patron that find() does not know yet
+    uint32_t appendNamed(StringRef name, PatronType type, int groupSize, bool sitIn) {
+        namedCount++;
+        return appendRow(name, type, groupSize, sitIn, false);
+    }
+    
+    // Adds a patron row that is never matched by name
+    uint32_t appendGuest(StringRef name, PatronType type, int groupSize, bool sitIn) {
+        return appendRow(name, type, groupSize, sitIn, true);
+    }
+    
+    void recordVisit(uint32_t row, OrderType type, double amount) {
+        visits[static_cast<int>(type)][row]++;
+        spend[static_cast<int>(type)][row].add(amount);
+    }
+    
+    void reserve(size_t n) {
+        nameOffsets.reserve(n);
+        types.reserve(n);
+        groupSizes.reserve(n);
+        sitIns.reserve(n);
+        guests.reserve(n);
+        for (int t = 0; t < 2; t++) {
+            visits[t].reserve(n);
+            spend[t].reserve(n);
         }
     }
     
-    // Display all orders for detailed view
-    void displayAllOrders() const {
-        cout << "\n=== DETAILED ORDER REPORT ===" << endl;
-        cout << string(120, '-') << endl;
-        cout << setw(8) << left << "Order ID" << setw(20) << left << "Patron" 
-             << setw(15) << left << "Type" << setw(15) << left << "Order Type"
-             << setw(20) << left << "Waiter" << setw(20) << left << "Timestamp"
-             << setw(15) << right << "Amount" << endl;
-        cout << string(120, '-') << endl;
-        
-        for (const auto& order : orders) {
-            cout << setw(8) << left << order->getOrderId()
-                 << setw(20) << left << order->getPatron()->getName()
-                 << setw(15) << left << order->getPatron()->getTypeString()
-                 << setw(15) << left << order->getTypeString()
-                 << setw(20) << left << order->getWaiter()->getName()
-                 << setw(20) << left << order->getTimestamp().toString()
-                 << "R" << setw(14) << right << fixed << setprecision(2) << order->getTotalAmount() << endl;
+    // Drops the guest rows in place; named patrons keep their loyalty totals
+    // but move down to close the gaps. When any row moved, the arena is
+    // rewritten with just the named patrons' names and the index rebuilt.
+    // No column releases its storage.
+    void dropGuests() {
+        size_t kept = 0;
+        for (size_t row = 0; row < nameOffsets.size(); row++) {
+            if (guests[row]) {
+                continue;
+            }
+            if (kept != row) {
+                nameOffsets[kept] = nameOffsets[row];
+                types[kept] = types[row];
+                groupSizes[kept] = groupSizes[row];
+                sitIns[kept] = sitIns[row];
+                guests[kept] = 0;
+                for (int t = 0; t < 2; t++) {
+                    visits[t][kept] = visits[t][row];
+                    spend[t][kept] = spend[t][row];
+                }
+            }
+            kept++;
+        }
+        if (kept == nameOffsets.size()) {
+            return;
         }
+        nameOffsets.resize(kept);
+        types.resize(kept);
+        groupSizes.resize(kept);
+        sitIns.resize(kept);
+        guests.resize(kept);
+        for (int t = 0; t < 2; t++) {
+            visits[t].resize(kept);
+            spend[t].resize(kept);
+        }
+        string compacted;
+        compacted.reserve(nameBytes.capacity());
+        compacted.swap(nameBytes);
+        fill(slots.begin(), slots.end(), Slot{0, NO_PATRON});
+        for (uint32_t row = 0; row < kept; row++) {
+            uint32_t length;
+            memcpy(&length, compacted.data() + nameOffsets[row], sizeof(length));
+            StringRef name(compacted.data() + nameOffsets[row] + sizeof(length), length);
+            nameOffsets[row] = appendName(name);
+            insertSlot(hashName(name.data(), name.size()), row);
+        }
+        slotCount = kept;
     }
     
-    // Generate all reports
-    void generateAllReports() const {
-        cout << "\n" << string(80, '=') << endl;
-        cout << "RESTAURANT SIMULATION REPORT - " << name << endl;
-        cout << string(80, '=') << endl;
-        
-        reportOrderCounts();
-        reportTotalSales();
-        reportWaiterSales();
-        reportWaiterCommission();
-        displayAllOrders();
+    size_t size() const { return nameOffsets.size(); }
+    size_t namedSize() const { return namedCount; }
+    
+    StringRef name(uint32_t row) const { return nameAt(nameOffsets[row]); }
+    PatronType type(uint32_t row) const { return static_cast<PatronType>(types[row]); }
+    int groupSize(uint32_t row) const { return groupSizes[row]; }
+    bool sitIn(uint32_t row) const { return sitIns[row] != 0; }
+    bool guest(uint32_t row) const { return guests[row] != 0; }
+    uint32_t visitCount(uint32_t row, OrderType type) const { return visits[static_cast<int>(type)][row]; }
+    double spent(uint32_t row, OrderType type) const { return spend[static_cast<int>(type)][row].value(); }
+    double lifetimeSpend(uint32_t row) const { return spent(row, OrderType::SIT_IN) + spent(row, OrderType::TAKE_OUT); }
+};
+
+const uint32_t PatronStore::NO_PATRON;
+
+// Lightweight read-only view of one row of a PatronStore, with Patron's getters
+class PatronRef {
+private:
+    const PatronStore* store;
+    uint32_t row;
+
+public:
+    PatronRef(const PatronStore& s, uint32_t r) : store(&s), row(r) {}
+    
+    StringRef getName() const { return store->name(row); }
+    PatronType getType() const { return store->type(row); }
+    int getGroupSize() const { return store->groupSize(row); }
+    bool isSitInOrder() const { return store->sitIn(row); }
+    
+    // Loyalty totals over every order placed under this patron
+    uint32_t getVisitCount(OrderType type) const { return store->visitCount(row, type); }
+    uint32_t getVisitCount() const { return getVisitCount(OrderType::SIT_IN) + getVisitCount(OrderType::TAKE_OUT); }
+    double getSpend(OrderType type) const { return store->spent(row, type); }
+    double getLifetimeSpend() const { return store->lifetimeSpend(row); }
+    
+    const char* getTypeString() const {
+        return (getType() == PatronType::INDIVIDUAL) ? "Individual" : "Group";
     }
 };
 
-// Function to create sample data for demonstration
-void createSampleData(Restaurant& restaurant) {
-    // Create waiters with South African names
-    auto waiter1 = make_shared<Waiter>(1, "Sipho Ndlovu");
-    auto waiter2 = make_shared<Waiter>(2, "Thandi Maseko");
-    auto waiter3 = make_shared<Waiter>(3, "Lungile Zulu");
+// Menu items by id: interned names with their list prices (0 when unknown)
+class MenuCatalog {
+private:
+    StringPool names;
+    vector<double> prices;
     
-    restaurant.addWaiter(waiter1);
-    restaurant.addWaiter(waiter2);
-    restaurant.addWaiter(waiter3);
+    friend class RestaurantSnapshot;
+
+public:
+    uint32_t intern(StringRef name) {
+        uint32_t id = names.intern(name);
+        if (id == prices.size()) {
+            prices.push_back(0.0);
+        }
+        return id;
+    }
     
-    // Create patrons with South African names
-    auto patron1 = make_shared<Patron>("Nokuthula Dlamini", PatronType::INDIVIDUAL, 1, true);
-    auto patron2 = make_shared<Patron>("Themba Nkosi", PatronType::GROUP, 4, true);
-    auto patron3 = make_shared<Patron>("Zanele Mbatha", PatronType::INDIVIDUAL, 1, false);
-    auto patron4 = make_shared<Patron>("Mandla Cele", PatronType::GROUP, 6, true);
-    auto patron5 = make_shared<Patron>("Lerato Molefe", PatronType::INDIVIDUAL, 1, false);
-    auto patron6 = make_shared<Patron>("Kagiso Mokoena", PatronType::GROUP, 3, true);
-    auto patron7 = make_shared<Patron>("Amahle Ngcobo", PatronType::INDIVIDUAL, 1, true);
-    auto patron8 = make_shared<Patron>("Sibusiso Khumalo", PatronType::GROUP, 5, true);
+    uint32_t setPrice(const string& name, double price) {
+        uint32_t id = intern(name);
+        prices[id] = price;
+        return id;
+    }
     
-    // Add orders with realistic South African prices in Rands and simulated timestamps
-    restaurant.addOrder(patron1, OrderType::SIT_IN, 125.50, waiter1, "Burger, Chips, Coke", Timestamp(2024, 12, 15, 12, 30, 15));
-    restaurant.addOrder(patron2, OrderType::SIT_IN, 489.75, waiter2, "4x Pasta, 4x Wine, 2x Dessert", Timestamp(2024, 12, 15, 13, 15, 42));
-    restaurant.addOrder(patron3, OrderType::TAKE_OUT, 118.25, waiter1, "Pizza Slice, Soda", Timestamp(2024, 12, 15, 13, 45, 23));
-    restaurant.addOrder(patron4, OrderType::SIT_IN, 856.40, waiter3, "6x Steak, 6x Beer, 3x Appetizer", Timestamp(2024, 12, 15, 14, 20, 8));
-    restaurant.addOrder(patron5, OrderType::TAKE_OUT, 232.80, waiter2, "2x Sandwich, Chips, Coffee", Timestamp(2024, 12, 15, 15, 5, 37));
-    restaurant.addOrder(patron6, OrderType::SIT_IN, 367.90, waiter1, "3x Fish, 3x Wine, Salad", Timestamp(2024, 12, 15, 16, 12, 55));
-    restaurant.addOrder(patron7, OrderType::SIT_IN, 242.15, waiter3, "Salmon, Rice, Tea", Timestamp(2024, 12, 15, 17, 30, 12));
-    restaurant.addOrder(patron8, OrderType::SIT_IN, 734.60, waiter2, "5x Chicken, 5x Beer, 2x Dessert", Timestamp(2024, 12, 15, 18, 45, 29));
-    restaurant.addOrder(patron1, OrderType::TAKE_OUT, 128.45, waiter1, "Salad, Soup, Bread", Timestamp(2024, 12, 15, 19, 15, 44));
-    restaurant.addOrder(patron3, OrderType::SIT_IN, 355.30, waiter3, "Pasta, Wine, Tiramisu", Timestamp(2024, 12, 15, 20, 30, 18));
-}
+    StringRef name(uint32_t id) const { return names.get(id); }
+    double price(uint32_t id) const { return prices[id]; }
+    size_t size() const { return prices.size(); }
+};
 
-// Menu system functions
-void displayMainMenu() {
-    cout << "\n" << string(60, '=') << endl;
-    cout << "    RESTAURANT SIMULATION MANAGEMENT SYSTEM" << endl;
-    cout << string(60, '=') << endl;
-    cout << "1. View All Reports" << endl;
-    cout << "2. View Order Count Report" << endl;
-    cout << "3. View Total Sales Report" << endl;
-    cout << "4. View Waiter Sales Report" << endl;
-    cout << "5. View Waiter Commission Report" << endl;
-    cout << "6. View Detailed Order Report" << endl;
-    cout << "7. Add New Order" << endl;
-    cout << "8. View Restaurant Statistics" << endl;
-    cout << "9. View Orders by Time Range" << endl;
-    cout << "10. Clear Screen" << endl;
-    cout << "0. Exit Program" << endl;
-    cout << string(60, '=') << endl;
-    cout << "Enter your choice (0-10): ";
-}
+// One line of an order: a menu item and how many of it
+struct LineItem {
+    uint32_t item;      // id in MenuCatalog
+    uint32_t quantity;
+};
 
-void clearScreen() {
-    #ifdef _WIN32
-        system("cls");
-    #else
-        system("clear");
-    #endif
-}
+class LineItemRange {
+private:
+    const LineItem* first;
+    const LineItem* last;
 
-int getValidChoice() {
-    int choice;
-    while (!(cin >> choice) || choice < 0 || choice > 10) {
-        cout << "Invalid input! Please enter a number between 0 and 10: ";
-        cin.clear();
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+public:
+    LineItemRange(const LineItem* f, const LineItem* l) : first(f), last(l) {}
+    
+    const LineItem* begin() const { return first; }
+    const LineItem* end() const { return last; }
+    size_t size() const { return last - first; }
+};
+
+// Parses an item list such as "4x Pasta, 4x Wine, Malva Pudding" into line
+// items appended to lines; an entry without an "Nx " count is one of that
+// item. Entries are trimmed, empty ones skipped and repeats of an item merged.
+void parseLineItems(StringRef items, MenuCatalog& menu, vector<LineItem>& lines) {
+    const size_t first = lines.size();
+    const char* p = items.data();
+    const char* const end = p + items.size();
+    while (p < end) {
+        const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+        const char* last = comma ? comma : end;
+        while (p < last && *p == ' ') {
+            p++;
+        }
+        while (last > p && last[-1] == ' ') {
+            last--;
+        }
+        uint32_t quantity = 0;
+        const char* digit = p;
+        while (digit < last && digit - p < 6 && *digit >= '0' && *digit <= '9') {
+            quantity = quantity * 10 + static_cast<uint32_t>(*digit++ - '0');
+        }
+        if (digit > p && quantity > 0 && last - digit > 2 && (*digit == 'x' || *digit == 'X') && digit[1] == ' ') {
+            p = digit + 2;
+            while (p < last && *p == ' ') {
+                p++;
+            }
+        } else {
+            quantity = 1;
+        }
+        if (p < last) {
+            LineItem line = {menu.intern(StringRef(p, last - p)), quantity};
+            size_t i = first;
+            while (i < lines.size() && lines[i].item != line.item) {
+                i++;
+            }
+            if (i < lines.size()) {
+                lines[i].quantity += quantity;
+            } else {
+                lines.push_back(line);
+            }
+        }
+        p = comma ? comma + 1 : end;
     }
-    return choice;
 }
 
-void displayRestaurantStats(const Restaurant& restaurant) {
-    cout << "\n=== RESTAURANT STATISTICS ===" << endl;
-    cout << string(50, '-') << endl;
-    cout << "Restaurant Name: " << restaurant.getName() << endl;
-    cout << "Total Waiters: " << restaurant.getWaiters().size() << endl;
-    cout << "Total Orders: " << restaurant.getOrders().size() << endl;
+// Columnar order store: one contiguous array per field so that reports
+// become linear scans instead of pointer chasing through heap objects
+class OrderStore {
+private:
+    vector<int> orderIds;
+    vector<double> amounts;
+    vector<uint8_t> types;        // OrderType
+    vector<uint32_t> waiterIds;   // index into Restaurant::waiters
+    vector<uint32_t> patronIds;   // index into Restaurant::patrons
+    vector<uint8_t> partyTypes;   // PatronType of the party on this visit
+    vector<uint16_t> partySizes;  // people in the party on this visit
+    vector<int64_t> timestamps;   // Timestamp::toEpochSeconds()
+    vector<uint32_t> itemIds;     // id in itemPool
+    StringPool itemPool;
+    // Each distinct item list is parsed once when it is interned; its line
+    // items sit back to back in one buffer shared by every order using it
+    MenuCatalog menu;
+    vector<LineItem> lineItems;
+    vector<uint32_t> lineItemEnds; // by item list id
     
-    double totalSales = 0.0;
-    for (const auto& order : restaurant.getOrders()) {
-        totalSales += order->getTotalAmount();
+    friend class RestaurantSnapshot;
+
+public:
+    size_t append(int orderId, uint32_t patronId, PatronType partyType, int partySize, OrderType type, double amount,
+                  uint32_t waiterId, const string& items, const Timestamp& timestamp) {
+        return append(orderId, patronId, partyType, partySize, type, amount, waiterId, internItems(items),
+                      timestamp.toEpochSeconds());
     }
-    cout << "Total Sales: R" << fixed << setprecision(2) << totalSales << endl;
     
-    double totalCommission = 0.0;
-    for (const auto& waiter : restaurant.getWaiters()) {
-        totalCommission += waiter->getCommission();
+    // Append with an item id already returned by internItems()
+    size_t append(int orderId, uint32_t patronId, PatronType partyType, int partySize, OrderType type, double amount,
+                  uint32_t waiterId, uint32_t itemId, int64_t epochSeconds) {
+        orderIds.push_back(orderId);
+        amounts.push_back(amount);
+        types.push_back(static_cast<uint8_t>(type));
+        waiterIds.push_back(waiterId);
+        patronIds.push_back(patronId);
+        partyTypes.push_back(static_cast<uint8_t>(partyType));
+        partySizes.push_back(static_cast<uint16_t>(max(1, min(partySize, 0x7FFF))));
+        timestamps.push_back(epochSeconds);
+        itemIds.push_back(itemId);
+        return orderIds.size() - 1;
     }
-    cout << "Total Commission Paid: R" << fixed << setprecision(2) << totalCommission << endl;
-    cout << string(50, '-') << endl;
-}
-
-void addNewOrder(Restaurant& restaurant) {
+    
+    uint32_t internItems(StringRef items) {
+        uint32_t id = itemPool.intern(items);
+        if (id == lineItemEnds.size()) {
+            parseLineItems(items, menu, lineItems);
+            lineItemEnds.push_back(static_cast<uint32_t>(lineItems.size()));
+        }
+        return id;
+    }
+    
+    void reserve(size_t n) {
+        orderIds.reserve(n);
+        amounts.reserve(n);
+        types.reserve(n);
+        waiterIds.reserve(n);
+        patronIds.reserve(n);
+        partyTypes.reserve(n);
+        partySizes.reserve(n);
+        timestamps.reserve(n);
+        itemIds.reserve(n);
+    }
+    
+    // Drops every row but keeps the column capacity and the interned items
+    void clear() {
+        orderIds.clear();
+        amounts.clear();
+        types.clear();
+        waiterIds.clear();
+        patronIds.clear();
+        partyTypes.clear();
+        partySizes.clear();
+        timestamps.clear();
+        itemIds.clear();
+    }
+    
+    size_t size() const { return orderIds.size(); }
+    bool empty() const { return orderIds.empty(); }
+    
+    int orderId(size_t row) const { return orderIds[row]; }
+    double amount(size_t row) const { return amounts[row]; }
+    OrderType type(size_t row) const { return static_cast<OrderType>(types[row]); }
+    uint32_t waiterId(size_t row) const { return waiterIds[row]; }
+    uint32_t patronId(size_t row) const { return patronIds[row]; }
+    PatronType partyType(size_t row) const { return static_cast<PatronType>(partyTypes[row]); }
+    int partySize(size_t row) const { return partySizes[row]; }
+    int64_t epochSeconds(size_t row) const { return timestamps[row]; }
+    StringRef items(size_t row) const { return itemPool.get(itemIds[row]); }
+    uint32_t itemId(size_t row) const { return itemIds[row]; }
+    
+    // Raw column access for bulk scans
+    const int* orderIdData() const { return orderIds.data(); }
+    const double* amountData() const { return amounts.data(); }
+    const uint8_t* typeData() const { return types.data(); }
+    const uint32_t* waiterIdData() const { return waiterIds.data(); }
+    const uint32_t* patronIdData() const { return patronIds.data(); }
+    const uint8_t* partyTypeData() const { return partyTypes.data(); }
+    const uint16_t* partySizeData() const { return partySizes.data(); }
+    const int64_t* timestampData() const { return timestamps.data(); }
+    const uint32_t* itemIdData() const { return itemIds.data(); }
+    const StringPool& getItemPool() const { return itemPool; }
+    
+    LineItemRange lineItemsOf(uint32_t itemId) const {
+        const LineItem* base = lineItems.data();
+        return LineItemRange(base + (itemId > 0 ? lineItemEnds[itemId - 1] : 0), base + lineItemEnds[itemId]);
+    }
+    
+    const vector<LineItem>& getLineItems() const { return lineItems; }
+    const MenuCatalog& getMenu() const { return menu; }
+    MenuCatalog& getMenu() { return menu; }
+};
+
+// Order class: lightweight read-only view of one row of an OrderStore
+class Order {
+private:
+    const OrderStore* store;
+    size_t row;
+
+public:
+    Order(const OrderStore& s, size_t r) : store(&s), row(r) {}
+    
+    int getOrderId() const { return store->orderId(row); }
+    uint32_t getPatronId() const { return store->patronId(row); }
+    PatronType getPartyType() const { return store->partyType(row); }
+    int getPartySize() const { return store->partySize(row); }
+    OrderType getType() const { return store->type(row); }
+    double getTotalAmount() const { return store->amount(row); }
+    uint32_t getWaiterId() const { return store->waiterId(row); }
+    StringRef getItems() const { return store->items(row); }
+    LineItemRange getLineItems() const { return store->lineItemsOf(store->itemId(row)); }
+    Timestamp getTimestamp() const { return Timestamp::fromEpochSeconds(store->epochSeconds(row)); }
+    
+    const char* getTypeString() const {
+        return (getType() == OrderType::SIT_IN) ? "Sit-in" : "Take-out";
+    }
+    
+    const char* getPartyTypeString() const {
+        return (getPartyType() == PatronType::INDIVIDUAL) ? "Individual" : "Group";
+    }
+};
+
+// Iterator range over a list of store rows, yielding Order views without copying
+class OrderRange {
+private:
+    const OrderStore* store;
+    const size_t* first;
+    const size_t* last;
+
+public:
+    class iterator {
+    private:
+        const OrderStore* store;
+        const size_t* pos;
+    
+    public:
+        iterator(const OrderStore* s, const size_t* p) : store(s), pos(p) {}
+        
+        Order operator*() const { return Order(*store, *pos); }
+        iterator& operator++() { ++pos; return *this; }
+        bool operator!=(const iterator& other) const { return pos != other.pos; }
+    };
+    
+    OrderRange(const OrderStore* s, const size_t* f, const size_t* l) : store(s), first(f), last(l) {}
+    
+    iterator begin() const { return iterator(store, first); }
+    iterator end() const { return iterator(store, last); }
+    size_t size() const { return last - first; }
+};
+
+// Orders indexed by their epoch-seconds timestamp: a sorted key array with the
+// matching store rows, so a time range query is a binary search plus a slice
+class TimeIndex {
+private:
+    mutable vector<int64_t> keys;
+    mutable vector<size_t> rows;
+    mutable vector<pair<int64_t, size_t>> pending; // out-of-order arrivals, merged on the next query
+    
+    friend class RestaurantSnapshot;
+    
+    void mergePending() const {
+        if (pending.empty()) {
+            return;
+        }
+        stable_sort(pending.begin(), pending.end(),
+                    [](const pair<int64_t, size_t>& a, const pair<int64_t, size_t>& b) { return a.first < b.first; });
+        vector<int64_t> mergedKeys;
+        vector<size_t> mergedRows;
+        mergedKeys.reserve(keys.size() + pending.size());
+        mergedRows.reserve(keys.size() + pending.size());
+        size_t i = 0, j = 0;
+        while (i < keys.size() || j < pending.size()) {
+            if (j == pending.size() || (i < keys.size() && keys[i] <= pending[j].first)) {
+                mergedKeys.push_back(keys[i]);
+                mergedRows.push_back(rows[i++]);
+            } else {
+                mergedKeys.push_back(pending[j].first);
+                mergedRows.push_back(pending[j++].second);
+            }
+        }
+        keys.swap(mergedKeys);
+        rows.swap(mergedRows);
+        pending.clear();
+    }
+
+public:
+    void add(int64_t key, size_t row) {
+        if (keys.empty() || key >= keys.back()) {
+            keys.push_back(key);
+            rows.push_back(row);
+        } else {
+            pending.push_back(make_pair(key, row));
+        }
+    }
+    
+    void reserve(size_t n) {
+        keys.reserve(n);
+        rows.reserve(n);
+    }
+    
+    void clear() {
+        keys.clear();
+        rows.clear();
+        pending.clear();
+    }
+    
+    size_t size() const { return keys.size() + pending.size(); }
+    
+    // Rows with keys in [from, to], in time order
+    OrderRange range(const OrderStore& store, int64_t from, int64_t to) const {
+        mergePending();
+        size_t first = lower_bound(keys.begin(), keys.end(), from) - keys.begin();
+        size_t last = upper_bound(keys.begin() + first, keys.end(), to) - keys.begin();
+        if (last < first) {
+            last = first;
+        }
+        return OrderRange(&store, rows.data() + first, rows.data() + last);
+    }
+    
+    int64_t minKey() const {
+        mergePending();
+        return keys.front();
+    }
+    
+    int64_t maxKey() const {
+        mergePending();
+        return keys.back();
+    }
+};
+
+// Column scan kernels over the OrderStore arrays, in a portable scalar
+// version and, on x86, SSE2 and AVX2 versions picked at run time. Every
+// kernel adds into its outputs, so a scan can be split into chunks. Order
+// types must be 0 or 1 (OrderType), and the hour kernels expect epoch
+// seconds within about 2.9 million years of 1970.
+typedef void (*SumByTypeKernel)(const double* amounts, const uint8_t* types, size_t n,
+                                double sums[2], uint64_t counts[2]);
+typedef void (*SumByGroupKernel)(const double* amounts, const uint32_t* groups, size_t n,
+                                 double* sums, uint64_t* counts, size_t groupCount);
+typedef void (*BucketByHourKernel)(const int64_t* timestamps, const double* amounts, size_t n,
+                                   double sums[24], uint64_t counts[24]);
+
+struct SalesKernels {
+    const char* name;
+    SumByTypeKernel sumByType;    // masked sums by OrderType
+    SumByGroupKernel sumByGroup;  // grouped sums, e.g. by waiter index
+    BucketByHourKernel bucketByHour;
+};
+
+void sumByTypeScalar(const double* amounts, const uint8_t* types, size_t n, double sums[2], uint64_t counts[2]) {
+    double partial[2] = {0.0, 0.0};
+    uint64_t takeOut = 0;
+    for (size_t i = 0; i < n; i++) {
+        partial[types[i]] += amounts[i];
+        takeOut += types[i];
+    }
+    sums[0] += partial[0];
+    sums[1] += partial[1];
+    counts[0] += n - takeOut;
+    counts[1] += takeOut;
+}
+
+void sumByGroupScalar(const double* amounts, const uint32_t* groups, size_t n,
+                      double* sums, uint64_t* counts, size_t) {
+    for (size_t i = 0; i < n; i++) {
+        sums[groups[i]] += amounts[i];
+        counts[groups[i]]++;
+    }
+}
+
+inline int hourOfDay(int64_t epochSeconds) {
+    int64_t second = epochSeconds % 86400;
+    return static_cast<int>((second < 0 ? second + 86400 : second) / 3600);
+}
+
+void bucketByHourScalar(const int64_t* timestamps, const double* amounts, size_t n,
+                        double sums[24], uint64_t counts[24]) {
+    for (size_t i = 0; i < n; i++) {
+        int hour = hourOfDay(timestamps[i]);
+        sums[hour] += amounts[i];
+        counts[hour]++;
+    }
+}
+
+const SalesKernels SCALAR_SALES_KERNELS = {"scalar", sumByTypeScalar, sumByGroupScalar, bucketByHourScalar};
+
+#ifdef RESTAURANT_X86_DISPATCH
+// Scatter-adds of four consecutive elements go to four private tables so a
+// run of orders for the same waiter or hour is not one long dependency chain.
+// Each entry is a {sum, count} pair of doubles updated with a single 128-bit
+// add; counts stay exact up to 2^53 per entry.
+const size_t LANE_TABLE_SIZE = 256;
+
+struct LaneTables {
+    __m128d entries[4][LANE_TABLE_SIZE];
+    
+    __attribute__((target("sse2")))
+    void reset(size_t size) {
+        for (int lane = 0; lane < 4; lane++) {
+            fill(entries[lane], entries[lane] + size, _mm_setzero_pd());
+        }
+    }
+    
+    // sumAndOne holds {amount, 1.0}
+    __attribute__((target("sse2")))
+    void add(int lane, uint32_t key, __m128d sumAndOne) {
+        entries[lane][key] = _mm_add_pd(entries[lane][key], sumAndOne);
+    }
+    
+    __attribute__((target("sse2")))
+    void add(int lane, uint32_t key, double amount) {
+        add(lane, key, _mm_set_pd(1.0, amount));
+    }
+    
+    __attribute__((target("sse2")))
+    void flush(size_t size, double* totalSums, uint64_t* totalCounts) const {
+        for (size_t key = 0; key < size; key++) {
+            __m128d total = _mm_add_pd(_mm_add_pd(entries[0][key], entries[1][key]),
+                                       _mm_add_pd(entries[2][key], entries[3][key]));
+            double pair[2];
+            _mm_storeu_pd(pair, total);
+            totalSums[key] += pair[0];
+            totalCounts[key] += static_cast<uint64_t>(pair[1]);
+        }
+    }
+};
+
+__attribute__((target("sse2")))
+void sumByGroupSse2(const double* amounts, const uint32_t* groups, size_t n,
+                    double* sums, uint64_t* counts, size_t groupCount) {
+    if (groupCount > LANE_TABLE_SIZE) {
+        sumByGroupScalar(amounts, groups, n, sums, counts, groupCount);
+        return;
+    }
+    const __m128d ones = _mm_set1_pd(1.0);
+    LaneTables tables;
+    tables.reset(groupCount);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d a01 = _mm_loadu_pd(amounts + i);
+        __m128d a23 = _mm_loadu_pd(amounts + i + 2);
+        tables.add(0, groups[i], _mm_unpacklo_pd(a01, ones));
+        tables.add(1, groups[i + 1], _mm_unpackhi_pd(a01, ones));
+        tables.add(2, groups[i + 2], _mm_unpacklo_pd(a23, ones));
+        tables.add(3, groups[i + 3], _mm_unpackhi_pd(a23, ones));
+    }
+    for (; i < n; i++) {
+        tables.add(0, groups[i], amounts[i]);
+    }
+    tables.flush(groupCount, sums, counts);
+}
+
+// Hours are worked out in double precision: epoch seconds plus a bias that
+// is a whole number of days become exact doubles through the 2^52 bit trick,
+// and the +0.5 keeps the divisions clear of bucket edges
+const int64_t HOUR_BIAS = 86400LL << 30;
+const int64_t DOUBLE_MAGIC_BITS = 0x4330000000000000LL; // 2^52 as a double
+
+__attribute__((target("sse2")))
+void sumByTypeSse2(const double* amounts, const uint8_t* types, size_t n, double sums[2], uint64_t counts[2]) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128d sitIn0 = _mm_setzero_pd(), sitIn1 = _mm_setzero_pd();
+    __m128d takeOut0 = _mm_setzero_pd(), takeOut1 = _mm_setzero_pd();
+    __m128i takeOutCount = zero;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32_t packed;
+        memcpy(&packed, types + i, 4);
+        __m128i t32 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        __m128i tLow = _mm_unpacklo_epi32(t32, zero);
+        __m128i tHigh = _mm_unpackhi_epi32(t32, zero);
+        __m128d maskLow = _mm_castsi128_pd(_mm_sub_epi64(zero, tLow)); // all ones for take-out
+        __m128d maskHigh = _mm_castsi128_pd(_mm_sub_epi64(zero, tHigh));
+        __m128d a0 = _mm_loadu_pd(amounts + i);
+        __m128d a1 = _mm_loadu_pd(amounts + i + 2);
+        takeOut0 = _mm_add_pd(takeOut0, _mm_and_pd(maskLow, a0));
+        sitIn0 = _mm_add_pd(sitIn0, _mm_andnot_pd(maskLow, a0));
+        takeOut1 = _mm_add_pd(takeOut1, _mm_and_pd(maskHigh, a1));
+        sitIn1 = _mm_add_pd(sitIn1, _mm_andnot_pd(maskHigh, a1));
+        takeOutCount = _mm_add_epi64(takeOutCount, _mm_add_epi64(tLow, tHigh));
+    }
+    double lanes[2];
+    uint64_t countLanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sitIn0, sitIn1));
+    double sitIn = lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, _mm_add_pd(takeOut0, takeOut1));
+    double takeOut = lanes[0] + lanes[1];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(countLanes), takeOutCount);
+    uint64_t takeOuts = countLanes[0] + countLanes[1];
+    for (; i < n; i++) {
+        (types[i] ? takeOut : sitIn) += amounts[i];
+        takeOuts += types[i];
+    }
+    sums[0] += sitIn;
+    sums[1] += takeOut;
+    counts[0] += n - takeOuts;
+    counts[1] += takeOuts;
+}
+
+__attribute__((target("sse2")))
+void bucketByHourSse2(const int64_t* timestamps, const double* amounts, size_t n,
+                      double sums[24], uint64_t counts[24]) {
+    const __m128i bias = _mm_set1_epi64x(HOUR_BIAS);
+    const __m128i magicBits = _mm_set1_epi64x(DOUBLE_MAGIC_BITS);
+    const __m128d magic = _mm_castsi128_pd(magicBits);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d perDay = _mm_set1_pd(1.0 / 86400);
+    const __m128d perHour = _mm_set1_pd(1.0 / 3600);
+    const __m128d dayLength = _mm_set1_pd(86400.0);
+    const __m128d ones = _mm_set1_pd(1.0);
+    LaneTables tables;
+    tables.reset(24);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i t = _mm_add_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(timestamps + i)), bias);
+        __m128d seconds = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(t, magicBits)), magic);
+        // Truncation is floor here: the biased values are positive and days fit in 31 bits
+        __m128d day = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_mul_pd(_mm_add_pd(seconds, half), perDay)));
+        __m128d second = _mm_sub_pd(seconds, _mm_mul_pd(day, dayLength));
+        __m128i hours = _mm_cvttpd_epi32(_mm_mul_pd(_mm_add_pd(second, half), perHour));
+        __m128d a = _mm_loadu_pd(amounts + i);
+        tables.add(i & 2, static_cast<uint32_t>(_mm_cvtsi128_si32(hours)), _mm_unpacklo_pd(a, ones));
+        tables.add((i & 2) + 1, static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(hours, 4))),
+                   _mm_unpackhi_pd(a, ones));
+    }
+    for (; i < n; i++) {
+        tables.add(0, hourOfDay(timestamps[i]), amounts[i]);
+    }
+    tables.flush(24, sums, counts);
+}
+
+__attribute__((target("avx2")))
+void sumByTypeAvx2(const double* amounts, const uint8_t* types, size_t n, double sums[2], uint64_t counts[2]) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256d sitIn0 = _mm256_setzero_pd(), sitIn1 = _mm256_setzero_pd();
+    __m256d takeOut0 = _mm256_setzero_pd(), takeOut1 = _mm256_setzero_pd();
+    __m256i takeOutCount = zero;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(types + i));
+        __m256i tLow = _mm256_cvtepu8_epi64(packed);
+        __m256i tHigh = _mm256_cvtepu8_epi64(_mm_srli_si128(packed, 4));
+        __m256d maskLow = _mm256_castsi256_pd(_mm256_sub_epi64(zero, tLow)); // all ones for take-out
+        __m256d maskHigh = _mm256_castsi256_pd(_mm256_sub_epi64(zero, tHigh));
+        __m256d a0 = _mm256_loadu_pd(amounts + i);
+        __m256d a1 = _mm256_loadu_pd(amounts + i + 4);
+        takeOut0 = _mm256_add_pd(takeOut0, _mm256_and_pd(maskLow, a0));
+        sitIn0 = _mm256_add_pd(sitIn0, _mm256_andnot_pd(maskLow, a0));
+        takeOut1 = _mm256_add_pd(takeOut1, _mm256_and_pd(maskHigh, a1));
+        sitIn1 = _mm256_add_pd(sitIn1, _mm256_andnot_pd(maskHigh, a1));
+        takeOutCount = _mm256_add_epi64(takeOutCount, _mm256_add_epi64(tLow, tHigh));
+    }
+    double lanes[4];
+    uint64_t countLanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sitIn0, sitIn1));
+    double sitIn = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, _mm256_add_pd(takeOut0, takeOut1));
+    double takeOut = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(countLanes), takeOutCount);
+    uint64_t takeOuts = countLanes[0] + countLanes[1] + countLanes[2] + countLanes[3];
+    for (; i < n; i++) {
+        (types[i] ? takeOut : sitIn) += amounts[i];
+        takeOuts += types[i];
+    }
+    sums[0] += sitIn;
+    sums[1] += takeOut;
+    counts[0] += n - takeOuts;
+    counts[1] += takeOuts;
+}
+
+__attribute__((target("avx2")))
+void bucketByHourAvx2(const int64_t* timestamps, const double* amounts, size_t n,
+                      double sums[24], uint64_t counts[24]) {
+    const __m256i bias = _mm256_set1_epi64x(HOUR_BIAS);
+    const __m256i magicBits = _mm256_set1_epi64x(DOUBLE_MAGIC_BITS);
+    const __m256d magic = _mm256_castsi256_pd(magicBits);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d perDay = _mm256_set1_pd(1.0 / 86400);
+    const __m256d perHour = _mm256_set1_pd(1.0 / 3600);
+    const __m256d dayLength = _mm256_set1_pd(86400.0);
+    const __m128d ones = _mm_set1_pd(1.0);
+    LaneTables tables;
+    tables.reset(24);
+    int32_t hours[4];
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i t = _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(timestamps + i)), bias);
+        __m256d seconds = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(t, magicBits)), magic);
+        __m256d day = _mm256_floor_pd(_mm256_mul_pd(_mm256_add_pd(seconds, half), perDay));
+        __m256d second = _mm256_sub_pd(seconds, _mm256_mul_pd(day, dayLength));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(hours),
+                         _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_add_pd(second, half), perHour)));
+        __m256d a = _mm256_loadu_pd(amounts + i);
+        __m128d a01 = _mm256_castpd256_pd128(a);
+        __m128d a23 = _mm256_extractf128_pd(a, 1);
+        tables.add(0, static_cast<uint32_t>(hours[0]), _mm_unpacklo_pd(a01, ones));
+        tables.add(1, static_cast<uint32_t>(hours[1]), _mm_unpackhi_pd(a01, ones));
+        tables.add(2, static_cast<uint32_t>(hours[2]), _mm_unpacklo_pd(a23, ones));
+        tables.add(3, static_cast<uint32_t>(hours[3]), _mm_unpackhi_pd(a23, ones));
+    }
+    for (; i < n; i++) {
+        tables.add(0, hourOfDay(timestamps[i]), amounts[i]);
+    }
+    tables.flush(24, sums, counts);
+}
+
+const SalesKernels SSE2_SALES_KERNELS = {"sse2", sumByTypeSse2, sumByGroupSse2, bucketByHourSse2};
+const SalesKernels AVX2_SALES_KERNELS = {"avx2", sumByTypeAvx2, sumByGroupSse2, bucketByHourAvx2};
+#endif
+
+// Every kernel set this CPU can run, the fastest last
+vector<const SalesKernels*> supportedSalesKernels() {
+    vector<const SalesKernels*> kernels(1, &SCALAR_SALES_KERNELS);
+    #ifdef RESTAURANT_X86_DISPATCH
+        if (__builtin_cpu_supports("sse2")) {
+            kernels.push_back(&SSE2_SALES_KERNELS);
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            kernels.push_back(&AVX2_SALES_KERNELS);
+        }
+    #endif
+    return kernels;
+}
+
+const SalesKernels& salesKernels() {
+    static const SalesKernels* best = supportedSalesKernels().back();
+    return *best;
+}
+
+// Index of the highest set bit; value must be non-zero
+inline int highestBit(uint64_t value) {
+    #if defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+    #else
+        int bit = 0;
+        while (value >>= 1) {
+            bit++;
+        }
+        return bit;
+    #endif
+}
+
+// Streaming histogram of order amounts in the HDR-histogram style. Amounts are
+// counted in cents: one bucket per cent below R2.56, then 128 equal buckets
+// per power of two up to 2^40 cents. Memory is fixed whatever the order count,
+// and histograms merge by adding counters.
+//
+// Error bound: quantile(q) returns a value within 1/256 (0.39%) of the exact
+// nearest-rank quantile of the amounts rounded to cents, and the exact value
+// below R2.56. mean(), minAmount() and maxAmount() are exact.
+class AmountHistogram {
+public:
+    static const int SUB_BITS = 8;
+    static const int MAX_BITS = 40;
+    static const int BUCKETS = (1 << SUB_BITS) + (MAX_BITS - SUB_BITS) * (1 << (SUB_BITS - 1));
+
+private:
+    vector<uint64_t> counts;
+    uint64_t total;
+    int64_t minCents;
+    int64_t maxCents;
+    KahanSum sum;
+    
+    friend class RestaurantSnapshot;
+    
+    static int bucketOf(int64_t cents) {
+        if (cents < (1 << SUB_BITS)) {
+            return static_cast<int>(cents);
+        }
+        int high = highestBit(static_cast<uint64_t>(cents));
+        if (high >= MAX_BITS) {
+            return BUCKETS - 1;
+        }
+        int shift = high - (SUB_BITS - 1);
+        return (1 << SUB_BITS) + (high - SUB_BITS) * (1 << (SUB_BITS - 1)) +
+               static_cast<int>((cents >> shift) - (1 << (SUB_BITS - 1)));
+    }
+    
+    // Lowest amount in cents that falls in bucket index, and the bucket width
+    static int64_t bucketLow(int index, int64_t& width) {
+        if (index < (1 << SUB_BITS)) {
+            width = 1;
+            return index;
+        }
+        int offset = index - (1 << SUB_BITS);
+        int shift = offset / (1 << (SUB_BITS - 1)) + 1;
+        int64_t mantissa = (1 << (SUB_BITS - 1)) + offset % (1 << (SUB_BITS - 1));
+        width = int64_t(1) << shift;
+        return mantissa << shift;
+    }
+
+public:
+    AmountHistogram() : counts(BUCKETS, 0), total(0), minCents(0), maxCents(0) {}
+    
+    void add(double amount) {
+        int64_t cents = amount > 0 ? llround(amount * 100.0) : 0;
+        counts[bucketOf(cents)]++;
+        minCents = total == 0 ? cents : min(minCents, cents);
+        maxCents = total == 0 ? cents : max(maxCents, cents);
+        total++;
+        sum.add(amount);
+    }
+    
+    void merge(const AmountHistogram& other) {
+        if (other.total == 0) {
+            return;
+        }
+        for (int i = 0; i < BUCKETS; i++) {
+            counts[i] += other.counts[i];
+        }
+        minCents = total == 0 ? other.minCents : min(minCents, other.minCents);
+        maxCents = total == 0 ? other.maxCents : max(maxCents, other.maxCents);
+        total += other.total;
+        sum.add(other.sum.value());
+    }
+    
+    void clear() {
+        fill(counts.begin(), counts.end(), 0);
+        total = 0;
+        minCents = maxCents = 0;
+        sum = KahanSum();
+    }
+    
+    uint64_t count() const { return total; }
+    double mean() const { return total ? sum.value() / total : 0.0; }
+    double minAmount() const { return minCents / 100.0; }
+    double maxAmount() const { return maxCents / 100.0; }
+    
+    // Nearest-rank quantile, q in [0, 1]: the middle of the bucket holding
+    // the ceil(q * count)-th smallest amount, clamped to the observed range
+    double quantile(double q) const {
+        if (total == 0) {
+            return 0.0;
+        }
+        uint64_t rank = static_cast<uint64_t>(ceil(q * total));
+        rank = rank < 1 ? 1 : (rank > total ? total : rank);
+        uint64_t seen = 0;
+        int index = 0;
+        while (seen + counts[index] < rank) {
+            seen += counts[index++];
+        }
+        int64_t width;
+        double cents = bucketLow(index, width) + (width - 1) / 2.0;
+        cents = cents < minCents ? minCents : (cents > maxCents ? maxCents : cents);
+        return cents / 100.0;
+    }
+};
+
+// Orders counted by party size: 1 to MAX_SIZE, larger parties share the last bucket
+class PartySizeHistogram {
+public:
+    static const int MAX_SIZE = 12;
+
+private:
+    uint64_t counts[MAX_SIZE + 1]; // index 0 unused
+    
+    friend class RestaurantSnapshot;
+
+public:
+    PartySizeHistogram() : counts() {}
+    
+    void add(int partySize) {
+        counts[partySize < 1 ? 1 : (partySize > MAX_SIZE ? MAX_SIZE : partySize)]++;
+    }
+    
+    void merge(const PartySizeHistogram& other) {
+        for (int size = 1; size <= MAX_SIZE; size++) {
+            counts[size] += other.counts[size];
+        }
+    }
+    
+    void clear() {
+        fill(counts, counts + MAX_SIZE + 1, 0);
+    }
+    
+    // Orders with this party size (MAX_SIZE counts MAX_SIZE and up)
+    uint64_t count(int partySize) const { return counts[partySize]; }
+};
+
+// Waiter class
+class Waiter {
+private:
+    int waiterId;
+    string name;
+    const OrderStore* store;
+    vector<size_t> orderRows; // rows in the restaurant's OrderStore
+    KahanSum sales;           // running total, updated on every addOrder
+    AmountHistogram amounts;  // order value distribution
+    
+    friend class RestaurantSnapshot;
+
+public:
+    Waiter(int id, string n) : waiterId(id), name(move(n)), store(nullptr) {}
+    
+    int getWaiterId() const { return waiterId; }
+    const string& getName() const { return name; }
+    
+    void attachStore(const OrderStore* orderStore) {
+        store = orderStore;
+    }
+    
+    void addOrder(size_t row, double amount) {
+        orderRows.push_back(row);
+        sales.add(amount);
+        amounts.add(amount);
+    }
+    
+    // Forgets the day's orders; the row list keeps its capacity
+    void clearOrders() {
+        orderRows.clear();
+        sales = KahanSum();
+        amounts.clear();
+    }
+    
+    const AmountHistogram& getAmounts() const { return amounts; }
+    
+    double getTotalSales() const {
+        return sales.value();
+    }
+    
+    // 15% of sales
+    static double commissionOn(double sales) {
+        return sales * 0.15;
+    }
+    
+    double getCommission() const {
+        return commissionOn(getTotalSales());
+    }
+    
+    int getOrderCount() const {
+        return orderRows.size();
+    }
+    
+    OrderRange getOrders() const {
+        return OrderRange(store, orderRows.data(), orderRows.data() + orderRows.size());
+    }
+};
+
+// Read-only view of a whole file: memory-mapped where available, read into
+// memory otherwise
+class MappedFile {
+private:
+    const char* contents;
+    size_t length;
+    #ifdef _WIN32
+        vector<char> buffer;
+    #endif
+
+public:
+    MappedFile() : contents(nullptr), length(0) {}
+    
+    ~MappedFile() {
+        close();
+    }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool open(const string& path) {
+        close();
+        #ifdef _WIN32
+            FILE* file = fopen(path.c_str(), "rb");
+            if (!file) {
+                return false;
+            }
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            buffer.resize(size > 0 ? size : 0);
+            bool ok = size <= 0 || fread(buffer.data(), 1, buffer.size(), file) == buffer.size();
+            fclose(file);
+            contents = buffer.data();
+            length = buffer.size();
+            return ok;
+        #else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                ::close(fd);
+                return false;
+            }
+            length = static_cast<size_t>(info.st_size);
+            if (length > 0) {
+                void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    ::close(fd);
+                    length = 0;
+                    return false;
+                }
+                madvise(mapping, length, MADV_SEQUENTIAL);
+                contents = static_cast<const char*>(mapping);
+            }
+            ::close(fd);
+            return true;
+        #endif
+    }
+    
+    void close() {
+        #ifdef _WIN32
+            buffer.clear();
+        #else
+            if (contents && length > 0) {
+                munmap(const_cast<char*>(contents), length);
+            }
+        #endif
+        contents = nullptr;
+        length = 0;
+    }
+    
+    const char* data() const { return contents; }
+    size_t size() const { return length; }
+};
+
+// Hot-path instrumentation: call counts and time for order intake, the
+// reports, report output and menu dispatch. Collection is off until
+// Metrics::enable(); a disabled probe is one relaxed load and a branch.
+// Each thread records into its own shard with plain relaxed stores, never
+// a locked read-modify-write, and readers sum the shards. Shards of
+// finished threads stay registered so their totals are not lost.
+enum MetricTimer {
+    METRIC_ADD_ORDER,         // histogram timers first
+    METRIC_INTAKE_SUBMIT,
+    METRIC_INTAKE_QUEUE,
+    METRIC_PIPELINE_LATENCY,
+    METRIC_REPORT_COUNTS,
+    METRIC_REPORT_SALES,
+    METRIC_REPORT_WAITERS,
+    METRIC_REPORT_COMMISSION,
+    METRIC_REPORT_PATRONS,
+    METRIC_REPORT_VALUES,
+    METRIC_REPORT_HOURS,
+    METRIC_REPORT_ITEMS,
+    METRIC_REPORT_ORDERS,
+    METRIC_REPORT_STATISTICS,
+    METRIC_REPORT_ALL,
+    METRIC_REPORT_WRITE,
+    METRIC_MENU_FIRST         // one timer per menu choice from here on
+};
+
+const int METRIC_HISTOGRAM_COUNT = METRIC_PIPELINE_LATENCY + 1;
+const int METRIC_MENU_CHOICES = 32;  // choices 0-30, then one slot for anything else
+const int METRIC_TIMER_COUNT = METRIC_MENU_FIRST + METRIC_MENU_CHOICES;
+
+enum MetricCounter {
+    METRIC_REPORT_BYTES,
+    METRIC_COUNTER_COUNT
+};
+
+class Metrics {
+public:
+    // Bucket 0 is under 256 ns; bucket b covers [128 << b, 256 << b) ns, and
+    // the last is everything from about 17 s up
+    static const int LATENCY_BUCKETS = 28;
+    
+    struct Shard {
+        atomic<uint64_t> calls[METRIC_TIMER_COUNT];
+        atomic<uint64_t> nanoseconds[METRIC_TIMER_COUNT];
+        atomic<uint64_t> buckets[METRIC_HISTOGRAM_COUNT][LATENCY_BUCKETS];
+        atomic<uint64_t> counters[METRIC_COUNTER_COUNT];
+        
+        Shard() {
+            for (int t = 0; t < METRIC_TIMER_COUNT; t++) {
+                calls[t].store(0, memory_order_relaxed);
+                nanoseconds[t].store(0, memory_order_relaxed);
+            }
+            for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+                for (int b = 0; b < LATENCY_BUCKETS; b++) {
+                    buckets[h][b].store(0, memory_order_relaxed);
+                }
+            }
+            for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+                counters[c].store(0, memory_order_relaxed);
+            }
+        }
+    };
+    
+    // Plain totals summed over every shard
+    struct Totals {
+        uint64_t calls[METRIC_TIMER_COUNT];
+        uint64_t nanoseconds[METRIC_TIMER_COUNT];
+        uint64_t buckets[METRIC_HISTOGRAM_COUNT][LATENCY_BUCKETS];
+        uint64_t counters[METRIC_COUNTER_COUNT];
+    };
+
+private:
+    static atomic<bool> collecting;
+    static mutex shardsLock;
+    static vector<Shard*> shards;
+    
+    static Shard& localShard() {
+        static thread_local Shard* shard = nullptr;
+        if (!shard) {
+            shard = new Shard();
+            lock_guard<mutex> guard(shardsLock);
+            shards.push_back(shard);
+        }
+        return *shard;
+    }
+    
+    // Only the owning thread writes a shard, so a load and a store suffice
+    static void bump(atomic<uint64_t>& cell, uint64_t amount) {
+        cell.store(cell.load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+
+public:
+    static bool enabled() { return collecting.load(memory_order_relaxed); }
+    static void enable() { collecting.store(true, memory_order_relaxed); }
+    static void disable() { collecting.store(false, memory_order_relaxed); }
+    
+    static uint64_t now() {
+        return static_cast<uint64_t>(
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    
+    static int latencyBucket(uint64_t nanoseconds) {
+        if (nanoseconds < 256) {
+            return 0;
+        }
+        return min(highestBit(nanoseconds) - 7, LATENCY_BUCKETS - 1);
+    }
+    
+    static void recordTime(MetricTimer timer, uint64_t nanoseconds) {
+        Shard& shard = localShard();
+        bump(shard.calls[timer], 1);
+        bump(shard.nanoseconds[timer], nanoseconds);
+        if (timer < METRIC_HISTOGRAM_COUNT) {
+            bump(shard.buckets[timer][latencyBucket(nanoseconds)], 1);
+        }
+    }
+    
+    static void count(MetricCounter counter, uint64_t amount) {
+        if (enabled()) {
+            bump(localShard().counters[counter], amount);
+        }
+    }
+    
+    static MetricTimer menuTimer(int choice) {
+        int slot = choice >= 0 && choice < METRIC_MENU_CHOICES - 1 ? choice : METRIC_MENU_CHOICES - 1;
+        return static_cast<MetricTimer>(METRIC_MENU_FIRST + slot);
+    }
+    
+    static void snapshot(Totals& totals) {
+        memset(&totals, 0, sizeof(totals));
+        lock_guard<mutex> guard(shardsLock);
+        for (const Shard* shard : shards) {
+            for (int t = 0; t < METRIC_TIMER_COUNT; t++) {
+                totals.calls[t] += shard->calls[t].load(memory_order_relaxed);
+                totals.nanoseconds[t] += shard->nanoseconds[t].load(memory_order_relaxed);
+            }
+            for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+                for (int b = 0; b < LATENCY_BUCKETS; b++) {
+                    totals.buckets[h][b] += shard->buckets[h][b].load(memory_order_relaxed);
+                }
+            }
+            for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+                totals.counters[c] += shard->counters[c].load(memory_order_relaxed);
+            }
+        }
+    }
+};
+
+atomic<bool> Metrics::collecting(false);
+mutex Metrics::shardsLock;
+vector<Metrics::Shard*> Metrics::shards;
+
+// Times the enclosing scope into a MetricTimer when metrics are enabled
+class ScopedTimer {
+private:
+    MetricTimer timer;
+    uint64_t start;
+    bool active;
+
+public:
+    explicit ScopedTimer(MetricTimer t) : timer(t), start(0), active(Metrics::enabled()) {
+        if (active) {
+            start = Metrics::now();
+        }
+    }
+    
+    ~ScopedTimer() {
+        if (active) {
+            Metrics::recordTime(timer, Metrics::now() - start);
+        }
+    }
+    
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+// Buffered report renderer: formats fixed-width rows into a large reusable
+// buffer and hands it to stdout or a file in a few big writes, instead of
+// going through iostream manipulators and a flush on every row
+class ReportWriter {
+private:
+    FILE* target;
+    bool ownsTarget;
+    bool failed;      // a write came up short (disk full, closed pipe)
+    vector<char> buffer;
+    size_t used;
+    
+    char* reserve(size_t n) {
+        if (used + n > buffer.size()) {
+            flush();
+            if (n > buffer.size()) {
+                buffer.resize(n);
+            }
+        }
+        return buffer.data() + used;
+    }
+    
+    ReportWriter& padded(const char* s, size_t length, int width, bool alignLeft) {
+        size_t padding = static_cast<int>(length) < width ? width - length : 0;
+        char* out = reserve(length + padding);
+        if (!alignLeft) {
+            memset(out, ' ', padding);
+            out += padding;
+        }
+        memcpy(out, s, length);
+        out += length;
+        if (alignLeft) {
+            memset(out, ' ', padding);
+        }
+        used += length + padding;
+        return *this;
+    }
+    
+    // Writes the digits of value backwards ending at end; returns the first digit
+    static char* formatDigits(uint64_t value, char* end) {
+        do {
+            *--end = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        return end;
+    }
+
+public:
+    static const size_t BUFFER_SIZE = 256 * 1024;
+    
+    explicit ReportWriter(FILE* out) : target(out), ownsTarget(false), failed(false), buffer(BUFFER_SIZE), used(0) {}
+    
+    explicit ReportWriter(const string& path)
+        : target(fopen(path.c_str(), "wb")), ownsTarget(true), failed(false), buffer(BUFFER_SIZE), used(0) {}
+    
+    ~ReportWriter() {
+        flush();
+        if (ownsTarget && target) {
+            fclose(target);
+        }
+    }
+    
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+    
+    bool isOpen() const { return target != nullptr; }
+    bool hasFailed() const { return failed; }
+    
+    void flush() {
+        if (target && used > 0) {
+            ScopedTimer timer(METRIC_REPORT_WRITE);
+            Metrics::count(METRIC_REPORT_BYTES, used);
+            failed = fwrite(buffer.data(), 1, used, target) != used || fflush(target) != 0 || failed;
+        }
+        used = 0;
+    }
+    
+    // Flushes and has the OS put the file on disk; false if any write failed
+    bool sync() {
+        flush();
+        if (target) {
+            failed = fflush(target) != 0 || failed;
+            #ifdef _WIN32
+                failed = _commit(_fileno(target)) != 0 || failed;
+            #else
+                failed = fsync(fileno(target)) != 0 || failed;
+            #endif
+        }
+        return !failed;
+    }
+    
+    ReportWriter& text(const char* s, size_t length) { return padded(s, length, 0, true); }
+    ReportWriter& text(const char* s) { return text(s, strlen(s)); }
+    ReportWriter& text(const string& s) { return text(s.data(), s.size()); }
+    
+    ReportWriter& newline() {
+        *reserve(1) = '\n';
+        used++;
+        return *this;
+    }
+    
+    // Fixed-width columns, padded like setw() with left or right alignment
+    ReportWriter& left(const char* s, int width) { return padded(s, strlen(s), width, true); }
+    ReportWriter& left(StringRef s, int width) { return padded(s.data(), s.size(), width, true); }
+    ReportWriter& right(const char* s, int width) { return padded(s, strlen(s), width, false); }
+    ReportWriter& right(StringRef s, int width) { return padded(s.data(), s.size(), width, false); }
+    
+    ReportWriter& number(int64_t value, int width, bool alignLeft = false) {
+        char scratch[24];
+        char* end = scratch + sizeof(scratch);
+        uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        char* start = formatDigits(magnitude, end);
+        if (value < 0) {
+            *--start = '-';
+        }
+        return padded(start, end - start, width, alignLeft);
+    }
+    
+    // Currency amount with two decimals, right-aligned; same digits as fixed << setprecision(2)
+    ReportWriter& amount(double value, int width) {
+        char scratch[48];
+        if (!(fabs(value) < 1e13)) {
+            int length = snprintf(scratch, sizeof(scratch), "%.2f", value);
+            return padded(scratch, length, width, false);
+        }
+        int64_t cents = roundCents(value);
+        uint64_t magnitude = cents < 0 ? 0 - static_cast<uint64_t>(cents) : static_cast<uint64_t>(cents);
+        char* end = scratch + sizeof(scratch);
+        char* start = end;
+        *--start = static_cast<char>('0' + magnitude % 10);
+        *--start = static_cast<char>('0' + magnitude / 10 % 10);
+        *--start = '.';
+        start = formatDigits(magnitude / 100, start);
+        if (signbit(value)) {
+            *--start = '-';
+        }
+        return padded(start, end - start, width, false);
+    }
+    
+    // Raw bytes, for binary output
+    ReportWriter& bytes(const void* data, size_t length) {
+        if (length > buffer.size()) {
+            flush();
+            if (target) {
+                ScopedTimer timer(METRIC_REPORT_WRITE);
+                Metrics::count(METRIC_REPORT_BYTES, length);
+                failed = fwrite(data, 1, length, target) != length || failed;
+            }
+            return *this;
+        }
+        memcpy(reserve(length), data, length);
+        used += length;
+        return *this;
+    }
+    
+    // RFC 4180 field: quoted only when it contains a separator, quote or line break
+    ReportWriter& csvField(StringRef s) {
+        static const char specials[] = ",\"\r\n";
+        const char* begin = s.data();
+        const char* end = begin + s.size();
+        if (find_first_of(begin, end, specials, specials + 4) == end) {
+            return text(begin, s.size());
+        }
+        text("\"");
+        const char* quote;
+        while ((quote = find(begin, end, '"')) != end) {
+            text(begin, quote - begin + 1).text("\"");
+            begin = quote + 1;
+        }
+        return text(begin, end - begin).text("\"");
+    }
+    
+    // Quoted JSON string with the mandatory escapes; UTF-8 passes through unchanged
+    ReportWriter& jsonString(StringRef s) {
+        static const char hex[] = "0123456789abcdef";
+        text("\"");
+        size_t start = 0;
+        for (size_t i = 0; i < s.size(); i++) {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            text(s.data() + start, i - start);
+            start = i + 1;
+            switch (c) {
+                case '"': text("\\\""); break;
+                case '\\': text("\\\\"); break;
+                case '\n': text("\\n"); break;
+                case '\r': text("\\r"); break;
+                case '\t': text("\\t"); break;
+                default: {
+                    char escape[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+                    text(escape, sizeof(escape));
+                }
+            }
+        }
+        return text(s.data() + start, s.size() - start).text("\"");
+    }
+    
+    ReportWriter& rule(int width, char ch) {
+        memset(reserve(width), ch, width);
+        used += width;
+        return *this;
+    }
+    
+    // value * 100 rounded to the nearest integer exactly as printf("%.2f") rounds:
+    // the product is split so that it is held exactly, and ties go to even
+    static int64_t roundCents(double value) {
+        const double split = 134217729.0 * value; // Veltkamp split into two 26-bit halves
+        const double hi = split - (split - value);
+        const double lo = value - hi;
+        const double productHi = hi * 100.0;
+        const double productLo = lo * 100.0;
+        double cents = nearbyint(productHi + productLo);
+        const double residual = productHi - cents;
+        const double upper = 0.5 - residual;
+        const double lower = -0.5 - residual;
+        const bool odd = fmod(cents, 2.0) != 0.0;
+        if (productLo > upper || (productLo == upper && odd)) {
+            cents += 1.0;
+        } else if (productLo < lower || (productLo == lower && odd)) {
+            cents -= 1.0;
+        }
+        return static_cast<int64_t>(cents);
+    }
+};
+
+// Prometheus text exposition of the metrics. Intake latencies are
+// histograms; the other timers are summaries with a count and a sum.
+void writeMetrics(ReportWriter& out) {
+    Metrics::Totals totals;
+    Metrics::snapshot(totals);
+    char number[32];
+    auto seconds = [&number](uint64_t nanoseconds) {
+        snprintf(number, sizeof(number), "%.12g", static_cast<double>(nanoseconds) / 1e9);
+        return number;
+    };
+    
+    struct Family {
+        const char* name;
+        const char* help;
+    };
+    const Family histograms[METRIC_HISTOGRAM_COUNT] = {
+        {"restaurant_add_order_seconds", "Time spent adding an order to the restaurant"},
+        {"restaurant_intake_submit_seconds", "Time a POS terminal spends submitting an order, waits for a full ring included"},
+        {"restaurant_intake_queue_seconds", "Time from terminal submit until the order is published to the restaurant"},
+        {"restaurant_pipeline_seconds", "Time from a feed line entering the order pipeline until its order is in the restaurant"}};
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+        out.text("# HELP ").text(histograms[h].name).text(" ").text(histograms[h].help).newline();
+        out.text("# TYPE ").text(histograms[h].name).text(" histogram").newline();
+        uint64_t cumulative = 0;
+        for (int b = 0; b < Metrics::LATENCY_BUCKETS; b++) {
+            cumulative += totals.buckets[h][b];
+            out.text(histograms[h].name).text("_bucket{le=\"");
+            out.text(b + 1 < Metrics::LATENCY_BUCKETS ? seconds(uint64_t(256) << b) : "+Inf").text("\"} ");
+            out.number(static_cast<int64_t>(cumulative), 0).newline();
+        }
+        out.text(histograms[h].name).text("_sum ").text(seconds(totals.nanoseconds[h])).newline();
+        out.text(histograms[h].name).text("_count ").number(static_cast<int64_t>(totals.calls[h]), 0).newline();
+    }
+    
+    auto summary = [&](const char* name, const char* label, const char* value, int timer) {
+        out.text(name).text("_sum{").text(label).text("=\"").text(value).text("\"} ");
+        out.text(seconds(totals.nanoseconds[timer])).newline();
+        out.text(name).text("_count{").text(label).text("=\"").text(value).text("\"} ");
+        out.number(static_cast<int64_t>(totals.calls[timer]), 0).newline();
+    };
+    const char* const reports[] = {"order_counts", "total_sales", "waiter_sales", "waiter_commission", "top_patrons",
+                                   "order_values", "sales_by_hour", "item_sales", "all_orders", "statistics", "all"};
+    out.text("# HELP restaurant_report_seconds Time spent building each report").newline();
+    out.text("# TYPE restaurant_report_seconds summary").newline();
+    for (int r = METRIC_REPORT_COUNTS; r <= METRIC_REPORT_ALL; r++) {
+        summary("restaurant_report_seconds", "report", reports[r - METRIC_REPORT_COUNTS], r);
+    }
+    
+    out.text("# HELP restaurant_report_write_seconds Time spent writing report output to its file or terminal").newline();
+    out.text("# TYPE restaurant_report_write_seconds summary").newline();
+    out.text("restaurant_report_write_seconds_sum ").text(seconds(totals.nanoseconds[METRIC_REPORT_WRITE])).newline();
+    out.text("restaurant_report_write_seconds_count ");
+    out.number(static_cast<int64_t>(totals.calls[METRIC_REPORT_WRITE]), 0).newline();
+    out.text("# HELP restaurant_report_written_bytes_total Bytes of report output written").newline();
+    out.text("# TYPE restaurant_report_written_bytes_total counter").newline();
+    out.text("restaurant_report_written_bytes_total ");
+    out.number(static_cast<int64_t>(totals.counters[METRIC_REPORT_BYTES]), 0).newline();
+    
+    out.text("# HELP restaurant_menu_seconds Time spent handling each menu choice, reports included").newline();
+    out.text("# TYPE restaurant_menu_seconds summary").newline();
+    for (int choice = 0; choice < METRIC_MENU_CHOICES; choice++) {
+        int timer = METRIC_MENU_FIRST + choice;
+        if (totals.calls[timer] == 0) {
+            continue;
+        }
+        char label[16];
+        snprintf(label, sizeof(label), "%d", choice);
+        summary("restaurant_menu_seconds", "choice", choice + 1 < METRIC_MENU_CHOICES ? label : "other", timer);
+    }
+}
+
+bool fileExists(const string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file) {
+        fclose(file);
+    }
+    return file != nullptr;
+}
+
+bool truncateFile(const string& path, uint64_t size) {
+    #ifdef _WIN32
+        FILE* file = fopen(path.c_str(), "r+b");
+        if (!file) {
+            return false;
+        }
+        bool ok = _chsize_s(_fileno(file), static_cast<__int64>(size)) == 0;
+        fclose(file);
+        return ok;
+    #else
+        return truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+    #endif
+}
+
+bool makeDirectory(const string& path) {
+    #ifdef _WIN32
+        return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+    #else
+        return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+    #endif
+}
+
+// Fixed-size journal record. Strings (items and names) live in the side pool
+// and are referenced by offset. The checksum covers the other 44 bytes.
+struct JournalRecord {
+    uint32_t checksum;
+    uint8_t kind;         // JournalRecordKind
+    uint8_t type;         // ORDER: OrderType, PATRON: PatronType
+    uint16_t flags;       // PATRON: 1 for sit-in, 2 for a guest; ORDER: party size, 0x8000 for a group
+    int32_t id;           // ORDER: order id, WAITER: waiter id, PATRON: group size
+    uint32_t waiter;      // ORDER: waiter index
+    uint32_t patron;      // ORDER: patron id
+    uint32_t textLength;
+    uint64_t textOffset;  // offset of the pool entry holding the string
+    int64_t timestamp;    // ORDER: epoch seconds
+    double amount;        // ORDER: total amount
+};
+
+static_assert(sizeof(JournalRecord) == 48, "journal records must stay 48 bytes");
+
+enum JournalRecordKind {
+    JOURNAL_WAITER = 1,
+    JOURNAL_PATRON = 2,
+    JOURNAL_ORDER = 3,
+    JOURNAL_CLOSE_DAY = 4
+};
+
+// Append-only write-ahead journal of everything added to a Restaurant.
+// Records go to numbered segment files (journal-000001.seg, ...) that rotate
+// once they reach the size limit; strings go once each to strings.pool as
+// {uint32 length, uint32 CRC-32C, bytes}. Replay maps the files, verifies every
+// checksum and truncates a torn tail left by a crash. The first failed
+// write, flush or sync stops all further appends, and every later commit()
+// reports it: the files then hold only what was durable before.
+class OrderJournal {
+private:
+    string directory;
+    uint64_t maxSegmentBytes;
+    FILE* segment;
+    FILE* pool;
+    int segmentNumber;
+    uint64_t segmentBytes;
+    uint64_t poolBytes;
+    bool rotationFailed;          // the next segment could not be opened
+    int writeError;               // errno of the first failed write or sync; 0 while healthy
+    vector<uint64_t> itemOffsets; // pool offset per OrderStore item id
+    
+    static const uint64_t NO_OFFSET = ~0ULL;
+    
+    string segmentPath(int number) const {
+        char name[32];
+        snprintf(name, sizeof(name), "journal-%06d.seg", number);
+        return directory + "/" + name;
+    }
+    
+    string poolPath() const { return directory + "/strings.pool"; }
+    
+    // Switches to segment number, keeping the current one if it cannot be
+    // opened. Replay needs every string a closed segment refers to, so the
+    // pool is committed along with the old segment before it is closed.
+    bool openSegment(int number) {
+        FILE* next = fopen(segmentPath(number).c_str(), "ab");
+        if (!next) {
+            return false;
+        }
+        if (segment) {
+            if (!commit()) {
+                fclose(next);
+                return false;
+            }
+            fclose(segment);
+        }
+        segmentNumber = number;
+        segment = next;
+        fseek(segment, 0, SEEK_END);
+        segmentBytes = static_cast<uint64_t>(ftell(segment));
+        return true;
+    }
+    
+    // Writes size bytes unless an earlier write failed; latches the first failure
+    bool write(FILE* file, const void* data, size_t size) {
+        if (writeError == 0 && fwrite(data, 1, size, file) != size) {
+            writeError = errno != 0 ? errno : EIO;
+        }
+        return writeError == 0;
+    }
+    
+    uint64_t appendString(const string& text) {
+        uint64_t offset = poolBytes;
+        uint32_t header[2] = {static_cast<uint32_t>(text.size()), crc32c(text.data(), text.size())};
+        if (write(pool, header, sizeof(header)) && write(pool, text.data(), text.size())) {
+            poolBytes += sizeof(header) + text.size();
+        }
+        return offset;
+    }
+    
+    void appendRecord(JournalRecord& record) {
+        if (writeError != 0) {
+            return;
+        }
+        if (segmentBytes + sizeof(record) > maxSegmentBytes && segmentBytes > 0 && !rotationFailed &&
+            !openSegment(segmentNumber + 1)) {
+            if (writeError != 0) {
+                return; // committing the full segment failed
+            }
+            // Replay does not mind an oversized segment, so carry on in this one
+            cerr << "Cannot start journal segment " << segmentPath(segmentNumber + 1) << ": " << strerror(errno)
+                 << "; continuing in the current one" << endl;
+            rotationFailed = true;
+        }
+        record.checksum = crc32c(reinterpret_cast<const char*>(&record) + 4, sizeof(record) - 4);
+        if (write(segment, &record, sizeof(record))) {
+            segmentBytes += sizeof(record);
+        }
+    }
+    
+    static JournalRecord blankRecord(uint8_t kind) {
+        JournalRecord record;
+        memset(&record, 0, sizeof(record));
+        record.kind = kind;
+        return record;
+    }
+    
+    // Length of the valid prefix of the pool: entries are walked and checked
+    // until the first truncated or corrupt one
+    static uint64_t validPoolLength(const MappedFile& file) {
+        uint64_t offset = 0;
+        while (offset + 8 <= file.size()) {
+            uint32_t header[2];
+            memcpy(header, file.data() + offset, sizeof(header));
+            if (header[0] > file.size() - offset - 8 || crc32c(file.data() + offset + 8, header[0]) != header[1]) {
+                break;
+            }
+            offset += 8 + header[0];
+        }
+        return offset;
+    }
+    
+    static bool poolString(const MappedFile& file, uint64_t validLength, const JournalRecord& record, string& text) {
+        if (record.textOffset + 8 + record.textLength > validLength) {
+            return false;
+        }
+        uint32_t length;
+        memcpy(&length, file.data() + record.textOffset, 4);
+        if (length != record.textLength) {
+            return false;
+        }
+        text.assign(file.data() + record.textOffset + 8, length);
+        return true;
+    }
+
+public:
+    static const uint64_t DEFAULT_SEGMENT_BYTES = 64ULL * 1024 * 1024;
+    
+    OrderJournal(const string& dir, uint64_t segmentLimit = DEFAULT_SEGMENT_BYTES)
+        : directory(dir), maxSegmentBytes(segmentLimit), segment(nullptr), pool(nullptr),
+          segmentNumber(1), segmentBytes(0), poolBytes(0), rotationFailed(false), writeError(0) {}
+    
+    ~OrderJournal() {
+        commit();
+        if (segment) {
+            fclose(segment);
+        }
+        if (pool) {
+            fclose(pool);
+        }
+    }
+    
+    OrderJournal(const OrderJournal&) = delete;
+    OrderJournal& operator=(const OrderJournal&) = delete;
+    
+    // Replays the existing journal into sink, then opens it for appending.
+    // Sink provides restoreWaiter, restorePatron, internItems, restoreOrder,
+    // closeDay, reserveOrders, getWaiterCount and getPatronCount (Restaurant
+    // does).
+    // Returns false if the directory cannot be used or a segment other than
+    // the last is corrupt; replayed counts the orders.
+    template <typename Sink>
+    bool open(Sink& sink, size_t& replayed) {
+        replayed = 0;
+        if (!makeDirectory(directory)) {
+            return false;
+        }
+        
+        MappedFile poolFile;
+        uint64_t poolValid = 0;
+        if (fileExists(poolPath())) {
+            if (!poolFile.open(poolPath())) {
+                return false;
+            }
+            poolValid = validPoolLength(poolFile);
+            if (poolValid < poolFile.size()) {
+                cerr << "Journal: truncating torn string pool tail (" << poolFile.size() - poolValid << " bytes)" << endl;
+            }
+        }
+        
+        // Estimate the order count from the segment sizes so the store is reserved once
+        int lastSegment = 0;
+        uint64_t totalBytes = 0;
+        while (fileExists(segmentPath(lastSegment + 1))) {
+            MappedFile probe;
+            if (probe.open(segmentPath(++lastSegment))) {
+                totalBytes += probe.size();
+            }
+        }
+        sink.reserveOrders(totalBytes / sizeof(JournalRecord));
+        
+        unordered_map<uint64_t, uint32_t> itemIds; // pool offset -> item id
+        string text;
+        for (int number = 1; number <= lastSegment; number++) {
+            MappedFile file;
+            if (!file.open(segmentPath(number))) {
+                return false;
+            }
+            const size_t count = file.size() / sizeof(JournalRecord);
+            size_t valid = 0;
+            for (; valid < count; valid++) {
+                JournalRecord record;
+                memcpy(&record, file.data() + valid * sizeof(record), sizeof(record));
+                if (crc32c(reinterpret_cast<const char*>(&record) + 4, sizeof(record) - 4) != record.checksum) {
+                    break;
+                }
+                if (record.kind == JOURNAL_ORDER) {
+                    if (record.waiter >= sink.getWaiterCount() || record.patron >= sink.getPatronCount() || record.type > 1 ||
+                        (record.flags & 0x7FFF) == 0) {
+                        break;
+                    }
+                    auto it = itemIds.find(record.textOffset);
+                    uint32_t itemId;
+                    if (it != itemIds.end()) {
+                        itemId = it->second;
+                    } else {
+                        if (!poolString(poolFile, poolValid, record, text)) {
+                            break;
+                        }
+                        itemId = sink.internItems(text);
+                        itemIds.emplace(record.textOffset, itemId);
+                        if (itemId >= itemOffsets.size()) {
+                            itemOffsets.resize(itemId + 1, NO_OFFSET);
+                        }
+                        itemOffsets[itemId] = record.textOffset;
+                    }
+                    PatronType partyType = (record.flags & 0x8000) ? PatronType::GROUP : PatronType::INDIVIDUAL;
+                    int partySize = record.flags & 0x7FFF;
+                    sink.restoreOrder(record.id, record.patron, partyType, partySize,
+                                      static_cast<OrderType>(record.type), record.amount, record.waiter, itemId,
+                                      record.timestamp);
+                    replayed++;
+                } else if (record.kind == JOURNAL_WAITER || record.kind == JOURNAL_PATRON) {
+                    if (!poolString(poolFile, poolValid, record, text)) {
+                        break;
+                    }
+                    if (record.kind == JOURNAL_WAITER) {
+                        sink.restoreWaiter(record.id, text);
+                    } else {
+                        sink.restorePatron(text, static_cast<PatronType>(record.type), record.id, record.flags & 1,
+                                           (record.flags & 2) != 0);
+                    }
+                } else if (record.kind == JOURNAL_CLOSE_DAY) {
+                    sink.closeDay();
+                } else {
+                    break;
+                }
+            }
+            
+            if (valid * sizeof(JournalRecord) < file.size()) {
+                // Only the last segment can have a torn tail; damage anywhere else
+                // would silently drop later segments, so leave the files alone
+                if (number != lastSegment) {
+                    cerr << "Journal: corrupt record " << valid << " in segment " << number << endl;
+                    return false;
+                }
+                uint64_t validBytes = valid * sizeof(JournalRecord);
+                cerr << "Journal: truncating torn tail of segment " << number << " ("
+                     << file.size() - validBytes << " bytes)" << endl;
+                file.close();
+                truncateFile(segmentPath(number), validBytes);
+            }
+        }
+        
+        poolFile.close();
+        if (poolValid > 0 || fileExists(poolPath())) {
+            truncateFile(poolPath(), poolValid);
+        }
+        pool = fopen(poolPath().c_str(), "ab");
+        poolBytes = poolValid;
+        return pool && openSegment(lastSegment > 0 ? lastSegment : 1);
+    }
+    
+    const string& getDirectory() const { return directory; }
+    
+    void appendWaiter(int waiterId, const string& name) {
+        JournalRecord record = blankRecord(JOURNAL_WAITER);
+        record.id = waiterId;
+        record.textLength = static_cast<uint32_t>(name.size());
+        record.textOffset = appendString(name);
+        appendRecord(record);
+    }
+    
+    void appendPatron(const string& name, PatronType type, int groupSize, bool sitIn, bool guest) {
+        JournalRecord record = blankRecord(JOURNAL_PATRON);
+        record.type = static_cast<uint8_t>(type);
+        record.flags = (sitIn ? 1 : 0) | (guest ? 2 : 0);
+        record.id = groupSize;
+        record.textLength = static_cast<uint32_t>(name.size());
+        record.textOffset = appendString(name);
+        appendRecord(record);
+    }
+    
+    void appendCloseDay() {
+        JournalRecord record = blankRecord(JOURNAL_CLOSE_DAY);
+        appendRecord(record);
+    }
+    
+    void appendOrder(int orderId, uint32_t patronId, PatronType partyType, int partySize, OrderType type,
+                     double amount, uint32_t waiterIndex, uint32_t itemId, const string& items, int64_t epochSeconds) {
+        if (itemId >= itemOffsets.size()) {
+            itemOffsets.resize(itemId + 1, NO_OFFSET);
+        }
+        if (itemOffsets[itemId] == NO_OFFSET) {
+            itemOffsets[itemId] = appendString(items);
+        }
+        JournalRecord record = blankRecord(JOURNAL_ORDER);
+        record.type = static_cast<uint8_t>(type);
+        record.flags = static_cast<uint16_t>(max(1, min(partySize, 0x7FFF)) |
+                                             (partyType == PatronType::GROUP ? 0x8000 : 0));
+        record.id = orderId;
+        record.waiter = waiterIndex;
+        record.patron = patronId;
+        record.textLength = static_cast<uint32_t>(items.size());
+        record.textOffset = itemOffsets[itemId];
+        record.timestamp = epochSeconds;
+        record.amount = amount;
+        appendRecord(record);
+    }
+    
+    // Makes everything appended so far durable: strings before the records
+    // that use them. False once any write, flush or sync has failed.
+    bool commit() {
+        FILE* files[] = {pool, segment};
+        for (FILE* file : files) {
+            if (file && writeError == 0) {
+                bool synced = fflush(file) == 0;
+                #ifdef _WIN32
+                    synced = synced && _commit(_fileno(file)) == 0;
+                #else
+                    synced = synced && fsync(fileno(file)) == 0;
+                #endif
+                if (!synced) {
+                    writeError = errno != 0 ? errno : EIO;
+                }
+            }
+        }
+        return writeError == 0;
+    }
+    
+    // Why the journal stopped taking appends; only meaningful after commit() failed
+    const char* getErrorText() const { return strerror(writeError); }
+};
+
+const uint64_t OrderJournal::NO_OFFSET;
+const uint64_t OrderJournal::DEFAULT_SEGMENT_BYTES;
+
+// Aggregation engine. Group-by keys and measures are template parameters,
+// so a pass over the order columns is one loop with every key and measure
+// inlined, and several aggregates can share that loop:
+//
+//     Aggregate<GroupBy<ByWaiter, ByOrderType>, Count, Sum<Amount>> sales;
+//     Aggregate<GroupBy<ByHour>, Sum<Amount>> hours;
+//     restaurant.aggregate(sales, hours);
+//
+// Groups are numbered row-major, first key outermost: the group of waiter w
+// and order type t above is w * 2 + t.
+struct OrderColumns {
+    const double* amounts;
+    const uint8_t* types;       // OrderType
+    const uint32_t* waiters;    // position in the restaurant's waiter list
+    const int64_t* timestamps;
+    size_t size;
+    size_t waiterCount;
+};
+
+// Keys: how many groups there are and which one a row falls in
+struct ByOrderType {
+    static size_t groups(const OrderColumns&) { return 2; }
+    static size_t of(const OrderColumns& orders, size_t row) { return orders.types[row]; }
+};
+
+struct ByWaiter {
+    static size_t groups(const OrderColumns& orders) { return orders.waiterCount; }
+    static size_t of(const OrderColumns& orders, size_t row) { return orders.waiters[row]; }
+};
+
+struct ByHour {
+    static size_t groups(const OrderColumns&) { return 24; }
+    static size_t of(const OrderColumns& orders, size_t row) { return hourOfDay(orders.timestamps[row]); }
+};
+
+template <typename... Keys>
+struct GroupBy;
+
+template <>
+struct GroupBy<> {
+    static size_t groups(const OrderColumns&) { return 1; }
+    static size_t of(const OrderColumns&, size_t) { return 0; }
+};
+
+template <typename Key, typename... Rest>
+struct GroupBy<Key, Rest...> {
+    static size_t groups(const OrderColumns& orders) { return Key::groups(orders) * GroupBy<Rest...>::groups(orders); }
+    static size_t of(const OrderColumns& orders, size_t row) {
+        return Key::of(orders, row) * GroupBy<Rest...>::groups(orders) + GroupBy<Rest...>::of(orders, row);
+    }
+};
+
+// Measures: a State per group and how a row adds to it
+struct Amount {
+    static double of(const OrderColumns& orders, size_t row) { return orders.amounts[row]; }
+};
+
+struct Count {
+    typedef uint64_t State;
+    static void add(State& state, const OrderColumns&, size_t) { state++; }
+};
+
+template <typename Field>
+struct Sum {
+    typedef double State;
+    static void add(State& state, const OrderColumns& orders, size_t row) { state += Field::of(orders, row); }
+};
+
+// Commission under a rule with a static onOrder(OrderType, amount)
+template <typename Rule>
+struct Commission {
+    typedef double State;
+    static void add(State& state, const OrderColumns& orders, size_t row) {
+        state += Rule::onOrder(static_cast<OrderType>(orders.types[row]), orders.amounts[row]);
+    }
+};
+
+// Commission rules. Each is a plain struct, so the rule is compiled into
+// the aggregation loop rather than called through a pointer.
+struct FlatCommission {
+    static const char* describe() { return "15% of total sales"; }
+    static double onOrder(OrderType, double amount) { return Waiter::commissionOn(amount); }
+};
+
+struct OrderTypeCommission {
+    static const char* describe() { return "15% of sit-in, 10% of take-out sales"; }
+    static double onOrder(OrderType type, double amount) {
+        return amount * (type == OrderType::SIT_IN ? 0.15 : 0.10);
+    }
+};
+
+// Marginal rates on each order: bigger tickets earn more on the part above each tier
+struct TieredCommission {
+    static const char* describe() { return "per order 10% to R200, 15% to R1000, 20% above"; }
+    static double onOrder(OrderType, double amount) {
+        return 0.10 * min(amount, 200.0) + 0.15 * max(0.0, min(amount, 1000.0) - 200.0) +
+               0.20 * max(0.0, amount - 1000.0);
+    }
+};
+
+enum class CommissionRule {
+    FLAT,
+    BY_ORDER_TYPE,
+    TIERED
+};
+
+template <typename... Measures>
+struct MeasureSet;
+
+template <>
+struct MeasureSet<> {
+    void resize(size_t) {}
+    void add(size_t, const OrderColumns&, size_t) {}
+};
+
+template <typename Measure, typename... Rest>
+struct MeasureSet<Measure, Rest...> : MeasureSet<Rest...> {
+    vector<typename Measure::State> states; // by group
+    
+    void resize(size_t groups) {
+        states.assign(groups, typename Measure::State());
+        MeasureSet<Rest...>::resize(groups);
+    }
+    
+    void add(size_t group, const OrderColumns& orders, size_t row) {
+        Measure::add(states[group], orders, row);
+        MeasureSet<Rest...>::add(group, orders, row);
+    }
+};
+
+// The states of Measure in a set, found through the base class that holds it
+template <typename Measure, typename... Rest>
+const vector<typename Measure::State>& measureStates(const MeasureSet<Measure, Rest...>& set) {
+    return set.states;
+}
+
+template <typename Group, typename... Measures>
+class Aggregate {
+private:
+    MeasureSet<Measures...> measures;
+    size_t groupCount;
+
+public:
+    Aggregate() : groupCount(0) {}
+    
+    void reset(const OrderColumns& orders) {
+        groupCount = Group::groups(orders);
+        measures.resize(groupCount);
+    }
+    
+    void add(const OrderColumns& orders, size_t row) {
+        measures.add(Group::of(orders, row), orders, row);
+    }
+    
+    size_t groups() const { return groupCount; }
+    
+    template <typename Measure>
+    typename Measure::State get(size_t group) const {
+        return measureStates<Measure>(measures)[group];
+    }
+};
+
+// Fills every aggregate in one pass over the orders
+template <typename... Aggregates>
+void aggregateOrders(const OrderColumns& orders, Aggregates&... aggregates) {
+    int resets[] = {0, (aggregates.reset(orders), 0)...};
+    (void)resets;
+    for (size_t row = 0; row < orders.size; row++) {
+        int adds[] = {0, (aggregates.add(orders, row), 0)...};
+        (void)adds;
+    }
+}
+
+// Totals recomputed from the order columns by Restaurant::scanSales
+struct SalesScan {
+    double typeSales[2];        // by OrderType
+    uint64_t typeCounts[2];
+    vector<double> waiterSales; // by position in getWaiters()
+    vector<uint64_t> waiterCounts;
+    double hourSales[24];       // by hour of day
+    uint64_t hourCounts[24];
+};
+
+// Per-item sales from the line items, all indexed by menu item id. An
+// order's amount is split over its lines by list price times quantity, or
+// by quantity alone when a line has no known price.
+struct ItemScan {
+    vector<uint64_t> quantities;
+    vector<uint64_t> orderCounts;  // orders with at least one of the item
+    vector<double> revenue;
+    vector<double> hourRevenue;    // [item * 24 + hour]
+    double totalRevenue;
+    
+    // Item ids by revenue, best first; equal revenue goes to the lower id
+    vector<uint32_t> topItems(size_t count) const {
+        vector<uint32_t> ids(revenue.size());
+        for (uint32_t id = 0; id < ids.size(); id++) {
+            ids[id] = id;
+        }
+        count = min(count, ids.size());
+        partial_sort(ids.begin(), ids.begin() + count, ids.end(), [this](uint32_t a, uint32_t b) {
+            return revenue[a] > revenue[b] || (revenue[a] == revenue[b] && a < b);
+        });
+        ids.resize(count);
+        return ids;
+    }
+};
+
+// Restaurant class
+class Restaurant {
+private:
+    string name;
+    vector<shared_ptr<Waiter>> waiters;
+    PatronStore patrons;
+    unordered_map<const Waiter*, uint32_t> waiterIndex;
+    OrderStore orders;
+    TimeIndex timeIndex;
+    atomic<int> nextOrderId; // shared with OrderIntake terminals
+    OrderJournal* journal; // optional write-ahead journal, not owned
+    CommissionRule commissionRule; // used by reportWaiterCommission
+    
+    // Running aggregates indexed by OrderType, maintained by addOrder so the
+    // reports never rescan the orders
+    size_t typeCounts[2];
+    KahanSum typeSales[2];
+    // Order value distributions by OrderType and by PatronType, and orders by party size
+    AmountHistogram typeAmounts[2];
+    AmountHistogram patronTypeAmounts[2];
+    PartySizeHistogram partySizes;
+    
+    friend class RestaurantSnapshot;
+    
+    void recordOrder(size_t row, OrderType orderType, double amount) {
+        waiters[orders.waiterId(row)]->addOrder(row, amount);
+        uint32_t patronId = orders.patronId(row);
+        patrons.recordVisit(patronId, orderType, amount);
+        typeAmounts[static_cast<int>(orderType)].add(amount);
+        patronTypeAmounts[static_cast<int>(orders.partyType(row))].add(amount);
+        partySizes.add(orders.partySize(row));
+        timeIndex.add(orders.epochSeconds(row), row);
+        typeCounts[static_cast<int>(orderType)]++;
+        typeSales[static_cast<int>(orderType)].add(amount);
+    }
+
+public:
+    Restaurant(string n)
+        : name(move(n)), nextOrderId(1), journal(nullptr), commissionRule(CommissionRule::FLAT), typeCounts() {}
+    
+    // Waiters keep a pointer to the store, so a restaurant must not be copied or moved
+    Restaurant(const Restaurant&) = delete;
+    Restaurant& operator=(const Restaurant&) = delete;
+    
+    // Everything added from now on is also appended to the journal
+    void attachJournal(OrderJournal* orderJournal) {
+        journal = orderJournal;
+    }
+    
+    void addWaiter(shared_ptr<Waiter> waiter) {
+        waiterIndex.emplace(waiter.get(), static_cast<uint32_t>(waiters.size()));
+        waiter->attachStore(&orders);
+        waiters.push_back(waiter);
+        if (journal) {
+            journal->appendWaiter(waiter->getWaiterId(), waiter->getName());
+        }
+    }
+    
+    void addOrder(const shared_ptr<Patron>& patron, OrderType orderType, double amount, 
+                  const shared_ptr<Waiter>& waiter, const string& items) {
+        addOrder(patron, orderType, amount, waiter, items, Timestamp());
+    }
+    
+    // Overloaded method for adding orders with custom timestamps
+    void addOrder(const shared_ptr<Patron>& patron, OrderType orderType, double amount, 
+                  const shared_ptr<Waiter>& waiter, const string& items, const Timestamp& timestamp) {
+        addOrder(addPatron(patron), patron->getType(), patron->getGroupSize(), orderType, amount,
+                 waiterIndex.at(waiter.get()), items, timestamp);
+    }
+    
+    uint32_t addPatron(const shared_ptr<Patron>& patron) {
+        return addPatron(patron->getName(), patron->getType(), patron->getGroupSize(), patron->isSitInOrder());
+    }
+    
+    // Returns the id orders refer to the named patron by, registering the
+    // patron on first sight. A repeat customer keeps the details given on
+    // the first visit; the party on each visit is recorded with the order.
+    // Known names cost a hash probe and no allocation.
+    uint32_t addPatron(const string& patronName, PatronType type, int groupSize, bool sitIn) {
+        uint32_t patronId = patrons.find(patronName);
+        if (patronId != PatronStore::NO_PATRON) {
+            return patronId;
+        }
+        if (journal) {
+            journal->appendPatron(patronName, type, groupSize, sitIn, false);
+        }
+        return patrons.appendNamed(patronName, type, groupSize, sitIn);
+    }
+    
+    // Adds a one-off patron that is never matched by name, for sources where
+    // names are not identities (the simulation draws them from a small table)
+    uint32_t addGuest(const string& patronName, PatronType type, int groupSize, bool sitIn) {
+        if (journal) {
+            journal->appendPatron(patronName, type, groupSize, sitIn, true);
+        }
+        return patrons.appendGuest(patronName, type, groupSize, sitIn);
+    }
+    
+    // Id of the named patron, or PatronStore::NO_PATRON
+    uint32_t findPatron(const char* patronName, size_t size) const {
+        return patrons.find(patronName, size);
+    }
+    
+    // Bulk-load variant for callers that already resolved the patron id
+    // (addPatron) and the waiter's position in getWaiters(); the party is
+    // the one the patron was registered with
+    void addOrder(uint32_t patronId, OrderType orderType, double amount, uint32_t waiterPosition,
+                  const string& items, const Timestamp& timestamp) {
+        addOrder(patronId, patrons.type(patronId), patrons.groupSize(patronId), orderType, amount, waiterPosition,
+                 items, timestamp);
+    }
+    
+    // As above for a repeat patron whose party differs from the first visit
+    void addOrder(uint32_t patronId, PatronType partyType, int partySize, OrderType orderType, double amount,
+                  uint32_t waiterPosition, const string& items, const Timestamp& timestamp) {
+        addOrderWithId(nextOrderId++, patronId, partyType, partySize, orderType, amount, waiterPosition, items,
+                       timestamp);
+    }
+    
+    // Hands out count consecutive order ids; safe from any thread
+    int allocateOrderIds(int count) {
+        return nextOrderId.fetch_add(count);
+    }
+    
+    // Adds an order whose id came from allocateOrderIds()
+    void addOrderWithId(int orderId, uint32_t patronId, PatronType partyType, int partySize, OrderType orderType,
+                        double amount, uint32_t waiterPosition, const string& items, const Timestamp& timestamp) {
+        ScopedTimer timer(METRIC_ADD_ORDER);
+        size_t row = orders.append(orderId, patronId, partyType, partySize, orderType, amount, waiterPosition, items,
+                                   timestamp);
+        recordOrder(row, orderType, amount);
+        if (journal) {
+            journal->appendOrder(orders.orderId(row), orders.patronId(row), orders.partyType(row),
+                                 orders.partySize(row), orderType, amount, orders.waiterId(row), orders.itemId(row),
+                                 items, orders.epochSeconds(row));
+        }
+    }
+    
+    // Restore interface used by journal replay: waiter and patron ids refer to
+    // records restored earlier and nothing is written back to the journal
+    void restoreWaiter(int waiterId, const string& waiterName) {
+        addWaiter(make_shared<Waiter>(waiterId, waiterName));
+    }
+    
+    void restorePatron(const string& patronName, PatronType type, int groupSize, bool sitIn, bool guest) {
+        if (guest) {
+            patrons.appendGuest(patronName, type, groupSize, sitIn);
+        } else {
+            patrons.appendNamed(patronName, type, groupSize, sitIn);
+        }
+    }
+    
+    uint32_t internItems(const string& items) { return orders.internItems(items); }
+    
+    void restoreOrder(int orderId, uint32_t patronId, PatronType partyType, int partySize, OrderType orderType,
+                      double amount, uint32_t waiterIndex, uint32_t itemId, int64_t epochSeconds) {
+        size_t row = orders.append(orderId, patronId, partyType, partySize, orderType, amount, waiterIndex, itemId,
+                                   epochSeconds);
+        recordOrder(row, orderType, amount);
+        nextOrderId = max(nextOrderId.load(), orderId + 1);
+    }
+    
+    void reserveOrders(size_t n) {
+        orders.reserve(orders.size() + n);
+        timeIndex.reserve(timeIndex.size() + n);
+    }
+    
+    void reservePatrons(size_t n) {
+        patrons.reserve(patrons.size() + n);
+    }
+    
+    // Closes the trading day: every order and guest is dropped in one go and
+    // the waiters start again from zero; named patrons stay registered with
+    // their loyalty totals, though their ids may change. Column storage, the
+    // time index and the interned item and name pools keep their capacity, so
+    // the next day fills them without going back to the heap. Order ids keep
+    // counting up.
+    void closeDay() {
+        orders.clear();
+        timeIndex.clear();
+        patrons.dropGuests();
+        for (const auto& waiter : waiters) {
+            waiter->clearOrders();
+        }
+        typeCounts[0] = typeCounts[1] = 0;
+        typeSales[0] = typeSales[1] = KahanSum();
+        for (int i = 0; i < 2; i++) {
+            typeAmounts[i].clear();
+            patronTypeAmounts[i].clear();
+        }
+        partySizes.clear();
+        if (journal) {
+            journal->appendCloseDay();
+        }
+    }
+    
+    size_t getWaiterCount() const { return waiters.size(); }
+    
+    uint32_t getWaiterPosition(const shared_ptr<Waiter>& waiter) const { return waiterIndex.at(waiter.get()); }
+    
+    // Getter methods for menu system
+    const string& getName() const { return name; }
+    const vector<shared_ptr<Waiter>>& getWaiters() const { return waiters; }
+    const OrderStore& getOrders() const { return orders; }
+    Order getOrder(size_t row) const { return Order(orders, row); }
+    PatronRef getPatron(uint32_t patronId) const { return PatronRef(patrons, patronId); }
+    size_t getPatronCount() const { return patrons.size(); }
+    const Waiter& getWaiterAt(uint32_t index) const { return *waiters[index]; }
+    
+    // Orders with timestamps in [from, to] (inclusive), in time order
+    OrderRange getOrdersBetween(int64_t fromEpochSeconds, int64_t toEpochSeconds) const {
+        return timeIndex.range(orders, fromEpochSeconds, toEpochSeconds);
+    }
+    
+    OrderRange getOrdersBetween(const Timestamp& from, const Timestamp& to) const {
+        return getOrdersBetween(from.toEpochSeconds(), to.toEpochSeconds());
+    }
+    
+    // Epoch seconds of the earliest and latest order; only valid when there are orders
+    int64_t getFirstOrderTime() const { return timeIndex.minKey(); }
+    int64_t getLastOrderTime() const { return timeIndex.maxKey(); }
+    
+    size_t getOrderCount(OrderType type) const { return typeCounts[static_cast<int>(type)]; }
+    double getSales(OrderType type) const { return typeSales[static_cast<int>(type)].value(); }
+    double getTotalSales() const { return getSales(OrderType::SIT_IN) + getSales(OrderType::TAKE_OUT); }
+    
+    // Recomputes the sales totals by order type, waiter and hour of day
+    // straight from the order columns with the vector kernels
+    OrderColumns getOrderColumns() const {
+        OrderColumns columns = {orders.amountData(), orders.typeData(), orders.waiterIdData(), orders.timestampData(),
+                                orders.size(), waiters.size()};
+        return columns;
+    }
+    
+    // Fills the aggregates in a single pass over the orders
+    template <typename... Aggregates>
+    void aggregate(Aggregates&... aggregates) const {
+        aggregateOrders(getOrderColumns(), aggregates...);
+    }
+    
+    void setCommissionRule(CommissionRule rule) { commissionRule = rule; }
+    CommissionRule getCommissionRule() const { return commissionRule; }
+    
+    void scanSales(SalesScan& scan, const SalesKernels& kernels = salesKernels()) const {
+        const size_t n = orders.size();
+        scan.typeSales[0] = scan.typeSales[1] = 0.0;
+        scan.typeCounts[0] = scan.typeCounts[1] = 0;
+        scan.waiterSales.assign(waiters.size(), 0.0);
+        scan.waiterCounts.assign(waiters.size(), 0);
+        fill(scan.hourSales, scan.hourSales + 24, 0.0);
+        fill(scan.hourCounts, scan.hourCounts + 24, 0);
+        kernels.sumByType(orders.amountData(), orders.typeData(), n, scan.typeSales, scan.typeCounts);
+        kernels.sumByGroup(orders.amountData(), orders.waiterIdData(), n, scan.waiterSales.data(),
+                           scan.waiterCounts.data(), waiters.size());
+        kernels.bucketByHour(orders.timestampData(), orders.amountData(), n, scan.hourSales, scan.hourCounts);
+    }
+    
+    // Sets the list price of a menu item, adding it to the menu if new
+    void setMenuPrice(const string& item, double price) { orders.getMenu().setPrice(item, price); }
+    const MenuCatalog& getMenu() const { return orders.getMenu(); }
+    
+    // One pass over the orders into counter arrays. Line shares are worked
+    // out once per distinct item list, so each order costs a few multiply-adds.
+    void scanItems(ItemScan& scan) const {
+        const MenuCatalog& menu = orders.getMenu();
+        const vector<LineItem>& lines = orders.getLineItems();
+        const size_t itemCount = menu.size();
+        scan.quantities.assign(itemCount, 0);
+        scan.orderCounts.assign(itemCount, 0);
+        scan.revenue.assign(itemCount, 0.0);
+        scan.hourRevenue.assign(itemCount * 24, 0.0);
+        scan.totalRevenue = 0.0;
+        
+        vector<double> shares(lines.size());
+        for (uint32_t list = 0; list < orders.getItemPool().size(); list++) {
+            LineItemRange range = orders.lineItemsOf(list);
+            double priced = 0.0, quantity = 0.0;
+            bool allPriced = true;
+            for (const LineItem& line : range) {
+                priced += menu.price(line.item) * line.quantity;
+                quantity += line.quantity;
+                allPriced = allPriced && menu.price(line.item) > 0.0;
+            }
+            for (const LineItem* line = range.begin(); line != range.end(); line++) {
+                shares[line - lines.data()] = allPriced ? menu.price(line->item) * line->quantity / priced
+                                                        : line->quantity / quantity;
+            }
+        }
+        
+        const double* amounts = orders.amountData();
+        const int64_t* timestamps = orders.timestampData();
+        KahanSum total;
+        for (size_t row = 0; row < orders.size(); row++) {
+            LineItemRange range = orders.lineItemsOf(orders.itemId(row));
+            if (range.size() == 0) {
+                continue;
+            }
+            const double amount = amounts[row];
+            double* hours = scan.hourRevenue.data() + hourOfDay(timestamps[row]);
+            const double* share = shares.data() + (range.begin() - lines.data());
+            for (const LineItem& line : range) {
+                const double revenue = amount * *share++;
+                scan.quantities[line.item] += line.quantity;
+                scan.orderCounts[line.item]++;
+                scan.revenue[line.item] += revenue;
+                hours[line.item * 24] += revenue;
+            }
+            total.add(amount);
+        }
+        scan.totalRevenue = total.value();
+    }
+    
+    const AmountHistogram& getAmounts(OrderType type) const { return typeAmounts[static_cast<int>(type)]; }
+    const AmountHistogram& getAmounts(PatronType type) const { return patronTypeAmounts[static_cast<int>(type)]; }
+    const PartySizeHistogram& getPartySizes() const { return partySizes; }
+    
+    // The count patrons with the highest lifetime spend, best first; equal
+    // spend goes to the earlier patron. A count-sized min-heap keeps this at
+    // O(n log count) over the patrons instead of sorting all of them.
+    vector<uint32_t> getTopPatronsBySpend(size_t count) const {
+        typedef pair<double, uint32_t> Entry;
+        auto ranksAbove = [](const Entry& a, const Entry& b) {
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
+        };
+        vector<Entry> heap; // front() is the weakest of the current top
+        heap.reserve(min(count, patrons.size()));
+        for (uint32_t row = 0; count > 0 && row < patrons.size(); row++) {
+            Entry entry(patrons.lifetimeSpend(row), row);
+            if (heap.size() < count) {
+                heap.push_back(entry);
+                push_heap(heap.begin(), heap.end(), ranksAbove);
+            } else if (ranksAbove(entry, heap.front())) {
+                pop_heap(heap.begin(), heap.end(), ranksAbove);
+                heap.back() = entry;
+                push_heap(heap.begin(), heap.end(), ranksAbove);
+            }
+        }
+        sort_heap(heap.begin(), heap.end(), ranksAbove);
+        vector<uint32_t> top;
+        top.reserve(heap.size());
+        for (const Entry& entry : heap) {
+            top.push_back(entry.second);
+        }
+        return top;
+    }
+    
+    size_t getRepeatPatronCount() const {
+        size_t repeat = 0;
+        for (uint32_t row = 0; row < patrons.size(); row++) {
+            repeat += getPatron(row).getVisitCount() > 1 ? 1 : 0;
+        }
+        return repeat;
+    }
+    
+    // Commission for each waiter, by position, under the selected rule. The
+    // flat rule comes from the running totals; the others need the orders.
+    void getWaiterCommissions(vector<double>& commissions) const {
+        if (commissionRule == CommissionRule::BY_ORDER_TYPE) {
+            waiterCommissionsWith<OrderTypeCommission>(commissions);
+            return;
+        }
+        if (commissionRule == CommissionRule::TIERED) {
+            waiterCommissionsWith<TieredCommission>(commissions);
+            return;
+        }
+        commissions.clear();
+        for (const auto& waiter : waiters) {
+            commissions.push_back(waiter->getCommission());
+        }
+    }
+    
+    template <typename Rule>
+    void waiterCommissionsWith(vector<double>& commissions) const {
+        Aggregate<GroupBy<ByWaiter>, Commission<Rule>> commission;
+        aggregate(commission);
+        commissions.assign(waiters.size(), 0.0);
+        for (size_t w = 0; w < waiters.size(); w++) {
+            commissions[w] = commission.template get<Commission<Rule>>(w);
+        }
+    }
+    
+    double getTotalCommission() const {
+        double total = 0.0;
+        if (commissionRule != CommissionRule::FLAT) {
+            vector<double> commissions;
+            getWaiterCommissions(commissions);
+            for (double commission : commissions) {
+                total += commission;
+            }
+            return total;
+        }
+        for (const auto& waiter : waiters) {
+            total += waiter->getCommission();
+        }
+        return total;
+    }
+    
+    // Report a) Total number of sales divided into sit-in and take-out orders
+    void reportOrderCounts(ReportWriter& out) const {
+        ScopedTimer timer(METRIC_REPORT_COUNTS);
+        int sitInCount = static_cast<int>(getOrderCount(OrderType::SIT_IN));
+        int takeOutCount = static_cast<int>(getOrderCount(OrderType::TAKE_OUT));
+        
+        out.newline().text("=== ORDER COUNT REPORT ===").newline();
+        out.left("Report a) Total number of sales divided into sit-in and take-out orders", 50).newline();
+        out.rule(80, '-').newline();
+        out.left("Sit-in Orders:", 20).number(sitInCount, 10).newline();
+        out.left("Take-out Orders:", 20).number(takeOutCount, 10).newline();
+        out.left("Total Orders:", 20).number(sitInCount + takeOutCount, 10).newline();
+    }
+    
+    // Report b) Total sales for the day, divided into sit-in and take-out sales
+    void reportTotalSales(ReportWriter& out) const {
+        ScopedTimer timer(METRIC_REPORT_SALES);
+        double sitInSales = getSales(OrderType::SIT_IN);
+        double takeOutSales = getSales(OrderType::TAKE_OUT);
+        
+        out.newline().text("=== TOTAL SALES REPORT ===").newline();
+        out.left("Report b) Total sales for the day, divided into sit-in and take-out sales", 50).newline();
+        out.rule(80, '-').newline();
+        out.left("Sit-in Sales:", 20).text("R").amount(sitInSales, 10).newline();
+        out.left("Take-out Sales:", 20).text("R").amount(takeOutSales, 10).newline();
+        out.left("Total Sales:", 20).text("R").amount(sitInSales + takeOutSales, 10).newline();
+    }
+    
+    // Report c) Total sales made by each waiter
+    void reportWaiterSales(ReportWriter& out) const {
+        ScopedTimer timer(METRIC_REPORT_WAITERS);
+        out.newline().text("=== WAITER SALES REPORT ===").newline();
+        out.left("Report c) Total sales made by each waiter", 50).newline();
+        out.rule(80, '-').newline();
+        out.left("ID", 5).left("Waiter Name", 20).right("Orders", 15).right("Total Sales", 15).newline();
+        out.rule(80, '-').newline();
+        
+        for (const auto& waiter : waiters) {
+            out.number(waiter->getWaiterId(), 5, true)
+               .left(waiter->getName(), 20)
+               .number(waiter->getOrderCount(), 15)
+               .text("R").amount(waiter->getTotalSales(), 14).newline();
+        }
+    }
+    
+    // Report d) Commission for each waiter (15% of their total sales). Other
+    // commission rules need the orders, not just the running totals.
+    void reportWaiterCommission(ReportWriter& out) const {
+        ScopedTimer timer(METRIC_REPORT_COMMISSION);
+        if (commissionRule == CommissionRule::BY_ORDER_TYPE) {
+            reportWaiterCommissionWith<OrderTypeCommission>(out);
+            return;
+        }
+        if (commissionRule == CommissionRule::TIERED) {
+            reportWaiterCommissionWith<TieredCommission>(out);
+            return;
+        }
+        out.newline().text("=== WAITER COMMISSION REPORT ===").newline();
+        out.left("Report d) Commission for each waiter (15% of total sales)", 50).newline();
+        out.rule(80, '-').newline();
+        out.left("ID", 5).left("Waiter Name", 20).right("Total Sales", 15).right("Commission", 15).newline();
+        out.rule(80, '-').newline();
+        
+        for (const auto& waiter : waiters) {
+            out.number(waiter->getWaiterId(), 5, true)
+               .left(waiter->getName(), 20)
+               .text("R").amount(waiter->getTotalSales(), 14)
+               .text("R").amount(waiter->getCommission(), 14).newline();
+        }
+    }
+    
+    // Report d) under any commission rule, in one pass over the orders
+    template <typename Rule>
+    void reportWaiterCommissionWith(ReportWriter& out) const {
+        Aggregate<GroupBy<ByWaiter>, Sum<Amount>, Commission<Rule>> commission;
+        aggregate(commission);
+        
+        out.newline().text("=== WAITER COMMISSION REPORT ===").newline();
+        out.text("Report d) Commission for each waiter (").text(Rule::describe()).text(")").newline();
+        out.rule(80, '-').newline();
+        out.left("ID", 5).left("Waiter Name", 20).right("Total Sales", 15).right("Commission", 15).newline();
+        out.rule(80, '-').newline();
+        
+        for (size_t w = 0; w < waiters.size(); w++) {
+            out.number(waiters[w]->getWaiterId(), 5, true)
+               .left(waiters[w]->getName(), 20)
+               .text("R").amount(commission.template get<Sum<Amount>>(w), 14)
+               .text("R").amount(commission.template get<Commission<Rule>>(w), 14).newline();
+        }
+    }
+    
+    // Loyalty report: the best customers by lifetime spend with their visits
+    void reportTopPatrons(ReportWriter& out, size_t count = 10) const {
+        ScopedTimer timer(METRIC_REPORT_PATRONS);
+        out.newline().text("=== TOP PATRONS REPORT ===").newline();
+        out.left("Patrons ranked by lifetime spend", 50).newline();
+        out.rule(80, '-').newline();
+        out.left("Patrons:", 20).number(static_cast<int64_t>(patrons.size()), 10).newline();
+        out.left("Repeat Customers:", 20).number(static_cast<int64_t>(getRepeatPatronCount()), 10).newline();
+        out.rule(80, '-').newline();
+        out.left("Rank", 6).left("Patron", 20).left("Type", 12).right("Visits", 8).right("Sit-in", 8)
+           .right("Take-out", 10).right("Lifetime Spend", 16).newline();
+        out.rule(80, '-').newline();
+        
+        vector<uint32_t> top = getTopPatronsBySpend(count);
+        for (size_t rank = 0; rank < top.size(); rank++) {
+            PatronRef patron = getPatron(top[rank]);
+            out.number(static_cast<int64_t>(rank + 1), 6, true)
+               .left(patron.getName(), 20)
+               .left(patron.getTypeString(), 12)
+               .number(patron.getVisitCount(), 8)
+               .number(patron.getVisitCount(OrderType::SIT_IN), 8)
+               .number(patron.getVisitCount(OrderType::TAKE_OUT), 10)
+               .text("  R").amount(patron.getLifetimeSpend(), 13).newline();
+        }
+    }
+    
+    // Trading pattern: orders and sales in each hour of the day, over all days
+    void reportSalesByHour(ReportWriter& out) const {
+        ScopedTimer timer(METRIC_REPORT_HOURS);
+        SalesScan scan;
+        scanSales(scan);
+        double totalSales = scan.typeSales[0] + scan.typeSales[1];
+        
+        out.newline().text("=== SALES BY HOUR REPORT ===").newline();
+        out.left("Orders and sales in each hour of the day", 50).newline();
+        out.rule(80, '-').newline();
+        out.left("Hour", 20).right("Orders", 10).right("Sales", 15).right("Share", 12).newline();
+        out.rule(80, '-').newline();
+        for (int hour = 0; hour < 24; hour++) {
+            if (scan.hourCounts[hour] == 0) {
+                continue;
+            }
+            char label[16];
+            snprintf(label, sizeof(label), "%02d:00-%02d:59", hour, hour);
+            out.left(label, 20).number(static_cast<int64_t>(scan.hourCounts[hour]), 10)
+               .text("  R").amount(scan.hourSales[hour], 12)
+               .amount(totalSales > 0 ? 100.0 * scan.hourSales[hour] / totalSales : 0.0, 11).text("%").newline();
+        }
+        out.rule(80, '-').newline();
+        out.left("Total", 20).number(static_cast<int64_t>(scan.typeCounts[0] + scan.typeCounts[1]), 10)
+           .text("  R").amount(totalSales, 12).newline();
+    }
+    
+    // Menu performance: the best selling items by revenue, with how many
+    // were sold and on how many orders
+    void reportTopItems(ReportWriter& out, size_t count = 10) const {
+        ScopedTimer timer(METRIC_REPORT_ITEMS);
+        ItemScan scan;
+        scanItems(scan);
+        
+        out.newline().text("=== TOP ITEMS REPORT ===").newline();
+        out.left("Menu items ranked by revenue", 50).newline();
+        out.rule(80, '-').newline();
+        out.left("Menu Items:", 20).number(static_cast<int64_t>(getMenu().size()), 10).newline();
+        out.rule(80, '-').newline();
+        out.left("Rank", 6).left("Item", 24).right("Quantity", 10).right("Orders", 10).right("Revenue", 18)
+           .right("Share", 12).newline();
+        out.rule(80, '-').newline();
+        
+        vector<uint32_t> top = scan.topItems(count);
+        for (size_t rank = 0; rank < top.size(); rank++) {
+            uint32_t item = top[rank];
+            out.number(static_cast<int64_t>(rank + 1), 6, true)
+               .left(getMenu().name(item).substr(0, 23), 24)
+               .number(static_cast<int64_t>(scan.quantities[item]), 10)
+               .number(static_cast<int64_t>(scan.orderCounts[item]), 10)
+               .text("  R").amount(scan.revenue[item], 15)
+               .amount(scan.totalRevenue > 0 ? 100.0 * scan.revenue[item] / scan.totalRevenue : 0.0, 11)
+               .text("%").newline();
+        }
+    }
+    
+    // Item sales through the day: revenue per hour for the top five items
+    void reportItemSalesByHour(ReportWriter& out) const {
+        ScopedTimer timer(METRIC_REPORT_ITEMS);
+        ItemScan scan;
+        scanItems(scan);
+        vector<uint32_t> top = scan.topItems(5);
+        
+        out.newline().text("=== ITEM SALES BY HOUR REPORT ===").newline();
+        out.left("Revenue in each hour of the day for the top items", 50).newline();
+        out.rule(80, '-').newline();
+        out.left("Hour", 8);
+        for (uint32_t item : top) {
+            out.right(getMenu().name(item).substr(0, 11), 12);
+        }
+        out.right("All Items", 12).newline();
+        out.rule(80, '-').newline();
+        
+        double hourTotals[24] = {};
+        for (size_t i = 0; i < scan.hourRevenue.size(); i++) {
+            hourTotals[i % 24] += scan.hourRevenue[i];
+        }
+        for (int hour = 0; hour < 24; hour++) {
+            if (hourTotals[hour] == 0.0) {
+                continue;
+            }
+            char label[16];
+            snprintf(label, sizeof(label), "%02d:00", hour);
+            out.left(label, 8);
+            for (uint32_t item : top) {
+                out.amount(scan.hourRevenue[item * 24 + hour], 12);
+            }
+            out.amount(hourTotals[hour], 12).newline();
+        }
+        out.rule(80, '-').newline();
+        out.left("Total", 8);
+        for (uint32_t item : top) {
+            out.amount(scan.revenue[item], 12);
+        }
+        out.amount(scan.totalRevenue, 12).newline();
+    }
+    
+    // Order value distribution: ticket size quantiles from the streaming
+    // histograms, within 0.39% of the exact values
+    void reportOrderValues(ReportWriter& out) const {
+        ScopedTimer timer(METRIC_REPORT_VALUES);
+        out.newline().text("=== ORDER VALUE DISTRIBUTION REPORT ===").newline();
+        out.left("Ticket size by order type, patron type and waiter", 50).newline();
+        out.rule(80, '-').newline();
+        out.left("", 20).right("Orders", 10).right("Mean", 12).right("Median", 12).right("P90", 12).right("P99", 12).newline();
+        out.rule(80, '-').newline();
+        
+        AmountHistogram all;
+        all.merge(typeAmounts[0]);
+        all.merge(typeAmounts[1]);
+        writeValueRow(out, "All Orders", all);
+        writeValueRow(out, "Sit-in", getAmounts(OrderType::SIT_IN));
+        writeValueRow(out, "Take-out", getAmounts(OrderType::TAKE_OUT));
+        writeValueRow(out, "Individual", getAmounts(PatronType::INDIVIDUAL));
+        writeValueRow(out, "Group", getAmounts(PatronType::GROUP));
+        for (const auto& waiter : waiters) {
+            writeValueRow(out, waiter->getName(), waiter->getAmounts());
+        }
+        
+        out.newline().left("Party Size", 20).right("Orders", 10).right("Share", 12).newline();
+        out.rule(80, '-').newline();
+        uint64_t orderCount = all.count();
+        for (int size = 1; size <= PartySizeHistogram::MAX_SIZE; size++) {
+            uint64_t count = partySizes.count(size);
+            if (count == 0) {
+                continue;
+            }
+            char label[16];
+            snprintf(label, sizeof(label), size == PartySizeHistogram::MAX_SIZE ? "%d+" : "%d", size);
+            out.left(label, 20).number(static_cast<int64_t>(count), 10)
+               .amount(100.0 * count / orderCount, 11).text("%").newline();
+        }
+    }
+    
+    static void writeValueRow(ReportWriter& out, const string& label, const AmountHistogram& amounts) {
+        out.left(label, 20).number(static_cast<int64_t>(amounts.count()), 10)
+           .text("  R").amount(amounts.mean(), 9)
+           .text("  R").amount(amounts.quantile(0.5), 9)
+           .text("  R").amount(amounts.quantile(0.9), 9)
+           .text("  R").amount(amounts.quantile(0.99), 9).newline();
+    }
+    
+    // Column headings shared by the detailed order listings
+    static void writeOrderHeader(ReportWriter& out) {
+        out.rule(120, '-').newline();
+        out.left("Order ID", 8).left("Patron", 20).left("Type", 15).left("Order Type", 15)
+           .left("Waiter", 20).left("Timestamp", 20).right("Amount", 15).newline();
+        out.rule(120, '-').newline();
+    }
+    
+    void writeOrderRow(ReportWriter& out, const Order& order) const {
+        char timestamp[Timestamp::FORMAT_BUFFER_SIZE];
+        order.getTimestamp().formatTo(timestamp);
+        PatronRef patron = getPatron(order.getPatronId());
+        out.number(order.getOrderId(), 8, true)
+           .left(patron.getName(), 20)
+           .left(order.getPartyTypeString(), 15)
+           .left(order.getTypeString(), 15)
+           .left(getWaiterAt(order.getWaiterId()).getName(), 20)
+           .left(timestamp, 20)
+           .text("R").amount(order.getTotalAmount(), 14).newline();
+    }
+    
+    // Rows [from, to) of the detailed order listing
+    void writeOrderRows(ReportWriter& out, size_t from, size_t to) const {
+        for (size_t row = from; row < to; row++) {
+            writeOrderRow(out, Order(orders, row));
+        }
+    }
+    
+    // Display all orders for detailed view
+    void displayAllOrders(ReportWriter& out) const {
+        ScopedTimer timer(METRIC_REPORT_ORDERS);
+        out.newline().text("=== DETAILED ORDER REPORT ===").newline();
+        writeOrderHeader(out);
+        writeOrderRows(out, 0, orders.size());
+    }
+    
+    // Generate all reports
+    void generateAllReports(ReportWriter& out) const {
+        ScopedTimer timer(METRIC_REPORT_ALL);
+        out.newline().rule(80, '=').newline();
+        out.text("RESTAURANT SIMULATION REPORT - ").text(name).newline();
+        out.rule(80, '=').newline();
+        
+        reportOrderCounts(out);
+        reportTotalSales(out);
+        reportWaiterSales(out);
+        reportWaiterCommission(out);
+        displayAllOrders(out);
+    }
+    
+    // Console versions of the reports used by the menu
+    void reportOrderCounts() const { ReportWriter out(stdout); reportOrderCounts(out); }
+    void reportTotalSales() const { ReportWriter out(stdout); reportTotalSales(out); }
+    void reportWaiterSales() const { ReportWriter out(stdout); reportWaiterSales(out); }
+    void reportWaiterCommission() const { ReportWriter out(stdout); reportWaiterCommission(out); }
+    void displayAllOrders() const { ReportWriter out(stdout); displayAllOrders(out); }
+    void reportTopPatrons() const { ReportWriter out(stdout); reportTopPatrons(out); }
+    void reportOrderValues() const { ReportWriter out(stdout); reportOrderValues(out); }
+    void reportSalesByHour() const { ReportWriter out(stdout); reportSalesByHour(out); }
+    void reportTopItems() const { ReportWriter out(stdout); reportTopItems(out); }
+    void reportItemSalesByHour() const { ReportWriter out(stdout); reportItemSalesByHour(out); }
+    void generateAllReports() const { ReportWriter out(stdout); generateAllReports(out); }
+};
+
+// Bounded single-producer/single-consumer ring. The producer owns tail and
+// the consumer owns head; each sits on its own cache line.
+template <typename T>
+class SpscRing {
+private:
+    vector<T> slots;
+    size_t mask;
+    char padding0[64];
+    atomic<size_t> head;
+    char padding1[64];
+    atomic<size_t> tail;
+    char padding2[64];
+
+public:
+    explicit SpscRing(size_t capacity) : head(0), tail(0) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+    
+    // Producer side; false when the ring is full
+    bool push(T&& value) {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) > mask) {
+            return false;
+        }
+        slots[t & mask] = move(value);
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+    
+    // Consumer side: hands up to limit available elements to fn, returns how many
+    template <typename Fn>
+    size_t drain(Fn fn, size_t limit = numeric_limits<size_t>::max()) {
+        size_t h = head.load(memory_order_relaxed);
+        size_t t = tail.load(memory_order_acquire);
+        if (t - h > limit) {
+            t = h + limit;
+        }
+        for (size_t i = h; i != t; i++) {
+            fn(slots[i & mask]);
+        }
+        head.store(t, memory_order_release);
+        return t - h;
+    }
+    
+    // Either side, or an onlooker as a hint: whether anything is queued
+    bool empty() const {
+        return head.load(memory_order_acquire) == tail.load(memory_order_acquire);
+    }
+};
+
+// Concurrent order intake for several POS terminals. Each terminal thread
+// gets its order id from the restaurant's atomic counter and appends to its
+// own lock-free ring; a single publisher moves the rings into the Restaurant
+// a batch at a time under the snapshot lock. Readers take the same lock, so
+// they always see whole batches, and terminals never wait for them.
+class OrderIntake {
+public:
+    struct PendingOrder {
+        int orderId;
+        shared_ptr<Patron> patron;
+        OrderType type;
+        double amount;
+        uint32_t waiter;
+        string items;
+        int64_t timestamp;
+        uint64_t submitted;  // Metrics::now() at submit, 0 while metrics are off
+    };
+    
+    class Terminal {
+    private:
+        Restaurant& restaurant;
+        SpscRing<PendingOrder> ring;
+        friend class OrderIntake;
+
+    public:
+        Terminal(Restaurant& r, size_t capacity) : restaurant(r), ring(capacity) {}
+        
+        // Queues an order for the next publish and returns its id. Only the
+        // terminal's own thread may call this; it yields while the ring is full.
+        int submit(const shared_ptr<Patron>& patron, OrderType type, double amount, uint32_t waiterPosition,
+                   string items, const Timestamp& timestamp = Timestamp()) {
+            ScopedTimer timer(METRIC_INTAKE_SUBMIT);
+            PendingOrder order;
+            order.orderId = restaurant.allocateOrderIds(1);
+            order.patron = patron;
+            order.type = type;
+            order.amount = amount;
+            order.waiter = waiterPosition;
+            order.items = move(items);
+            order.timestamp = timestamp.toEpochSeconds();
+            order.submitted = Metrics::enabled() ? Metrics::now() : 0;
+            int id = order.orderId;
+            while (!ring.push(move(order))) {
+                this_thread::yield();
+            }
+            return id;
+        }
+    };
+
+private:
+    Restaurant& restaurant;
+    size_t ringCapacity;
+    mutex terminalsLock;
+    deque<unique_ptr<Terminal>> terminals;
+    mutex snapshotLock;
+    thread publisher;
+    atomic<bool> publishing;
+
+public:
+    static const size_t DEFAULT_RING_CAPACITY = 4096;
+    
+    explicit OrderIntake(Restaurant& r, size_t capacity = DEFAULT_RING_CAPACITY)
+        : restaurant(r), ringCapacity(capacity), publishing(false) {}
+    
+    ~OrderIntake() {
+        stop();
+    }
+    
+    OrderIntake(const OrderIntake&) = delete;
+    OrderIntake& operator=(const OrderIntake&) = delete;
+    
+    // Waiters must all be added before terminals submit orders
+    Terminal& openTerminal() {
+        lock_guard<mutex> guard(terminalsLock);
+        terminals.emplace_back(new Terminal(restaurant, ringCapacity));
+        return *terminals.back();
+    }
+    
+    // Moves everything queued so far into the restaurant; one caller at a time
+    size_t publish() {
+        vector<Terminal*> current;
+        {
+            lock_guard<mutex> guard(terminalsLock);
+            for (const auto& terminal : terminals) {
+                current.push_back(terminal.get());
+            }
+        }
+        size_t published = 0;
+        lock_guard<mutex> guard(snapshotLock);
+        for (Terminal* terminal : current) {
+            published += terminal->ring.drain([this](PendingOrder& order) {
+                restaurant.addOrderWithId(order.orderId, restaurant.addPatron(order.patron), order.patron->getType(),
+                                          order.patron->getGroupSize(), order.type, order.amount, order.waiter,
+                                          order.items, Timestamp::fromEpochSeconds(order.timestamp));
+                if (order.submitted) {
+                    Metrics::recordTime(METRIC_INTAKE_QUEUE, Metrics::now() - order.submitted);
+                }
+                order.patron.reset();
+            });
+        }
+        return published;
+    }
+    
+    // Publishes continuously on a background thread until stop()
+    void start() {
+        if (publishing.exchange(true)) {
+            return;
+        }
+        publisher = thread([this]() {
+            while (publishing.load(memory_order_relaxed)) {
+                if (publish() == 0) {
+                    this_thread::sleep_for(chrono::microseconds(100));
+                }
+            }
+        });
+    }
+    
+    // Stops the publisher and publishes whatever is still queued
+    void stop() {
+        if (publishing.exchange(false)) {
+            publisher.join();
+        }
+        publish();
+    }
+    
+    // Runs fn on the restaurant between two published batches
+    template <typename Fn>
+    void readSnapshot(Fn fn) {
+        lock_guard<mutex> guard(snapshotLock);
+        fn(static_cast<const Restaurant&>(restaurant));
+    }
+};
+
+const size_t OrderIntake::DEFAULT_RING_CAPACITY;
+
+// Output formats for non-interactive report export
+enum class ReportFormat {
+    TEXT,
+    CSV,
+    JSONL,
+    BINARY
+};
+
+// CSV export: one table with a leading record column. "order" rows carry the
+// detailed order listing, "waiter" rows the sales and commission report and
+// "order_type" rows the sit-in/take-out totals; unused fields are left empty
+void exportCsv(const Restaurant& restaurant, ReportWriter& out) {
+    out.text("record,order_id,patron,patron_type,order_type,waiter_id,waiter,timestamp,items,amount,orders,sales,commission").newline();
+    
+    const OrderStore& orders = restaurant.getOrders();
+    char timestamp[Timestamp::FORMAT_BUFFER_SIZE];
+    for (size_t row = 0; row < orders.size(); row++) {
+        Order order(orders, row);
+        PatronRef patron = restaurant.getPatron(order.getPatronId());
+        const Waiter& waiter = restaurant.getWaiterAt(order.getWaiterId());
+        order.getTimestamp().formatIsoTo(timestamp);
+        out.text("order,").number(order.getOrderId(), 0).text(",");
+        out.csvField(patron.getName()).text(",").text(order.getPartyTypeString()).text(",");
+        out.text(order.getTypeString()).text(",").number(waiter.getWaiterId(), 0).text(",");
+        out.csvField(waiter.getName()).text(",").text(timestamp).text(",");
+        out.csvField(order.getItems()).text(",").amount(order.getTotalAmount(), 0).text(",,,").newline();
+    }
+    
+    const auto& waiters = restaurant.getWaiters();
+    vector<double> commissions;
+    restaurant.getWaiterCommissions(commissions);
+    for (size_t w = 0; w < waiters.size(); w++) {
+        out.text("waiter,,,,,").number(waiters[w]->getWaiterId(), 0).text(",").csvField(waiters[w]->getName());
+        out.text(",,,,").number(waiters[w]->getOrderCount(), 0).text(",").amount(waiters[w]->getTotalSales(), 0);
+        out.text(",").amount(commissions[w], 0).newline();
+    }
+    
+    const OrderType types[] = {OrderType::SIT_IN, OrderType::TAKE_OUT};
+    for (OrderType type : types) {
+        out.text("order_type,,,,").text(type == OrderType::SIT_IN ? "Sit-in" : "Take-out");
+        out.text(",,,,,,").number(restaurant.getOrderCount(type), 0).text(",");
+        out.amount(restaurant.getSales(type), 0).text(",").newline();
+    }
+}
+
+// JSON Lines export: one object per line with the same records as the CSV export
+void exportJsonLines(const Restaurant& restaurant, ReportWriter& out) {
+    const OrderStore& orders = restaurant.getOrders();
+    char timestamp[Timestamp::FORMAT_BUFFER_SIZE];
+    for (size_t row = 0; row < orders.size(); row++) {
+        Order order(orders, row);
+        PatronRef patron = restaurant.getPatron(order.getPatronId());
+        const Waiter& waiter = restaurant.getWaiterAt(order.getWaiterId());
+        order.getTimestamp().formatIsoTo(timestamp);
+        out.text("{\"record\":\"order\",\"order_id\":").number(order.getOrderId(), 0);
+        out.text(",\"patron\":").jsonString(patron.getName());
+        out.text(",\"patron_type\":\"").text(order.getPartyTypeString());
+        out.text("\",\"order_type\":\"").text(order.getTypeString());
+        out.text("\",\"waiter_id\":").number(waiter.getWaiterId(), 0);
+        out.text(",\"waiter\":").jsonString(waiter.getName());
+        out.text(",\"timestamp\":\"").text(timestamp);
+        out.text("\",\"items\":").jsonString(order.getItems());
+        out.text(",\"amount\":").amount(order.getTotalAmount(), 0).text("}").newline();
+    }
+    
+    const auto& waiters = restaurant.getWaiters();
+    vector<double> commissions;
+    restaurant.getWaiterCommissions(commissions);
+    for (size_t w = 0; w < waiters.size(); w++) {
+        out.text("{\"record\":\"waiter\",\"waiter_id\":").number(waiters[w]->getWaiterId(), 0);
+        out.text(",\"waiter\":").jsonString(waiters[w]->getName());
+        out.text(",\"orders\":").number(waiters[w]->getOrderCount(), 0);
+        out.text(",\"sales\":").amount(waiters[w]->getTotalSales(), 0);
+        out.text(",\"commission\":").amount(commissions[w], 0).text("}").newline();
+    }
+    
+    const OrderType types[] = {OrderType::SIT_IN, OrderType::TAKE_OUT};
+    for (OrderType type : types) {
+        out.text("{\"record\":\"order_type\",\"order_type\":\"").text(type == OrderType::SIT_IN ? "Sit-in" : "Take-out");
+        out.text("\",\"orders\":").number(restaurant.getOrderCount(type), 0);
+        out.text(",\"sales\":").amount(restaurant.getSales(type), 0).text("}").newline();
+    }
+}
+
+// Binary columnar dump. Layout (native little-endian):
+//   "RSTCOL01", uint32 version, uint32 column count
+//   per column: ColumnHeader, then byteLength bytes of raw values padded to 8 bytes
+// String columns are stored as "<name>.offsets" (uint64, count + 1 entries)
+// and "<name>.data" (the concatenated bytes). A reader maps the file and uses
+// every column in place without parsing.
+struct ColumnHeader {
+    char name[20];
+    uint32_t elementSize;
+    uint64_t byteLength;
+};
+
+static const char COLUMNAR_MAGIC[8] = {'R', 'S', 'T', 'C', 'O', 'L', '0', '1'};
+static const uint32_t COLUMNAR_VERSION = 1;
+
+class ColumnarDumpWriter {
+private:
+    struct Part {
+        const void* data;
+        size_t count;
+    };
+    
+    struct PendingColumn {
+        string name;
+        uint32_t elementSize;
+        vector<Part> parts; // written back to back as one column
+    };
+    
+    vector<PendingColumn> columns;
+    deque<string> ownedData; // backing storage for columns built by strings()
+
+public:
+    // Columns only reference their data, which must stay alive until write()
+    void column(const string& name, const void* data, uint32_t elementSize, size_t count) {
+        PendingColumn pending = {name, elementSize, vector<Part>()};
+        columns.push_back(pending);
+        append(data, count);
+    }
+    
+    template <typename T>
+    void column(const string& name, const vector<T>& values) {
+        column(name, values.data(), sizeof(T), values.size());
+    }
+    
+    // Extends the last column with more values of the same element size,
+    // so several arrays can be stored as one without copying them together
+    void append(const void* data, size_t count) {
+        Part part = {data, count};
+        columns.back().parts.push_back(part);
+    }
+    
+    template <typename T>
+    void append(const vector<T>& values) {
+        append(values.data(), values.size());
+    }
+    
+    // Like column(), but the writer keeps its own copy of the values
+    void copy(const string& name, const void* data, uint32_t elementSize, size_t count) {
+        ownedData.push_back(string(static_cast<const char*>(data), static_cast<size_t>(elementSize) * count));
+        column(name, ownedData.back().data(), elementSize, count);
+    }
+    
+    // CRC-32C over the values of every column added so far, in order
+    uint32_t checksum() const {
+        uint32_t crc = 0;
+        for (const auto& column : columns) {
+            for (const auto& part : column.parts) {
+                crc = crc32c(part.data, static_cast<size_t>(column.elementSize) * part.count, crc);
+            }
+        }
+        return crc;
+    }
+    
+    // Adds "<name>.offsets" and "<name>.data" for count strings returned by get(i)
+    template <typename Getter>
+    void strings(const string& name, size_t count, Getter get) {
+        string offsets, data;
+        uint64_t offset = 0;
+        offsets.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        for (size_t i = 0; i < count; i++) {
+            StringRef value = get(i);
+            data.append(value.data(), value.size());
+            offset = data.size();
+            offsets.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        }
+        ownedData.push_back(move(offsets));
+        column(name + ".offsets", ownedData.back().data(), sizeof(uint64_t), count + 1);
+        ownedData.push_back(move(data));
+        column(name + ".data", ownedData.back().data(), 1, ownedData.back().size());
+    }
+    
+    // Other formats built on the same layout pass their own magic and version
+    void write(ReportWriter& out, const char* magic = COLUMNAR_MAGIC, uint32_t version = COLUMNAR_VERSION) const {
+        uint32_t columnCount = static_cast<uint32_t>(columns.size());
+        out.bytes(magic, sizeof(COLUMNAR_MAGIC));
+        out.bytes(&version, sizeof(version));
+        out.bytes(&columnCount, sizeof(columnCount));
+        
+        static const char padding[8] = {0};
+        for (const auto& column : columns) {
+            ColumnHeader header;
+            memset(&header, 0, sizeof(header));
+            strncpy(header.name, column.name.c_str(), sizeof(header.name) - 1);
+            header.elementSize = column.elementSize;
+            for (const auto& part : column.parts) {
+                header.byteLength += static_cast<uint64_t>(column.elementSize) * part.count;
+            }
+            out.bytes(&header, sizeof(header));
+            for (const auto& part : column.parts) {
+                if (part.count > 0) {
+                    out.bytes(part.data, static_cast<size_t>(column.elementSize) * part.count);
+                }
+            }
+            out.bytes(padding, (8 - header.byteLength % 8) % 8);
+        }
+    }
+};
+
+void exportBinary(const Restaurant& restaurant, ReportWriter& out) {
+    const OrderStore& orders = restaurant.getOrders();
+    const auto& waiters = restaurant.getWaiters();
+    const size_t n = orders.size();
+    
+    vector<uint8_t> patronTypes;
+    vector<int32_t> groupSizes;
+    for (size_t i = 0; i < restaurant.getPatronCount(); i++) {
+        PatronRef patron = restaurant.getPatron(static_cast<uint32_t>(i));
+        patronTypes.push_back(static_cast<uint8_t>(patron.getType()));
+        groupSizes.push_back(patron.getGroupSize());
+    }
+    vector<int32_t> waiterIds;
+    vector<int64_t> waiterOrders;
+    vector<double> waiterSales, waiterCommission;
+    for (const auto& waiter : waiters) {
+        waiterIds.push_back(waiter->getWaiterId());
+        waiterOrders.push_back(waiter->getOrderCount());
+        waiterSales.push_back(waiter->getTotalSales());
+    }
+    restaurant.getWaiterCommissions(waiterCommission);
+    vector<int64_t> typeOrders = {static_cast<int64_t>(restaurant.getOrderCount(OrderType::SIT_IN)),
+                                  static_cast<int64_t>(restaurant.getOrderCount(OrderType::TAKE_OUT))};
+    vector<double> typeSales = {restaurant.getSales(OrderType::SIT_IN), restaurant.getSales(OrderType::TAKE_OUT)};
+    
+    ColumnarDumpWriter dump;
+    dump.column("order.id", orders.orderIdData(), sizeof(int), n);
+    dump.column("order.amount", orders.amountData(), sizeof(double), n);
+    dump.column("order.type", orders.typeData(), sizeof(uint8_t), n);
+    dump.column("order.waiter", orders.waiterIdData(), sizeof(uint32_t), n);
+    dump.column("order.patron", orders.patronIdData(), sizeof(uint32_t), n);
+    dump.column("order.party_type", orders.partyTypeData(), sizeof(uint8_t), n);
+    dump.column("order.party_size", orders.partySizeData(), sizeof(uint16_t), n);
+    dump.column("order.timestamp", orders.timestampData(), sizeof(int64_t), n);
+    dump.column("order.item", orders.itemIdData(), sizeof(uint32_t), n);
+    dump.strings("items", orders.getItemPool().size(),
+                 [&](size_t i) { return orders.getItemPool().get(static_cast<uint32_t>(i)); });
+    dump.strings("patron.name", restaurant.getPatronCount(),
+                 [&](size_t i) { return restaurant.getPatron(static_cast<uint32_t>(i)).getName(); });
+    dump.column("patron.type", patronTypes);
+    dump.column("patron.group_size", groupSizes);
+    dump.column("waiter.id", waiterIds);
+    dump.strings("waiter.name", waiters.size(), [&](size_t i) -> const string& { return waiters[i]->getName(); });
+    dump.column("waiter.orders", waiterOrders);
+    dump.column("waiter.sales", waiterSales);
+    dump.column("waiter.commission", waiterCommission);
+    dump.column("order_type.orders", typeOrders);
+    dump.column("order_type.sales", typeSales);
+    dump.write(out);
+}
+
+// Zero-copy reader for the binary columnar dump: maps the file and points
+// straight at each column's values
+class ColumnarDump {
+public:
+    struct Column {
+        string name;
+        uint32_t elementSize;
+        uint64_t byteLength;
+        const char* data;
+        
+        size_t count() const { return elementSize ? byteLength / elementSize : 0; }
+    };
+
+private:
+    MappedFile file;
+    vector<Column> columns;
+
+public:
+    // Returns false if the file is missing, not a columnar dump with this
+    // magic and version, or truncated
+    bool open(const string& path, const char* magic = COLUMNAR_MAGIC, uint32_t expectedVersion = COLUMNAR_VERSION) {
+        columns.clear();
+        if (!file.open(path) || file.size() < 16 || memcmp(file.data(), magic, 8) != 0) {
+            return false;
+        }
+        uint32_t version, columnCount;
+        memcpy(&version, file.data() + 8, 4);
+        memcpy(&columnCount, file.data() + 12, 4);
+        if (version != expectedVersion) {
+            return false;
+        }
+        size_t offset = 16;
+        for (uint32_t i = 0; i < columnCount; i++) {
+            ColumnHeader header;
+            if (offset + sizeof(header) > file.size()) {
+                return false;
+            }
+            memcpy(&header, file.data() + offset, sizeof(header));
+            offset += sizeof(header);
+            if (header.byteLength > file.size() - offset) {
+                return false;
+            }
+            Column column;
+            column.name.assign(header.name, strnlen(header.name, sizeof(header.name)));
+            column.elementSize = header.elementSize;
+            column.byteLength = header.byteLength;
+            column.data = file.data() + offset;
+            columns.push_back(column);
+            offset += header.byteLength + (8 - header.byteLength % 8) % 8;
+        }
+        return true;
+    }
+    
+    const vector<Column>& getColumns() const { return columns; }
+    
+    const Column* find(const string& name) const {
+        for (const auto& column : columns) {
+            if (column.name == name) {
+                return &column;
+            }
+        }
+        return nullptr;
+    }
+    
+    // Typed pointer to a column's values, or nullptr if absent or of another element size
+    template <typename T>
+    const T* values(const string& name, size_t& count) const {
+        const Column* column = find(name);
+        if (!column || column->elementSize != sizeof(T)) {
+            count = 0;
+            return nullptr;
+        }
+        count = column->count();
+        return reinterpret_cast<const T*>(column->data);
+    }
+};
+
+// Restaurant snapshot: the complete state (waiters, patrons, orders, the
+// time index, nextOrderId and every running aggregate) in the columnar
+// dump layout under its own magic and version. Each column is the raw
+// array the restaurant keeps in memory, so saving is a few large writes and
+// restoring maps the file and copies each column back in one go. Rows refer
+// to each other by index rather than by pointer, and the string pools and
+// name registry are saved with their hash indexes, so the only fix-up is the
+// waiter pointers. Every stored index is range-checked before it is used. A
+// CRC-32C over all columns rejects a torn or corrupt file. The format is
+// native-endian and assumes the 64-bit sizes it was written with.
+static const char SNAPSHOT_MAGIC[8] = {'R', 'S', 'T', 'S', 'N', 'A', 'P', '1'};
+static const uint32_t SNAPSHOT_VERSION = 5;
+
+class RestaurantSnapshot {
+private:
+    static const size_t ANY = ~size_t(0);
+    
+    // Histograms are stored in this order: order types, patron types, waiters
+    template <typename RestaurantT, typename Histogram>
+    static void histograms(RestaurantT& restaurant, vector<Histogram*>& all) {
+        for (int t = 0; t < 2; t++) {
+            all.push_back(&restaurant.typeAmounts[t]);
+        }
+        for (int t = 0; t < 2; t++) {
+            all.push_back(&restaurant.patronTypeAmounts[t]);
+        }
+        for (const auto& waiter : restaurant.waiters) {
+            all.push_back(&waiter->amounts);
+        }
+    }
+    
+    template <typename T>
+    static const T* take(const ColumnarDump& dump, const char* name, size_t expected, size_t& count, string& error) {
+        const T* data = dump.values<T>(name, count);
+        if (!data || (expected != ANY && count != expected)) {
+            error = string("bad or missing column ") + name;
+            return nullptr;
+        }
+        return data;
+    }
+    
+    // Calls add(string) for every string of a strings() column pair
+    template <typename Add>
+    static bool takeStrings(const ColumnarDump& dump, const string& name, size_t expected, string& error, Add add) {
+        size_t offsetCount, dataSize;
+        const uint64_t* offsets = take<uint64_t>(dump, (name + ".offsets").c_str(), ANY, offsetCount, error);
+        const char* data = take<char>(dump, (name + ".data").c_str(), ANY, dataSize, error);
+        if (!offsets || !data || offsetCount == 0 || (expected != ANY && offsetCount != expected + 1)) {
+            error = "bad or missing strings " + name;
+            return false;
+        }
+        for (size_t i = 0; i + 1 < offsetCount; i++) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > dataSize) {
+                error = "bad offsets in strings " + name;
+                return false;
+            }
+            add(string(data + offsets[i], offsets[i + 1] - offsets[i]));
+        }
+        return true;
+    }
+
+    static void addPool(ColumnarDumpWriter& dump, const string& name, const StringPool& pool) {
+        dump.column(name + ".bytes", pool.bytes.data(), 1, pool.bytes.size());
+        dump.column(name + ".ends", pool.ends);
+        dump.column(name + ".slots", pool.slots);
+    }
+    
+    // Copies back a pool written by addPool once its ends and index check out
+    static bool takePool(const ColumnarDump& dump, const string& name, StringPool& pool, string& error) {
+        size_t byteCount, count, slotCount;
+        const char* bytes = take<char>(dump, (name + ".bytes").c_str(), ANY, byteCount, error);
+        const uint64_t* ends = take<uint64_t>(dump, (name + ".ends").c_str(), ANY, count, error);
+        const StringPool::Slot* slots = take<StringPool::Slot>(dump, (name + ".slots").c_str(), ANY, slotCount, error);
+        if (!bytes || !ends || !slots) {
+            return false;
+        }
+        bool ok = (slotCount & (slotCount - 1)) == 0 && count * 2 <= slotCount;
+        for (size_t i = 0; ok && i < count; i++) {
+            ok = ends[i] >= (i > 0 ? ends[i - 1] : 0) && ends[i] <= byteCount;
+        }
+        size_t used = 0;
+        for (size_t i = 0; ok && i < slotCount; i++) {
+            if (slots[i].id != StringPool::NO_STRING) {
+                ok = slots[i].id < count;
+                used++;
+            }
+        }
+        if (!ok || used != count) {
+            error = "bad string pool " + name;
+            return false;
+        }
+        pool.bytes.assign(bytes, byteCount);
+        pool.ends.assign(ends, ends + count);
+        pool.slots.assign(slots, slots + slotCount);
+        return true;
+    }
+
+public:
+    // Adds the restaurant's columns to dump. Most columns point into the
+    // restaurant, which must not change until the dump has been written.
+    static void collect(const Restaurant& restaurant, ColumnarDumpWriter& dump) {
+        const OrderStore& orders = restaurant.orders;
+        const PatronStore& patrons = restaurant.patrons;
+        const TimeIndex& timeIndex = restaurant.timeIndex;
+        timeIndex.mergePending();
+        
+        int64_t state[] = {restaurant.nextOrderId.load(), static_cast<int64_t>(restaurant.typeCounts[0]),
+                           static_cast<int64_t>(restaurant.typeCounts[1]), static_cast<int64_t>(patrons.namedCount)};
+        dump.copy("state", state, sizeof(int64_t), 4);
+        dump.strings("name", 1, [&](size_t) -> const string& { return restaurant.name; });
+        dump.copy("type.sales", restaurant.typeSales, sizeof(KahanSum), 2);
+        dump.copy("party_sizes", restaurant.partySizes.counts, sizeof(uint64_t), PartySizeHistogram::MAX_SIZE + 1);
+        
+        dump.column("order.id", orders.orderIds);
+        dump.column("order.amount", orders.amounts);
+        dump.column("order.type", orders.types);
+        dump.column("order.waiter", orders.waiterIds);
+        dump.column("order.patron", orders.patronIds);
+        dump.column("order.party_type", orders.partyTypes);
+        dump.column("order.party_size", orders.partySizes);
+        dump.column("order.timestamp", orders.timestamps);
+        dump.column("order.item", orders.itemIds);
+        addPool(dump, "menu", orders.menu.names);
+        dump.column("menu.price", orders.menu.prices);
+        addPool(dump, "items", orders.itemPool);
+        dump.column("items.lines", orders.lineItems);
+        dump.column("items.line_ends", orders.lineItemEnds);
+        dump.column("time.keys", timeIndex.keys);
+        dump.column("time.rows", timeIndex.rows);
+        
+        dump.column("patron.name_bytes", patrons.nameBytes.data(), 1, patrons.nameBytes.size());
+        dump.column("patron.name_offset", patrons.nameOffsets);
+        dump.column("patron.type", patrons.types);
+        dump.column("patron.group_size", patrons.groupSizes);
+        dump.column("patron.sit_in", patrons.sitIns);
+        dump.column("patron.guest", patrons.guests);
+        dump.column("patron.visits_in", patrons.visits[0]);
+        dump.column("patron.visits_out", patrons.visits[1]);
+        dump.column("patron.spend_in", patrons.spend[0]);
+        dump.column("patron.spend_out", patrons.spend[1]);
+        dump.column("patron.slots", patrons.slots);
+        
+        const auto& waiters = restaurant.waiters;
+        vector<int32_t> waiterIds;
+        vector<KahanSum> waiterSales;
+        vector<uint64_t> rowEnds;
+        uint64_t rows = 0;
+        for (const auto& waiter : waiters) {
+            waiterIds.push_back(waiter->waiterId);
+            waiterSales.push_back(waiter->sales);
+            rows += waiter->orderRows.size();
+            rowEnds.push_back(rows);
+        }
+        dump.copy("waiter.id", waiterIds.data(), sizeof(int32_t), waiterIds.size());
+        dump.strings("waiter.name", waiters.size(), [&](size_t i) -> const string& { return waiters[i]->name; });
+        dump.copy("waiter.sales", waiterSales.data(), sizeof(KahanSum), waiterSales.size());
+        dump.copy("waiter.row_ends", rowEnds.data(), sizeof(uint64_t), rowEnds.size());
+        dump.column("waiter.rows", nullptr, sizeof(size_t), 0);
+        for (const auto& waiter : waiters) {
+            dump.append(waiter->orderRows);
+        }
+        
+        vector<int64_t> stats;
+        vector<KahanSum> sums;
+        vector<const AmountHistogram*> all;
+        histograms(restaurant, all);
+        dump.column("hist.counts", nullptr, sizeof(uint64_t), 0);
+        for (const AmountHistogram* histogram : all) {
+            dump.append(histogram->counts);
+            stats.push_back(static_cast<int64_t>(histogram->total));
+            stats.push_back(histogram->minCents);
+            stats.push_back(histogram->maxCents);
+            sums.push_back(histogram->sum);
+        }
+        dump.copy("hist.stats", stats.data(), sizeof(int64_t), stats.size());
+        dump.copy("hist.sums", sums.data(), sizeof(KahanSum), sums.size());
+        
+        uint32_t crc = dump.checksum();
+        dump.copy("checksum", &crc, sizeof(crc), 1);
+    }
+    
+    // Writes to a temporary file and renames it over path
+    static bool save(const Restaurant& restaurant, const string& path) {
+        ColumnarDumpWriter dump;
+        collect(restaurant, dump);
+        const string temporary = path + ".tmp";
+        bool ok;
+        {
+            ReportWriter out(temporary);
+            if (!out.isOpen()) {
+                return false;
+            }
+            dump.write(out, SNAPSHOT_MAGIC, SNAPSHOT_VERSION);
+            ok = out.sync();
+        }
+        #ifdef _WIN32
+            remove(path.c_str());
+        #endif
+        return ok && rename(temporary.c_str(), path.c_str()) == 0;
+    }
+    
+    // Restores a snapshot into an empty restaurant with no journal attached.
+    // On failure error says why and the restaurant may be partly filled.
+    static bool restore(Restaurant& restaurant, const string& path, string& error) {
+        if (!restaurant.waiters.empty() || !restaurant.orders.empty() || restaurant.patrons.size() > 0) {
+            error = "the restaurant is not empty";
+            return false;
+        }
+        ColumnarDump dump;
+        if (!dump.open(path, SNAPSHOT_MAGIC, SNAPSHOT_VERSION)) {
+            error = "not a snapshot, truncated, or written by another version";
+            return false;
+        }
+        
+        // Columns are checksummed in file order, up to the checksum itself
+        const vector<ColumnarDump::Column>& columns = dump.getColumns();
+        if (columns.empty() || columns.back().name != "checksum" || columns.back().byteLength != sizeof(uint32_t)) {
+            error = "missing checksum";
+            return false;
+        }
+        uint32_t crc = 0, stored;
+        for (size_t i = 0; i + 1 < columns.size(); i++) {
+            crc = crc32c(columns[i].data, columns[i].byteLength, crc);
+        }
+        memcpy(&stored, columns.back().data, sizeof(stored));
+        if (crc != stored) {
+            error = "checksum mismatch";
+            return false;
+        }
+        
+        size_t count, n, patronCount, waiterCount;
+        const int64_t* state = take<int64_t>(dump, "state", 4, count, error);
+        const int* orderIds = take<int>(dump, "order.id", ANY, n, error);
+        const uint64_t* nameOffsets = take<uint64_t>(dump, "patron.name_offset", ANY, patronCount, error);
+        const int32_t* waiterIds = take<int32_t>(dump, "waiter.id", ANY, waiterCount, error);
+        if (!state || !orderIds || !nameOffsets || !waiterIds) {
+            return false;
+        }
+        
+        OrderStore& orders = restaurant.orders;
+        const double* amounts = take<double>(dump, "order.amount", n, count, error);
+        const uint8_t* types = take<uint8_t>(dump, "order.type", n, count, error);
+        const uint32_t* orderWaiters = take<uint32_t>(dump, "order.waiter", n, count, error);
+        const uint32_t* orderPatrons = take<uint32_t>(dump, "order.patron", n, count, error);
+        const uint8_t* orderPartyTypes = take<uint8_t>(dump, "order.party_type", n, count, error);
+        const uint16_t* orderPartySizes = take<uint16_t>(dump, "order.party_size", n, count, error);
+        const int64_t* timestamps = take<int64_t>(dump, "order.timestamp", n, count, error);
+        const uint32_t* itemIds = take<uint32_t>(dump, "order.item", n, count, error);
+        const int64_t* keys = take<int64_t>(dump, "time.keys", n, count, error);
+        const size_t* timeRows = take<size_t>(dump, "time.rows", n, count, error);
+        if (!amounts || !types || !orderWaiters || !orderPatrons || !orderPartyTypes || !orderPartySizes || !timestamps ||
+            !itemIds || !keys || !timeRows || !takePool(dump, "menu", orders.menu.names, error) ||
+            !takePool(dump, "items", orders.itemPool, error)) {
+            return false;
+        }
+        size_t menuSize = orders.menu.names.size(), listCount = orders.itemPool.size(), lineCount;
+        const double* prices = take<double>(dump, "menu.price", menuSize, count, error);
+        const LineItem* lines = take<LineItem>(dump, "items.lines", ANY, lineCount, error);
+        const uint32_t* lineEnds = take<uint32_t>(dump, "items.line_ends", listCount, count, error);
+        if (!prices || !lines || !lineEnds) {
+            return false;
+        }
+        for (size_t i = 0; i < lineCount; i++) {
+            if (lines[i].item >= menuSize) {
+                error = "bad line item";
+                return false;
+            }
+        }
+        for (size_t i = 0; i < listCount; i++) {
+            if (lineEnds[i] < (i > 0 ? lineEnds[i - 1] : 0) || lineEnds[i] > lineCount) {
+                error = "bad line item list";
+                return false;
+            }
+        }
+        for (size_t row = 0; row < n; row++) {
+            if (orderWaiters[row] >= waiterCount || orderPatrons[row] >= patronCount || itemIds[row] >= listCount ||
+                timeRows[row] >= n) {
+                error = "bad order row";
+                return false;
+            }
+        }
+        orders.menu.prices.assign(prices, prices + menuSize);
+        orders.lineItems.assign(lines, lines + lineCount);
+        orders.lineItemEnds.assign(lineEnds, lineEnds + listCount);
+        orders.orderIds.assign(orderIds, orderIds + n);
+        orders.amounts.assign(amounts, amounts + n);
+        orders.types.assign(types, types + n);
+        orders.waiterIds.assign(orderWaiters, orderWaiters + n);
+        orders.patronIds.assign(orderPatrons, orderPatrons + n);
+        orders.partyTypes.assign(orderPartyTypes, orderPartyTypes + n);
+        orders.partySizes.assign(orderPartySizes, orderPartySizes + n);
+        orders.timestamps.assign(timestamps, timestamps + n);
+        orders.itemIds.assign(itemIds, itemIds + n);
+        restaurant.timeIndex.keys.assign(keys, keys + n);
+        restaurant.timeIndex.rows.assign(timeRows, timeRows + n);
+        
+        PatronStore& patrons = restaurant.patrons;
+        const uint8_t* patronTypes = take<uint8_t>(dump, "patron.type", patronCount, count, error);
+        const int32_t* groupSizes = take<int32_t>(dump, "patron.group_size", patronCount, count, error);
+        const uint8_t* sitIns = take<uint8_t>(dump, "patron.sit_in", patronCount, count, error);
+        const uint8_t* guests = take<uint8_t>(dump, "patron.guest", patronCount, count, error);
+        const uint32_t* visitsIn = take<uint32_t>(dump, "patron.visits_in", patronCount, count, error);
+        const uint32_t* visitsOut = take<uint32_t>(dump, "patron.visits_out", patronCount, count, error);
+        const KahanSum* spendIn = take<KahanSum>(dump, "patron.spend_in", patronCount, count, error);
+        const KahanSum* spendOut = take<KahanSum>(dump, "patron.spend_out", patronCount, count, error);
+        size_t slotCount, nameSize;
+        const PatronStore::Slot* slots = take<PatronStore::Slot>(dump, "patron.slots", ANY, slotCount, error);
+        const char* nameBytes = take<char>(dump, "patron.name_bytes", ANY, nameSize, error);
+        if (!patronTypes || !groupSizes || !sitIns || !guests || !visitsIn || !visitsOut || !spendIn || !spendOut ||
+            !slots || !nameBytes) {
+            return false;
+        }
+        // The arena and index are copied as they are, so check every reference into them
+        for (size_t row = 0; row < patronCount; row++) {
+            uint32_t length = 0;
+            bool fits = nameOffsets[row] < nameSize && nameSize - nameOffsets[row] > sizeof(length);
+            if (fits) {
+                memcpy(&length, nameBytes + nameOffsets[row], sizeof(length));
+                fits = nameSize - nameOffsets[row] - sizeof(length) > length;
+            }
+            if (!fits) {
+                error = "bad patron name offset";
+                return false;
+            }
+        }
+        size_t usedSlots = 0;
+        bool indexOk = (slotCount & (slotCount - 1)) == 0;
+        for (size_t i = 0; indexOk && i < slotCount; i++) {
+            if (slots[i].row != PatronStore::NO_PATRON) {
+                indexOk = slots[i].row < patronCount && ++usedSlots * 2 <= slotCount;
+            }
+        }
+        if (!indexOk) {
+            error = "bad patron index";
+            return false;
+        }
+        patrons.nameBytes.assign(nameBytes, nameSize);
+        patrons.nameOffsets.assign(nameOffsets, nameOffsets + patronCount);
+        patrons.types.assign(patronTypes, patronTypes + patronCount);
+        patrons.groupSizes.assign(groupSizes, groupSizes + patronCount);
+        patrons.sitIns.assign(sitIns, sitIns + patronCount);
+        patrons.guests.assign(guests, guests + patronCount);
+        patrons.visits[0].assign(visitsIn, visitsIn + patronCount);
+        patrons.visits[1].assign(visitsOut, visitsOut + patronCount);
+        patrons.spend[0].assign(spendIn, spendIn + patronCount);
+        patrons.spend[1].assign(spendOut, spendOut + patronCount);
+        patrons.slots.assign(slots, slots + slotCount);
+        patrons.slotCount = usedSlots;
+        patrons.namedCount = static_cast<size_t>(state[3]);
+        
+        vector<string> waiterNames;
+        const KahanSum* waiterSales = take<KahanSum>(dump, "waiter.sales", waiterCount, count, error);
+        const uint64_t* rowEnds = take<uint64_t>(dump, "waiter.row_ends", waiterCount, count, error);
+        size_t rowCount;
+        const size_t* waiterRows = take<size_t>(dump, "waiter.rows", ANY, rowCount, error);
+        if (!waiterSales || !rowEnds || !waiterRows ||
+            !takeStrings(dump, "waiter.name", waiterCount, error, [&](const string& s) { waiterNames.push_back(s); })) {
+            return false;
+        }
+        const size_t histogramCount = 4 + waiterCount;
+        const uint64_t* histogramCounts = take<uint64_t>(dump, "hist.counts", histogramCount * AmountHistogram::BUCKETS,
+                                                         count, error);
+        const int64_t* stats = take<int64_t>(dump, "hist.stats", histogramCount * 3, count, error);
+        const KahanSum* sums = take<KahanSum>(dump, "hist.sums", histogramCount, count, error);
+        const uint64_t* partySizes = take<uint64_t>(dump, "party_sizes", PartySizeHistogram::MAX_SIZE + 1, count, error);
+        const KahanSum* typeSales = take<KahanSum>(dump, "type.sales", 2, count, error);
+        if (!histogramCounts || !stats || !sums || !partySizes || !typeSales) {
+            return false;
+        }
+        for (size_t i = 0; i < rowCount; i++) {
+            if (waiterRows[i] >= n) {
+                error = "bad waiter row list";
+                return false;
+            }
+        }
+        uint64_t rowBegin = 0;
+        for (size_t w = 0; w < waiterCount; w++) {
+            if (rowEnds[w] < rowBegin || rowEnds[w] > rowCount) {
+                error = "bad waiter row list";
+                return false;
+            }
+            auto waiter = make_shared<Waiter>(waiterIds[w], waiterNames[w]);
+            waiter->orderRows.assign(waiterRows + rowBegin, waiterRows + rowEnds[w]);
+            waiter->sales = waiterSales[w];
+            restaurant.addWaiter(waiter);
+            rowBegin = rowEnds[w];
+        }
+        
+        vector<AmountHistogram*> all;
+        histograms(restaurant, all);
+        for (size_t h = 0; h < all.size(); h++) {
+            AmountHistogram& histogram = *all[h];
+            const uint64_t* bucketCounts = histogramCounts + h * AmountHistogram::BUCKETS;
+            histogram.counts.assign(bucketCounts, bucketCounts + AmountHistogram::BUCKETS);
+            histogram.total = static_cast<uint64_t>(stats[h * 3]);
+            histogram.minCents = stats[h * 3 + 1];
+            histogram.maxCents = stats[h * 3 + 2];
+            histogram.sum = sums[h];
+        }
+        memcpy(restaurant.partySizes.counts, partySizes, sizeof(restaurant.partySizes.counts));
+        restaurant.typeSales[0] = typeSales[0];
+        restaurant.typeSales[1] = typeSales[1];
+        restaurant.typeCounts[0] = static_cast<size_t>(state[1]);
+        restaurant.typeCounts[1] = static_cast<size_t>(state[2]);
+        restaurant.nextOrderId = static_cast<int>(state[0]);
+        takeStrings(dump, "name", 1, error, [&](const string& s) { restaurant.name = s; });
+        return true;
+    }
+};
+
+// Writes a snapshot from a forked child process. The child gets a
+// copy-on-write image of the restaurant as it was at the fork and writes it
+// out while the parent carries on taking orders; the parent only pays for
+// collecting the columns and the fork itself, which copies page tables, not
+// data. The columns and the output buffer are prepared before forking so
+// the child does not allocate. The caller must hold off other writers
+// (OrderIntake::readSnapshot) for the duration of start(). Where fork is
+// not available the snapshot is written in the foreground.
+class BackgroundSnapshot {
+private:
+    string path;
+    int child;       // pid of the writer, 0 when none is running
+    bool lastSaved;  // outcome of the last finished snapshot
+
+public:
+    BackgroundSnapshot() : child(0), lastSaved(false) {}
+    
+    ~BackgroundSnapshot() { wait(); }
+    
+    BackgroundSnapshot(const BackgroundSnapshot&) = delete;
+    BackgroundSnapshot& operator=(const BackgroundSnapshot&) = delete;
+    
+    const string& getPath() const { return path; }
+    
+    // False if a snapshot is still being written or the fork failed
+    bool start(const Restaurant& restaurant, const string& snapshotPath) {
+        if (isRunning()) {
+            return false;
+        }
+        path = snapshotPath;
+        #ifdef _WIN32
+            lastSaved = RestaurantSnapshot::save(restaurant, path);
+            return true;
+        #else
+            ColumnarDumpWriter dump;
+            RestaurantSnapshot::collect(restaurant, dump);
+            const string temporary = path + ".tmp";
+            unique_ptr<ReportWriter> out(new ReportWriter(temporary));
+            if (!out->isOpen()) {
+                lastSaved = false;
+                return false;
+            }
+            fflush(nullptr); // nothing buffered may be written twice
+            pid_t pid = fork();
+            if (pid < 0) {
+                lastSaved = false;
+                return false;
+            }
+            if (pid == 0) {
+                // Other threads' locks are frozen in the child, so no metrics
+                Metrics::disable();
+                dump.write(*out, SNAPSHOT_MAGIC, SNAPSHOT_VERSION);
+                bool ok = out->sync() && rename(temporary.c_str(), path.c_str()) == 0;
+                _exit(ok ? 0 : 1);
+            }
+            child = pid;
+            return true;
+        #endif
+    }
+    
+    // Reaps a finished writer without blocking
+    bool isRunning() {
+        #ifndef _WIN32
+            if (child > 0) {
+                int status;
+                pid_t done = waitpid(child, &status, WNOHANG);
+                if (done == child || done < 0) {
+                    lastSaved = done == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                    child = 0;
+                }
+            }
+        #endif
+        return child > 0;
+    }
+    
+    // Waits for the writer; true if the last snapshot was saved
+    bool wait() {
+        #ifndef _WIN32
+            if (child > 0) {
+                int status;
+                pid_t done;
+                do {
+                    done = waitpid(child, &status, 0);
+                } while (done < 0 && errno == EINTR);
+                lastSaved = done == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                child = 0;
+            }
+        #endif
+        return lastSaved;
+    }
+};
+
+void exportReports(const Restaurant& restaurant, ReportFormat format, ReportWriter& out) {
+    switch (format) {
+        case ReportFormat::TEXT:
+            restaurant.generateAllReports(out);
+            break;
+        case ReportFormat::CSV:
+            exportCsv(restaurant, out);
+            break;
+        case ReportFormat::JSONL:
+            exportJsonLines(restaurant, out);
+            break;
+        case ReportFormat::BINARY:
+            exportBinary(restaurant, out);
+            break;
+    }
+}
+
+// Report selection for --report; text output only
+enum class ReportSelection {
+    ALL,
+    SUMMARY,
+    COUNTS,
+    SALES,
+    WAITERS,
+    COMMISSION,
+    ORDERS,
+    PATRONS,
+    VALUES,
+    HOURS,
+    ITEMS,
+    NONE
+};
+
+void writeTextReport(const Restaurant& restaurant, ReportSelection selection, ReportWriter& out) {
+    switch (selection) {
+        case ReportSelection::ALL:
+            restaurant.generateAllReports(out);
+            break;
+        case ReportSelection::SUMMARY:
+            restaurant.reportOrderCounts(out);
+            restaurant.reportTotalSales(out);
+            restaurant.reportWaiterSales(out);
+            restaurant.reportWaiterCommission(out);
+            break;
+        case ReportSelection::COUNTS:
+            restaurant.reportOrderCounts(out);
+            break;
+        case ReportSelection::SALES:
+            restaurant.reportTotalSales(out);
+            break;
+        case ReportSelection::WAITERS:
+            restaurant.reportWaiterSales(out);
+            break;
+        case ReportSelection::COMMISSION:
+            restaurant.reportWaiterCommission(out);
+            break;
+        case ReportSelection::ORDERS:
+            restaurant.displayAllOrders(out);
+            break;
+        case ReportSelection::PATRONS:
+            restaurant.reportTopPatrons(out);
+            break;
+        case ReportSelection::VALUES:
+            restaurant.reportOrderValues(out);
+            break;
+        case ReportSelection::HOURS:
+            restaurant.reportSalesByHour(out);
+            break;
+        case ReportSelection::ITEMS:
+            restaurant.reportTopItems(out);
+            restaurant.reportItemSalesByHour(out);
+            break;
+        case ReportSelection::NONE:
+            break;
+    }
+}
+
+// Bulk order ingestion (--ingest). Rows come from a CSV file with a header
+// line or from JSON Lines objects, keyed by the same names the exports use,
+// so an exported file can be ingested again. Fields point straight into the
+// mapped file; only quoted or escaped values are copied.
+
+enum IngestColumn {
+    INGEST_RECORD,
+    INGEST_PATRON,
+    INGEST_PATRON_TYPE,
+    INGEST_GROUP_SIZE,
+    INGEST_ORDER_TYPE,
+    INGEST_WAITER_ID,
+    INGEST_WAITER,
+    INGEST_TIMESTAMP,
+    INGEST_ITEMS,
+    INGEST_AMOUNT,
+    INGEST_COLUMN_COUNT
+};
+
+static const char* const INGEST_COLUMN_NAMES[INGEST_COLUMN_COUNT] = {
+    "record", "patron", "patron_type", "group_size", "order_type",
+    "waiter_id", "waiter", "timestamp", "items", "amount"
+};
+
+struct IngestField {
+    const char* data; // nullptr when the row has no such column
+    size_t size;
+};
+
+int ingestColumnFor(const char* name, size_t size) {
+    for (int column = 0; column < INGEST_COLUMN_COUNT; column++) {
+        if (strlen(INGEST_COLUMN_NAMES[column]) == size && memcmp(INGEST_COLUMN_NAMES[column], name, size) == 0) {
+            return column;
+        }
+    }
+    return -1;
+}
+
+// Case-insensitive comparison against a lowercase literal
+bool fieldIs(const IngestField& field, const char* text) {
+    size_t length = strlen(text);
+    if (field.size != length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        char c = field.data[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+        if (c != text[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseInteger(const IngestField& field, int64_t& value) {
+    const char* p = field.data;
+    const char* end = p + field.size;
+    bool negative = p < end && *p == '-';
+    if (negative) {
+        p++;
+    }
+    if (p == end || end - p > 18) {
+        return false;
+    }
+    int64_t result = 0;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        result = result * 10 + (*p - '0');
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+// Plain decimals ("-123.45") up to 15 significant digits are converted
+// exactly: the digits form an integer below 2^53 and one division by an exact
+// power of ten rounds correctly. Anything else goes through strtod.
+bool parseDecimal(const IngestField& field, double& value) {
+    static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+                                           1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    const char* p = field.data;
+    const char* end = p + field.size;
+    bool negative = p < end && *p == '-';
+    if (negative || (p < end && *p == '+')) {
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fractionDigits = -1;
+    for (; p < end; p++) {
+        if (*p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            digits++;
+            if (fractionDigits >= 0) {
+                fractionDigits++;
+            }
+        } else if (*p == '.' && fractionDigits < 0) {
+            fractionDigits = 0;
+        } else {
+            break;
+        }
+    }
+    if (p == end && digits > 0 && digits <= 15) {
+        double result = static_cast<double>(mantissa);
+        if (fractionDigits > 0) {
+            result /= POWERS_OF_TEN[fractionDigits];
+        }
+        value = negative ? -result : result;
+        return true;
+    }
+    
+    char buffer[64];
+    if (field.size == 0 || field.size >= sizeof(buffer)) {
+        return false;
+    }
+    memcpy(buffer, field.data, field.size);
+    buffer[field.size] = '\0';
+    char* parsedEnd;
+    value = strtod(buffer, &parsedEnd);
+    return parsedEnd == buffer + field.size && std::isfinite(value);
+}
+
+bool parseDigits(const char* p, int count, int& value) {
+    value = 0;
+    for (int i = 0; i < count; i++) {
+        if (p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (p[i] - '0');
+    }
+    return true;
+}
+
+// Accepts ISO 8601 "YYYY-MM-DDTHH:MM:SS" (as exported) and the report
+// format "DD/MM/YYYY HH:MM:SS"
+bool parseTimestamp(const IngestField& field, int64_t& seconds) {
+    const char* p = field.data;
+    int year, month, day, hour, minute, second;
+    bool parsed = false;
+    if (field.size == 19 && p[4] == '-' && p[7] == '-' && (p[10] == 'T' || p[10] == ' ')) {
+        parsed = parseDigits(p, 4, year) && parseDigits(p + 5, 2, month) && parseDigits(p + 8, 2, day);
+    } else if (field.size == 19 && p[2] == '/' && p[5] == '/' && p[10] == ' ') {
+        parsed = parseDigits(p, 2, day) && parseDigits(p + 3, 2, month) && parseDigits(p + 6, 4, year);
+    }
+    if (!parsed || p[13] != ':' || p[16] != ':' || !parseDigits(p + 11, 2, hour) ||
+        !parseDigits(p + 14, 2, minute) || !parseDigits(p + 17, 2, second)) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > Timestamp::daysInMonth(year, month) || hour > 23 || minute > 59 ||
+        second > 59) {
+        return false;
+    }
+    seconds = Timestamp(year, month, day, hour, minute, second).toEpochSeconds();
+    return true;
+}
+
+// Looks up or creates the patrons and waiters named by ingested rows and adds
+// the orders to the restaurant
+class OrderIngester {
+private:
+    Restaurant& restaurant;
+    unordered_map<int64_t, uint32_t> waitersById;    // waiter id -> position in getWaiters()
+    string key; // reused name buffer for new patrons
+    string items;
+    size_t ingested;
+
+public:
+    explicit OrderIngester(Restaurant& r) : restaurant(r), ingested(0) {
+        const auto& waiters = restaurant.getWaiters();
+        for (size_t i = 0; i < waiters.size(); i++) {
+            waitersById.emplace(waiters[i]->getWaiterId(), static_cast<uint32_t>(i));
+        }
+    }
+    
+    size_t getIngestedCount() const { return ingested; }
+    
+    // Returns nullptr on success, otherwise why the row was rejected
+    const char* addRow(const IngestField* fields) {
+        const IngestField& record = fields[INGEST_RECORD];
+        if (record.data && !fieldIs(record, "order")) {
+            return nullptr; // summary records of an export
+        }
+        
+        const IngestField& patronName = fields[INGEST_PATRON];
+        if (!patronName.data || patronName.size == 0) {
+            return "missing patron";
+        }
+        OrderType orderType;
+        const IngestField& orderTypeField = fields[INGEST_ORDER_TYPE];
+        if (orderTypeField.data && (fieldIs(orderTypeField, "sit-in") || fieldIs(orderTypeField, "sit_in"))) {
+            orderType = OrderType::SIT_IN;
+        } else if (orderTypeField.data && (fieldIs(orderTypeField, "take-out") || fieldIs(orderTypeField, "take_out"))) {
+            orderType = OrderType::TAKE_OUT;
+        } else {
+            return "order_type must be Sit-in or Take-out";
+        }
+        int64_t waiterId;
+        if (!fields[INGEST_WAITER_ID].data || !parseInteger(fields[INGEST_WAITER_ID], waiterId) ||
+            waiterId <= 0 || waiterId > numeric_limits<int>::max()) {
+            return "invalid waiter_id";
+        }
+        double amount;
+        if (!fields[INGEST_AMOUNT].data || !parseDecimal(fields[INGEST_AMOUNT], amount) || amount < 0) {
+            return "invalid amount";
+        }
+        int64_t seconds;
+        const IngestField& timestamp = fields[INGEST_TIMESTAMP];
+        if (!timestamp.data || timestamp.size == 0) {
+            seconds = Timestamp().toEpochSeconds();
+        } else if (!parseTimestamp(timestamp, seconds)) {
+            return "invalid timestamp";
+        }
+        
+        // Patrons are matched by name through the restaurant's patron index.
+        // The party is read on every row: a repeat patron may come alone one
+        // day and with a group the next. Empty fields fall back to the party
+        // the patron was registered with.
+        uint32_t patronId = restaurant.findPatron(patronName.data, patronName.size);
+        PatronType partyType = PatronType::INDIVIDUAL;
+        const IngestField& typeField = fields[INGEST_PATRON_TYPE];
+        if (typeField.data && fieldIs(typeField, "group")) {
+            partyType = PatronType::GROUP;
+        } else if (typeField.data && typeField.size > 0 && !fieldIs(typeField, "individual")) {
+            return "patron_type must be Individual or Group";
+        } else if ((!typeField.data || typeField.size == 0) && patronId != PatronStore::NO_PATRON) {
+            partyType = restaurant.getPatron(patronId).getType();
+        }
+        int64_t partySize = partyType == PatronType::GROUP ? 2 : 1;
+        const IngestField& sizeField = fields[INGEST_GROUP_SIZE];
+        if (sizeField.data && sizeField.size > 0) {
+            if (!parseInteger(sizeField, partySize) || partySize < 1 || partySize > 1000) {
+                return "invalid group_size";
+            }
+        } else if (patronId != PatronStore::NO_PATRON && partyType == restaurant.getPatron(patronId).getType()) {
+            partySize = restaurant.getPatron(patronId).getGroupSize();
+        }
+        if (patronId == PatronStore::NO_PATRON) {
+            key.assign(patronName.data, patronName.size);
+            patronId = restaurant.addPatron(key, partyType, static_cast<int>(partySize), orderType == OrderType::SIT_IN);
+        }
+        
+        auto waiter = waitersById.find(waiterId);
+        if (waiter == waitersById.end()) {
+            const IngestField& waiterName = fields[INGEST_WAITER];
+            string name = waiterName.data && waiterName.size > 0 ? string(waiterName.data, waiterName.size)
+                                                                  : "Waiter " + to_string(waiterId);
+            waiter = waitersById.emplace(waiterId, static_cast<uint32_t>(restaurant.getWaiterCount())).first;
+            restaurant.addWaiter(make_shared<Waiter>(static_cast<int>(waiterId), name));
+        }
+        
+        const IngestField& itemsField = fields[INGEST_ITEMS];
+        items.assign(itemsField.data ? itemsField.data : "", itemsField.data ? itemsField.size : 0);
+        restaurant.addOrder(patronId, partyType, static_cast<int>(partySize), orderType, amount, waiter->second, items,
+                            Timestamp::fromEpochSeconds(seconds));
+        ingested++;
+        return nullptr;
+    }
+};
+
+// Splits one CSV record (RFC 4180: quoted fields may hold commas, newlines
+// and doubled quotes) into fields, copying only fields with doubled quotes
+// into scratch. Returns the start of the next record; lines counts newlines.
+const char* splitCsvRecord(const char* p, const char* end, vector<IngestField>& fields,
+                           vector<string>& scratch, size_t& lines) {
+    fields.clear();
+    while (true) {
+        IngestField field;
+        if (p < end && *p == '"') {
+            const char* start = ++p;
+            bool escaped = false;
+            while (p < end && (*p != '"' || (p + 1 < end && p[1] == '"'))) {
+                if (*p == '"') {
+                    escaped = true;
+                    p++;
+                } else if (*p == '\n') {
+                    lines++;
+                }
+                p++;
+            }
+            field.data = start;
+            field.size = static_cast<size_t>(p - start);
+            if (escaped) {
+                if (scratch.size() <= fields.size()) {
+                    scratch.resize(fields.size() + 1);
+                }
+                string& copy = scratch[fields.size()];
+                copy.clear();
+                for (const char* q = start; q < p; q++) {
+                    copy.push_back(*q);
+                    if (*q == '"') {
+                        q++;
+                    }
+                }
+                field.data = copy.data();
+                field.size = copy.size();
+            }
+            if (p < end) {
+                p++; // closing quote
+            }
+            while (p < end && *p != ',' && *p != '\n') {
+                p++; // tolerate junk such as the \r of CRLF after the quote
+            }
+        } else {
+            const char* start = p;
+            while (p < end && *p != ',' && *p != '\n') {
+                p++;
+            }
+            const char* fieldEnd = p;
+            if (fieldEnd > start && fieldEnd[-1] == '\r' && (p == end || *p == '\n')) {
+                fieldEnd--;
+            }
+            field.data = start;
+            field.size = static_cast<size_t>(fieldEnd - start);
+        }
+        fields.push_back(field);
+        
+        if (p >= end) {
+            return end;
+        }
+        if (*p == '\n') {
+            lines++;
+            return p + 1;
+        }
+        p++; // comma
+    }
+}
+
+void appendUtf8(string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out.push_back(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+bool parseHex4(const char* p, const char* end, uint32_t& value) {
+    if (end - p < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (digit < 0) {
+            return false;
+        }
+        value = value * 16 + static_cast<uint32_t>(digit);
+    }
+    return true;
+}
+
+// Parses a JSON string starting at the opening quote. Strings without
+// escapes are returned in place; others are decoded into copy.
+bool parseJsonString(const char*& p, const char* end, IngestField& field, string& copy) {
+    const char* start = ++p;
+    while (p < end && *p != '"' && *p != '\\') {
+        p++;
+    }
+    if (p < end && *p == '"') {
+        field.data = start;
+        field.size = static_cast<size_t>(p - start);
+        p++;
+        return true;
+    }
+    
+    copy.assign(start, p);
+    while (p < end && *p != '"') {
+        if (*p != '\\') {
+            copy.push_back(*p++);
+            continue;
+        }
+        if (++p >= end) {
+            return false;
+        }
+        char c = *p++;
+        switch (c) {
+            case '"': case '\\': case '/': copy.push_back(c); break;
+            case 'b': copy.push_back('\b'); break;
+            case 'f': copy.push_back('\f'); break;
+            case 'n': copy.push_back('\n'); break;
+            case 'r': copy.push_back('\r'); break;
+            case 't': copy.push_back('\t'); break;
+            case 'u': {
+                uint32_t codePoint;
+                if (!parseHex4(p, end, codePoint)) {
+                    return false;
+                }
+                p += 4;
+                uint32_t low;
+                if (codePoint >= 0xD800 && codePoint < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+                    parseHex4(p + 2, end, low) && low >= 0xDC00 && low < 0xE000) {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+                appendUtf8(copy, codePoint);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    if (p >= end) {
+        return false;
+    }
+    p++;
+    field.data = copy.data();
+    field.size = copy.size();
+    return true;
+}
+
+// Parses one flat JSON object (string, number, true/false/null values) into
+// the ingest columns; unknown keys are ignored
+bool parseJsonObject(const char* p, const char* end, IngestField* fields, vector<string>& scratch) {
+    auto skipSpace = [&p, end]() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            p++;
+        }
+    };
+    skipSpace();
+    if (p >= end || *p != '{') {
+        return false;
+    }
+    p++;
+    skipSpace();
+    if (p < end && *p == '}') {
+        return true;
+    }
+    string keyCopy;
+    while (true) {
+        skipSpace();
+        IngestField key;
+        if (p >= end || *p != '"' || !parseJsonString(p, end, key, keyCopy)) {
+            return false;
+        }
+        int column = ingestColumnFor(key.data, key.size);
+        skipSpace();
+        if (p >= end || *p != ':') {
+            return false;
+        }
+        p++;
+        skipSpace();
+        
+        IngestField value;
+        if (p < end && *p == '"') {
+            if (!parseJsonString(p, end, value, scratch[column >= 0 ? column : INGEST_COLUMN_COUNT])) {
+                return false;
+            }
+        } else {
+            const char* start = p;
+            while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r') {
+                p++;
+            }
+            if (p == start || *start == '{' || *start == '[') {
+                return false;
+            }
+            value.data = start;
+            value.size = static_cast<size_t>(p - start);
+            if (value.size == 4 && memcmp(start, "null", 4) == 0) {
+                value.data = nullptr;
+                value.size = 0;
+            }
+        }
+        if (column >= 0) {
+            fields[column] = value;
+        }
+        
+        skipSpace();
+        if (p < end && *p == ',') {
+            p++;
+        } else if (p < end && *p == '}') {
+            return true;
+        } else {
+            return false;
+        }
+    }
+}
+
+struct IngestResult {
+    size_t rows;
+    size_t skipped;
+};
+
+// Ingests a CSV (header line first) or JSON Lines file, detected from the
+// first character. Bad rows are skipped and the first few reported on cerr.
+bool ingestOrders(Restaurant& restaurant, const string& path, IngestResult& result) {
+    result.rows = 0;
+    result.skipped = 0;
+    MappedFile file;
+    if (!file.open(path)) {
+        cerr << "Cannot read " << path << endl;
+        return false;
+    }
+    const char* p = file.data();
+    const char* end = p + file.size();
+    if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3; // UTF-8 byte order mark
+    }
+    
+    // One pass over the newlines sizes the store, so the inserts never reallocate
+    size_t lineCount = 0;
+    for (const char* q = p; (q = static_cast<const char*>(memchr(q, '\n', static_cast<size_t>(end - q)))) != nullptr; q++) {
+        lineCount++;
+    }
+    restaurant.reserveOrders(lineCount + 1);
+    
+    OrderIngester ingester(restaurant);
+    IngestField fields[INGEST_COLUMN_COUNT];
+    vector<string> scratch(INGEST_COLUMN_COUNT + 1);
+    size_t line = 1;
+    size_t nextLine = 1;
+    auto reject = [&](const char* reason) {
+        if (result.skipped++ < 5) {
+            cerr << path << ":" << line << ": " << reason << endl;
+        }
+    };
+    
+    const char* first = p;
+    while (first < end && (*first == ' ' || *first == '\t' || *first == '\r' || *first == '\n')) {
+        first++;
+    }
+    if (first < end && *first == '{') {
+        while (p < end) {
+            const char* lineEnd = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (!lineEnd) {
+                lineEnd = end;
+            }
+            const char* q = p;
+            while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r')) {
+                q++;
+            }
+            if (q < lineEnd) {
+                for (IngestField& field : fields) {
+                    field.data = nullptr;
+                    field.size = 0;
+                }
+                result.rows++;
+                if (!parseJsonObject(q, lineEnd, fields, scratch)) {
+                    reject("malformed JSON object");
+                } else if (const char* error = ingester.addRow(fields)) {
+                    reject(error);
+                }
+            }
+            p = lineEnd + (lineEnd < end ? 1 : 0);
+            line++;
+        }
+    } else {
+        vector<IngestField> row;
+        vector<string> csvScratch;
+        p = splitCsvRecord(p, end, row, csvScratch, nextLine);
+        vector<int> columns;
+        for (const IngestField& name : row) {
+            columns.push_back(ingestColumnFor(name.data, name.size));
+        }
+        const IngestColumn required[] = {INGEST_PATRON, INGEST_ORDER_TYPE, INGEST_WAITER_ID, INGEST_AMOUNT};
+        for (IngestColumn column : required) {
+            if (find(columns.begin(), columns.end(), static_cast<int>(column)) == columns.end()) {
+                cerr << path << ": header has no " << INGEST_COLUMN_NAMES[column] << " column" << endl;
+                return false;
+            }
+        }
+        
+        while (p < end) {
+            line = nextLine;
+            p = splitCsvRecord(p, end, row, csvScratch, nextLine);
+            if (row.size() == 1 && (row[0].size == 0 || (row[0].size == 1 && row[0].data[0] == '\r'))) {
+                continue; // blank line
+            }
+            for (IngestField& field : fields) {
+                field.data = nullptr;
+                field.size = 0;
+            }
+            for (size_t i = 0; i < row.size() && i < columns.size(); i++) {
+                if (columns[i] >= 0) {
+                    fields[columns[i]] = row[i];
+                }
+            }
+            result.rows++;
+            if (row.size() != columns.size()) {
+                reject("wrong number of fields");
+            } else if (const char* error = ingester.addRow(fields)) {
+                reject(error);
+            }
+        }
+    }
+    
+    if (result.skipped > 5) {
+        cerr << path << ": " << result.skipped - 5 << " more rows skipped" << endl;
+    }
+    return true;
+}
+
+// Staged pipeline for a live order feed: JSON Lines objects or CSV with a
+// header line, as --ingest reads them, arriving one line at a time. Each
+// stage has its own thread, and bounded lock-free SPSC rings join them:
+//
+//   feed --lines--> parse --fields--> build --> restaurant <-- write
+//
+// parse splits a line into the ingest fields without touching the
+// restaurant. build validates them, resolves patrons and waiters with the
+// same OrderIngester as --ingest and appends a block of orders; appending
+// indexes each order and updates the running totals. The journal, if any,
+// is committed once build has caught up. write runs queued order exports.
+//
+// Every stage drains its input in blocks of up to BATCH items. A full ring
+// pushes back: the stage feeding it waits, so a slow stage slows the feed
+// instead of growing a queue. build holds the restaurant lock for one
+// block at a time. Exports take the lock for EXPORT_CHUNK rows at a time
+// and write the rows out after releasing it, so a long export delays
+// intake by one chunk at most. Before each chunk the writer stands back
+// while lines are queued for parse or build: on a busy core a continuous
+// export would otherwise take the time slices the intake stages need.
+class OrderPipeline {
+public:
+    static const size_t RING_CAPACITY = 4096;
+    static const size_t BATCH = 256;
+    static const size_t EXPORT_CHUNK = 256;   // about 30 KB, a lock hold of tens of microseconds
+    static const size_t COMMIT_EVERY = 4096;  // orders between journal commits while busy
+
+private:
+    static const uint32_t NO_FIELD = ~0U;
+    
+    struct FeedLine {
+        string text;
+        uint64_t submitted;  // Metrics::now() when the line was fed
+    };
+    
+    // A split line: the text and where each ingest field sits in it. Values
+    // that had to be unescaped are appended to text, so they travel with it.
+    struct ParsedLine {
+        string text;
+        uint32_t offsets[INGEST_COLUMN_COUNT];  // NO_FIELD when absent
+        uint32_t sizes[INGEST_COLUMN_COUNT];
+        const char* error;   // set when the line could not be split
+        uint64_t line;
+        uint64_t submitted;
+    };
+    
+    Restaurant& restaurant;
+    OrderJournal* journal;
+    mutex restaurantLock;
+    SpscRing<FeedLine> lines;
+    SpscRing<ParsedLine> parsed;
+    SpscRing<string> exports;  // output paths
+    atomic<bool> feeding;
+    atomic<bool> parsing;
+    atomic<bool> building;
+    thread parser;
+    thread builder;
+    thread writer;
+    
+    // Written by the stage threads, read after finish()
+    string error;             // a CSV header without a required column
+    string journalError;      // the build stage's failed journal commit
+    const char* headerError;  // the same for the build stage's rejections
+    IngestResult result;
+    vector<string> rejections;  // the first few rejected rows
+    atomic<size_t> exportsWritten;
+    atomic<size_t> exportsFailed;
+    vector<uint64_t>* latencies;
+    
+    // Idle stages yield, then nap, so they cost little while the feed is quiet
+    static void idle(int& rounds) {
+        if (++rounds < 64) {
+            this_thread::yield();
+        } else {
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+    }
+    
+    template <typename T>
+    static void pushWaiting(SpscRing<T>& ring, T&& value) {
+        while (!ring.push(move(value))) {
+            this_thread::yield();
+        }
+    }
+    
+    void runParser() {
+        IngestField fields[INGEST_COLUMN_COUNT];
+        vector<string> scratch(INGEST_COLUMN_COUNT + 1);
+        vector<IngestField> row;
+        vector<string> csvScratch;
+        vector<int> columns;
+        bool json = false, csv = false;
+        uint64_t lineNumber = 0;  // first line of the record being split
+        uint64_t nextLine = 1;
+        int idleRounds = 0;
+        
+        auto split = [&](FeedLine& in) {
+            lineNumber = nextLine;
+            nextLine += 1 + static_cast<uint64_t>(count(in.text.begin(), in.text.end(), '\n'));
+            const char* p = in.text.data();
+            const char* end = p + in.text.size();
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+                p++;
+            }
+            if (p == end) {
+                return; // blank line
+            }
+            if (!json && !csv) {
+                json = *p == '{';
+                csv = !json;
+                if (csv) {
+                    size_t ignored = 0;
+                    splitCsvRecord(in.text.data(), end, row, csvScratch, ignored);
+                    for (const IngestField& name : row) {
+                        columns.push_back(ingestColumnFor(name.data, name.size));
+                    }
+                    const IngestColumn required[] = {INGEST_PATRON, INGEST_ORDER_TYPE, INGEST_WAITER_ID, INGEST_AMOUNT};
+                    for (IngestColumn column : required) {
+                        if (error.empty() && find(columns.begin(), columns.end(), static_cast<int>(column)) == columns.end()) {
+                            error = string("header has no ") + INGEST_COLUMN_NAMES[column] + " column";
+                            headerError = "no such column in the header";
+                        }
+                    }
+                    return;
+                }
+            }
+            
+            ParsedLine out;
+            out.error = headerError;
+            out.line = lineNumber;
+            out.submitted = in.submitted;
+            for (IngestField& field : fields) {
+                field.data = nullptr;
+                field.size = 0;
+            }
+            if (json) {
+                if (!parseJsonObject(p, end, fields, scratch)) {
+                    out.error = "malformed JSON object";
+                }
+            } else {
+                size_t ignored = 0;
+                splitCsvRecord(in.text.data(), end, row, csvScratch, ignored);
+                if (row.size() != columns.size()) {
+                    out.error = "wrong number of fields";
+                }
+                for (size_t i = 0; i < row.size() && i < columns.size(); i++) {
+                    if (columns[i] >= 0) {
+                        fields[columns[i]] = row[i];
+                    }
+                }
+            }
+            
+            // Fields inside the line keep their offsets; the others are
+            // appended once those are known, as appending may move the text
+            const char* base = in.text.data();
+            size_t length = in.text.size();
+            for (int c = 0; c < INGEST_COLUMN_COUNT; c++) {
+                bool inside = fields[c].data >= base && fields[c].data <= base + length;
+                out.offsets[c] = fields[c].data && inside ? static_cast<uint32_t>(fields[c].data - base) : NO_FIELD;
+                out.sizes[c] = static_cast<uint32_t>(fields[c].size);
+            }
+            for (int c = 0; c < INGEST_COLUMN_COUNT; c++) {
+                if (fields[c].data && out.offsets[c] == NO_FIELD) {
+                    out.offsets[c] = static_cast<uint32_t>(in.text.size());
+                    in.text.append(fields[c].data, fields[c].size);
+                }
+            }
+            out.text = move(in.text);
+            pushWaiting(parsed, move(out));
+        };
+        
+        while (true) {
+            bool done = !feeding.load(memory_order_acquire);
+            if (lines.drain(split, BATCH) > 0) {
+                idleRounds = 0;
+            } else if (done) {
+                break;
+            } else {
+                idle(idleRounds);
+            }
+        }
+        parsing.store(false, memory_order_release);
+    }
+    
+    void runBuilder() {
+        OrderIngester ingester(restaurant);
+        IngestField fields[INGEST_COLUMN_COUNT];
+        vector<uint64_t> submitted;
+        size_t uncommitted = 0;
+        int idleRounds = 0;
+        
+        auto add = [&](ParsedLine& line) {
+            for (int c = 0; c < INGEST_COLUMN_COUNT; c++) {
+                fields[c].data = line.offsets[c] == NO_FIELD ? nullptr : line.text.data() + line.offsets[c];
+                fields[c].size = line.sizes[c];
+            }
+            result.rows++;
+            const char* reason = line.error ? line.error : ingester.addRow(fields);
+            if (reason && result.skipped++ < 5) {
+                rejections.push_back(to_string(line.line) + ": " + reason);
+            }
+            submitted.push_back(line.submitted);
+        };
+        
+        while (true) {
+            bool done = !parsing.load(memory_order_acquire);
+            size_t count;
+            {
+                lock_guard<mutex> guard(restaurantLock);
+                count = parsed.drain(add, BATCH);
+            }
+            if (count > 0) {
+                idleRounds = 0;
+                uncommitted += count;
+                if (Metrics::enabled() || latencies) {
+                    uint64_t now = Metrics::now();
+                    for (uint64_t start : submitted) {
+                        Metrics::recordTime(METRIC_PIPELINE_LATENCY, now - start);
+                        if (latencies) {
+                            latencies->push_back(now - start);
+                        }
+                    }
+                }
+                submitted.clear();
+            }
+            // Group commit: once caught up, or after COMMIT_EVERY orders
+            if (journal && uncommitted > 0 && (count < BATCH || uncommitted >= COMMIT_EVERY)) {
+                if (!journal->commit() && journalError.empty()) {
+                    journalError = string("journal write failed: ") + journal->getErrorText();
+                }
+                uncommitted = 0;
+            }
+            if (count == 0) {
+                if (done) {
+                    break;
+                }
+                idle(idleRounds);
+            }
+        }
+        building.store(false, memory_order_release);
+    }
+    
+    void runWriter() {
+        int idleRounds = 0;
+        auto write = [this](string& path) {
+            ReportWriter out(path);
+            if (out.isOpen()) {
+                exportOrders(out);
+            }
+            if (out.isOpen() && !out.hasFailed()) {
+                exportsWritten++;
+            } else {
+                exportsFailed++;
+            }
+        };
+        while (true) {
+            bool done = !building.load(memory_order_acquire);
+            if (exports.drain(write) > 0) {
+                idleRounds = 0;
+            } else if (done) {
+                break;
+            } else {
+                idle(idleRounds);
+            }
+        }
+    }
+
+public:
+    // Orders go into restaurant, which nothing else may change until
+    // finish(); journal, if given, must already be attached to it
+    explicit OrderPipeline(Restaurant& r, OrderJournal* orderJournal = nullptr)
+        : restaurant(r), journal(orderJournal), lines(RING_CAPACITY), parsed(RING_CAPACITY), exports(64),
+          feeding(true), parsing(true), building(true), headerError(nullptr), exportsWritten(0), exportsFailed(0),
+          latencies(nullptr) {
+        result.rows = 0;
+        result.skipped = 0;
+        parser = thread([this]() { runParser(); });
+        builder = thread([this]() { runBuilder(); });
+        writer = thread([this]() { runWriter(); });
+    }
+    
+    ~OrderPipeline() {
+        finish();
+    }
+    
+    OrderPipeline(const OrderPipeline&) = delete;
+    OrderPipeline& operator=(const OrderPipeline&) = delete;
+    
+    // Records each order's time from feed() until it is in the restaurant,
+    // in nanoseconds; call before the first feed()
+    void logLatencies(vector<uint64_t>* log) { latencies = log; }
+    
+    // Feeds one JSON line or CSV record (whose quoted fields may span lines,
+    // newlines included); waits while the pipeline is full. Only one thread
+    // may feed records and queue exports.
+    void feed(string line) {
+        FeedLine in;
+        in.text = move(line);
+        in.submitted = Metrics::enabled() || latencies ? Metrics::now() : 0;
+        pushWaiting(lines, move(in));
+    }
+    
+    // Has the write stage export the detailed order report to path
+    void queueExport(const string& path) {
+        string queued = path;
+        pushWaiting(exports, move(queued));
+    }
+    
+    // Detailed order report of the orders in the restaurant when it starts,
+    // read a chunk at a time between the build stage's blocks, each once
+    // the intake stages have caught up (or after 64 yields, so a saturated
+    // feed cannot stall the export)
+    void exportOrders(ReportWriter& out) {
+        ScopedTimer timer(METRIC_REPORT_ORDERS);
+        size_t rows;
+        {
+            lock_guard<mutex> guard(restaurantLock);
+            rows = restaurant.getOrders().size();
+        }
+        out.newline().text("=== DETAILED ORDER REPORT ===").newline();
+        Restaurant::writeOrderHeader(out);
+        for (size_t from = 0; from < rows; from += EXPORT_CHUNK) {
+            for (int round = 0; round < 64 && !(lines.empty() && parsed.empty()); round++) {
+                this_thread::yield();
+            }
+            {
+                lock_guard<mutex> guard(restaurantLock);
+                restaurant.writeOrderRows(out, from, min(rows, from + EXPORT_CHUNK));
+            }
+            out.flush();
+        }
+    }
+    
+    // Runs fn on the restaurant between two blocks
+    template <typename Fn>
+    void readSnapshot(Fn fn) {
+        lock_guard<mutex> guard(restaurantLock);
+        fn(static_cast<const Restaurant&>(restaurant));
+    }
+    
+    // Waits until every fed line and queued export has gone through
+    void finish() {
+        if (!feeding.exchange(false)) {
+            return;
+        }
+        parser.join();
+        builder.join();
+        writer.join();
+    }
+    
+    // Exports finished so far
+    size_t getExportsWritten() const { return exportsWritten.load(); }
+    size_t getExportsFailed() const { return exportsFailed.load(); }
+    
+    // Valid after finish()
+    const string& getError() const { return error.empty() ? journalError : error; }
+    const IngestResult& getResult() const { return result; }
+    const vector<string>& getRejections() const { return rejections; }
+};
+
+const size_t OrderPipeline::RING_CAPACITY;
+const size_t OrderPipeline::BATCH;
+const size_t OrderPipeline::EXPORT_CHUNK;
+const size_t OrderPipeline::COMMIT_EVERY;
+
+// Ingests a live feed from in through the pipeline, a record at a time as it
+// arrives, rather than mapping the whole file. A CSV record ends at a
+// newline outside quotes: a line that leaves a quoted field open is joined
+// with the next ones until the quote closes, as splitCsvRecord expects.
+bool ingestFeed(Restaurant& restaurant, FILE* in, OrderJournal* journal, IngestResult& result) {
+    OrderPipeline pipeline(restaurant, journal);
+    char buffer[65536];
+    string record;
+    bool detected = false, csv = false;
+    bool quoted = false;  // the record so far ends inside a quoted field
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        const char* p = buffer;
+        const char* end = buffer + n;
+        while (p < end) {
+            const char* newline = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            const char* lineEnd = newline ? newline : end;
+            for (const char* q = p; !detected && q < lineEnd; q++) {
+                if (*q != ' ' && *q != '\t' && *q != '\r') {
+                    detected = true;
+                    csv = *q != '{';
+                }
+            }
+            if (csv && count(p, lineEnd, '"') % 2 != 0) {
+                quoted = !quoted; // doubled quotes inside a field cancel out
+            }
+            record.append(p, lineEnd);
+            if (!newline) {
+                break;
+            }
+            if (quoted) {
+                record.push_back('\n');
+            } else {
+                pipeline.feed(move(record));
+                record.clear();
+            }
+            p = newline + 1;
+        }
+    }
+    if (!record.empty()) {
+        pipeline.feed(move(record));
+    }
+    pipeline.finish();
+    
+    result = pipeline.getResult();
+    for (const string& rejection : pipeline.getRejections()) {
+        cerr << "stdin:" << rejection << endl;
+    }
+    if (result.skipped > 5) {
+        cerr << "stdin: " << result.skipped - 5 << " more rows skipped" << endl;
+    }
+    if (!pipeline.getError().empty()) {
+        cerr << "stdin: " << pipeline.getError() << endl;
+        return false;
+    }
+    return true;
+}
+
+// Discrete-event simulation (--simulate). The restaurant is empty every
+// morning, so each day is an independent run: days are simulated in
+// parallel, each from its own RNG stream, and their orders are appended to
+// the Restaurant in day order. The result is the same for any thread count.
+
+struct SimulationConfig {
+    int days;
+    int waiters;
+    int tablesPerWaiter;      // four-seat tables; a group takes ceil(size / 4)
+    int tables;               // 0: waiters * tablesPerWaiter
+    double demandScale;       // waiter-hours the arrival rates are scaled by; 0: waiters
+    int threads;              // 0: one per hardware thread
+    uint64_t seed;
+    int startYear, startMonth, startDay;
+    double openHour, closeHour;
+    // Arrival rate in parties per waiter-hour: a base rate plus Gaussian
+    // lunch (12:45) and dinner (19:00) peaks, scaled up on Fridays and Saturdays
+    double baseRate, lunchPeak, dinnerPeak, weekendFactor;
+    double groupShare, takeOutShare;
+    int maxGroupSize;
+    // Mean durations in minutes (exponentially distributed)
+    double orderMinutes, mealMinutes, groupMealMinutes, settleMinutes, takeOutMinutes, patienceMinutes;
+    
+    SimulationConfig()
+        : days(1), waiters(10), tablesPerWaiter(3), tables(0), demandScale(0.0), threads(0), seed(42), startYear(2025), startMonth(1), startDay(1),
+          openHour(10.0), closeHour(22.0), baseRate(1.0), lunchPeak(2.5), dinnerPeak(3.0), weekendFactor(1.3),
+          groupShare(0.3), takeOutShare(0.25), maxGroupSize(8), orderMinutes(2.5), mealMinutes(40.0),
+          groupMealMinutes(65.0), settleMinutes(3.0), takeOutMinutes(4.0), patienceMinutes(20.0) {}
+};
+
+// xoshiro256** seeded through splitmix64; one stream per simulated day
+class SimulationRandom {
+private:
+    uint64_t state[4];
+    
+    static uint64_t rotate(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    // Seed of an independent stream: stream i of the same base seed
+    static uint64_t streamSeed(uint64_t seed, uint64_t stream) {
+        uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    
+    explicit SimulationRandom(uint64_t seed) {
+        for (uint64_t& word : state) {
+            seed += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            word = z ^ (z >> 31);
+        }
+    }
+    
+    uint64_t next() {
+        uint64_t result = rotate(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotate(state[3], 45);
+        return result;
+    }
+    
+    // Uniform in [0, 1)
+    double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+    
+    // Uniform in [0, n)
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>((next() >> 32) * n >> 32); }
+    
+    double exponential(double mean) { return -mean * log1p(-uniform()); }
+    
+    bool chance(double probability) { return uniform() < probability; }
+};
+
+enum SimulationEventKind : uint8_t {
+    SIM_ARRIVAL,
+    SIM_ABANDON,
+    SIM_MEAL_DONE,
+    SIM_TASK_DONE
+};
+
+struct SimulationEvent {
+    double time;        // seconds since midnight
+    uint32_t sequence;  // breaks ties in scheduling order, keeping runs reproducible
+    uint32_t subject;   // party or waiter, depending on kind
+    uint8_t kind;
+};
+
+// 4-ary min-heap on (time, sequence): half the depth of a binary heap, and
+// the four children of a node share a cache line
+class EventQueue {
+private:
+    vector<SimulationEvent> heap;
+    uint32_t nextSequence;
+    
+    static bool before(const SimulationEvent& a, const SimulationEvent& b) {
+        return a.time < b.time || (a.time == b.time && a.sequence < b.sequence);
+    }
+
+public:
+    EventQueue() : nextSequence(0) {}
+    
+    bool empty() const { return heap.empty(); }
+    void reserve(size_t n) { heap.reserve(n); }
+    
+    void push(double time, uint8_t kind, uint32_t subject) {
+        SimulationEvent event;
+        event.time = time;
+        event.sequence = nextSequence++;
+        event.subject = subject;
+        event.kind = kind;
+        size_t i = heap.size();
+        heap.push_back(event);
+        while (i > 0) {
+            size_t parent = (i - 1) / 4;
+            if (!before(event, heap[parent])) {
+                break;
+            }
+            heap[i] = heap[parent];
+            i = parent;
+        }
+        heap[i] = event;
+    }
+    
+    SimulationEvent pop() {
+        SimulationEvent top = heap.front();
+        SimulationEvent last = heap.back();
+        heap.pop_back();
+        const size_t n = heap.size();
+        size_t i = 0;
+        while (true) {
+            size_t first = 4 * i + 1;
+            if (first >= n) {
+                break;
+            }
+            size_t best = first;
+            size_t end = min(first + 4, n);
+            for (size_t child = first + 1; child < end; child++) {
+                if (before(heap[child], heap[best])) {
+                    best = child;
+                }
+            }
+            if (!before(heap[best], last)) {
+                break;
+            }
+            heap[i] = heap[best];
+            i = best;
+        }
+        if (n > 0) {
+            heap[i] = last;
+        }
+        return top;
+    }
+};
+
+struct MenuDish {
+    const char* name;
+    double price;
+};
+
+static const MenuDish SIMULATION_MAINS[] = {
+    {"Bunny Chow", 85.0}, {"Bobotie", 120.0}, {"Boerewors Roll", 65.0}, {"Peri-Peri Chicken", 135.0},
+    {"Pap and Wors", 95.0}, {"Braai Platter", 180.0}, {"Vetkoek", 55.0}, {"Cape Malay Curry", 125.0}
+};
+static const MenuDish SIMULATION_DRINKS[] = {
+    {"Rooibos Tea", 25.0}, {"Coke", 22.0}, {"Castle Lager", 35.0}, {"Pinotage", 55.0}, {"Appletiser", 28.0}
+};
+static const MenuDish SIMULATION_DESSERTS[] = {
+    {"Malva Pudding", 50.0}, {"Koeksisters", 40.0}, {"Milk Tart", 45.0}
+};
+
+static const char* const SIMULATION_FIRST_NAMES[] = {
+    "Thabo", "Naledi", "Sipho", "Lindiwe", "Bongani", "Ayanda", "Pieter", "Refilwe",
+    "Musa", "Zinhle", "Johan", "Palesa", "Kabelo", "Nomvula", "Tshepo", "Anele"
+};
+static const char* const SIMULATION_SURNAMES[] = {
+    "Dlamini", "Nkosi", "Mokoena", "Naidoo", "Botha", "Khumalo", "Mahlangu", "Pillay",
+    "Van Wyk", "Sithole", "Molefe", "Ndlovu", "Petersen", "Zulu", "Mthembu", "Radebe"
+};
+
+string simulationName(uint32_t index) {
+    return string(SIMULATION_FIRST_NAMES[index % 16]) + " " + SIMULATION_SURNAMES[(index / 16) % 16];
+}
+
+// One order produced by a simulated day, ready to be added to a Restaurant
+struct SimulatedOrder {
+    int64_t timestamp;
+    double amount;
+    uint32_t waiter;        // position in the restaurant's waiter list
+    uint32_t itemsOffset;   // into SimulatedDay::items
+    uint32_t itemsLength;
+    uint16_t groupSize;
+    uint8_t orderType;
+    uint8_t patronType;
+    uint32_t patronName;    // simulationName() index
+};
+
+struct SimulatedDay {
+    vector<SimulatedOrder> orders;
+    string items;           // all item lists of the day, back to back
+    uint64_t events;
+    uint32_t parties;
+    uint32_t seated;
+    uint32_t takeOuts;
+    uint32_t abandoned;
+    double tableWaitMinutes;
+    double takeOutWaitMinutes;
+};
+
+class DaySimulation {
+private:
+    enum TaskKind : uint32_t { TASK_TAKE_ORDER, TASK_SETTLE, TASK_TAKE_OUT };
+    
+    struct Party {
+        double arrival;
+        uint32_t patronName;
+        uint16_t size;
+        uint8_t type;         // PatronType
+        bool takeOut;
+        bool seated;
+        bool abandoned;
+        uint16_t tables;
+        uint32_t waiter;
+    };
+    
+    struct SimWaiter {
+        bool busy;
+        uint32_t activeParties;
+        uint32_t currentTask;     // party << 2 | TaskKind
+        deque<uint32_t> tasks;    // this waiter's tables come before take-out
+    };
+    
+    const SimulationConfig& config;
+    SimulationRandom random;
+    SimulatedDay& day;
+    int64_t dayStart;
+    double rateScale;
+    double peakRate;
+    EventQueue events;
+    vector<Party> parties;
+    vector<SimWaiter> waiters;
+    int freeTables;
+    deque<uint32_t> seatingQueue;
+    deque<uint32_t> takeOutQueue;
+    uint32_t rotation; // where waiter searches start, so ties are shared out
+    
+    // First waiter from the rotation point minimising cost(waiter)
+    template <typename Cost>
+    uint32_t pickWaiter(Cost cost) {
+        const uint32_t n = static_cast<uint32_t>(waiters.size());
+        uint32_t best = rotation % n;
+        for (uint32_t step = 1; step < n; step++) {
+            uint32_t w = (rotation + step) % n;
+            if (cost(waiters[w]) < cost(waiters[best])) {
+                best = w;
+            }
+        }
+        rotation = best + 1;
+        return best;
+    }
+    
+    double arrivalRate(double seconds) const {
+        double hour = seconds / 3600.0;
+        double lunch = (hour - 12.75) / 0.75;
+        double dinner = (hour - 19.0) / 1.0;
+        return rateScale * (config.baseRate + config.lunchPeak * exp(-0.5 * lunch * lunch) +
+                            config.dinnerPeak * exp(-0.5 * dinner * dinner));
+    }
+    
+    // Non-homogeneous Poisson arrivals by thinning a process at the peak rate
+    void scheduleArrival(double after) {
+        const double close = config.closeHour * 3600.0;
+        double t = after;
+        while (true) {
+            t += random.exponential(3600.0 / peakRate);
+            if (t >= close) {
+                return;
+            }
+            if (random.uniform() * peakRate <= arrivalRate(t)) {
+                events.push(t, SIM_ARRIVAL, 0);
+                return;
+            }
+        }
+    }
+    
+    void startNextTask(uint32_t w, double now) {
+        SimWaiter& waiter = waiters[w];
+        if (waiter.busy) {
+            return;
+        }
+        uint32_t task;
+        if (!waiter.tasks.empty()) {
+            task = waiter.tasks.front();
+            waiter.tasks.pop_front();
+        } else if (!takeOutQueue.empty()) {
+            uint32_t party = takeOutQueue.front();
+            takeOutQueue.pop_front();
+            parties[party].waiter = w;
+            day.takeOutWaitMinutes += (now - parties[party].arrival) / 60.0;
+            task = party << 2 | TASK_TAKE_OUT;
+        } else {
+            return;
+        }
+        
+        const Party& party = parties[task >> 2];
+        double minutes;
+        switch (task & 3) {
+            case TASK_TAKE_ORDER: minutes = random.exponential(config.orderMinutes) + 0.5 * party.size; break;
+            case TASK_SETTLE: minutes = random.exponential(config.settleMinutes); break;
+            default: minutes = random.exponential(config.takeOutMinutes); break;
+        }
+        waiter.busy = true;
+        waiter.currentTask = task;
+        events.push(now + minutes * 60.0, SIM_TASK_DONE, w);
+    }
+    
+    void seatWaitingParties(double now) {
+        while (!seatingQueue.empty()) {
+            uint32_t id = seatingQueue.front();
+            Party& party = parties[id];
+            if (party.abandoned) {
+                seatingQueue.pop_front();
+                continue;
+            }
+            if (party.tables > freeTables) {
+                return; // first come, first seated
+            }
+            seatingQueue.pop_front();
+            freeTables -= party.tables;
+            party.seated = true;
+            day.seated++;
+            day.tableWaitMinutes += (now - party.arrival) / 60.0;
+            
+            uint32_t best = pickWaiter([](const SimWaiter& waiter) { return waiter.activeParties; });
+            party.waiter = best;
+            waiters[best].activeParties++;
+            waiters[best].tasks.push_back(id << 2 | TASK_TAKE_ORDER);
+            startNextTask(best, now);
+        }
+    }
+    
+    // Everyone orders a main, most a drink and some a dessert
+    void recordOrder(uint32_t id, double now) {
+        const Party& party = parties[id];
+        uint16_t counts[16] = {};
+        for (int person = 0; person < party.size; person++) {
+            counts[random.below(8)]++;
+            if (random.chance(0.7)) {
+                counts[8 + random.below(5)]++;
+            }
+            if (random.chance(0.2)) {
+                counts[13 + random.below(3)]++;
+            }
+        }
+        
+        SimulatedOrder order;
+        order.itemsOffset = static_cast<uint32_t>(day.items.size());
+        order.amount = 0.0;
+        for (int dish = 0; dish < 16; dish++) {
+            if (counts[dish] == 0) {
+                continue;
+            }
+            const MenuDish& item = dish < 8 ? SIMULATION_MAINS[dish]
+                                 : dish < 13 ? SIMULATION_DRINKS[dish - 8] : SIMULATION_DESSERTS[dish - 13];
+            if (day.items.size() > order.itemsOffset) {
+                day.items.append(", ");
+            }
+            if (counts[dish] > 1) {
+                char quantity[16];
+                day.items.append(quantity, static_cast<size_t>(snprintf(quantity, sizeof(quantity), "%ux ", counts[dish])));
+            }
+            day.items.append(item.name);
+            order.amount += counts[dish] * item.price;
+        }
+        order.itemsLength = static_cast<uint32_t>(day.items.size() - order.itemsOffset);
+        order.timestamp = dayStart + static_cast<int64_t>(now);
+        order.waiter = party.waiter;
+        order.groupSize = party.size;
+        order.orderType = static_cast<uint8_t>(party.takeOut ? OrderType::TAKE_OUT : OrderType::SIT_IN);
+        order.patronType = party.type;
+        order.patronName = party.patronName;
+        day.orders.push_back(order);
+    }
+    
+    void onArrival(double now) {
+        scheduleArrival(now);
+        
+        Party party;
+        party.arrival = now;
+        party.patronName = random.below(256);
+        bool group = random.chance(config.groupShare);
+        party.type = static_cast<uint8_t>(group ? PatronType::GROUP : PatronType::INDIVIDUAL);
+        party.size = static_cast<uint16_t>(group ? 2 + random.below(static_cast<uint32_t>(config.maxGroupSize - 1)) : 1);
+        party.takeOut = random.chance(config.takeOutShare);
+        party.seated = false;
+        party.abandoned = false;
+        party.tables = static_cast<uint16_t>((party.size + 3) / 4);
+        party.waiter = 0;
+        uint32_t id = static_cast<uint32_t>(parties.size());
+        parties.push_back(party);
+        day.parties++;
+        
+        if (party.takeOut) {
+            day.takeOuts++;
+            takeOutQueue.push_back(id);
+            uint32_t w = pickWaiter([](const SimWaiter& waiter) { return waiter.busy ? 1 : 0; });
+            startNextTask(w, now);
+        } else {
+            seatingQueue.push_back(id);
+            events.push(now + random.exponential(config.patienceMinutes) * 60.0, SIM_ABANDON, id);
+            seatWaitingParties(now);
+        }
+    }
+    
+    void onTaskDone(uint32_t w, double now) {
+        SimWaiter& waiter = waiters[w];
+        waiter.busy = false;
+        uint32_t id = waiter.currentTask >> 2;
+        switch (waiter.currentTask & 3) {
+            case TASK_TAKE_ORDER: {
+                const Party& party = parties[id];
+                double mean = party.type == static_cast<uint8_t>(PatronType::GROUP) ? config.groupMealMinutes
+                                                                                      : config.mealMinutes;
+                events.push(now + random.exponential(mean) * 60.0, SIM_MEAL_DONE, id);
+                break;
+            }
+            case TASK_SETTLE:
+                recordOrder(id, now);
+                freeTables += parties[id].tables;
+                waiter.activeParties--;
+                seatWaitingParties(now);
+                break;
+            default:
+                recordOrder(id, now);
+                break;
+        }
+        startNextTask(w, now);
+    }
+
+public:
+    DaySimulation(const SimulationConfig& simulationConfig, int dayIndex, SimulatedDay& result)
+        : config(simulationConfig), random(simulationConfig.seed * 0x9E3779B97F4A7C15ULL + static_cast<uint64_t>(dayIndex)),
+          day(result), waiters(static_cast<size_t>(simulationConfig.waiters)),
+          freeTables(simulationConfig.tables > 0 ? simulationConfig.tables
+                                                  : simulationConfig.waiters * simulationConfig.tablesPerWaiter),
+          rotation(0) {
+        int64_t days = Timestamp::daysFromCivil(config.startYear, config.startMonth, config.startDay) + dayIndex;
+        dayStart = days * 86400;
+        int weekday = static_cast<int>(((days + 4) % 7 + 7) % 7); // 0 = Sunday
+        rateScale = (config.demandScale > 0.0 ? config.demandScale : config.waiters) *
+                    (weekday == 5 || weekday == 6 ? config.weekendFactor : 1.0);
+        peakRate = 0.0;
+        for (double t = config.openHour * 3600.0; t <= config.closeHour * 3600.0; t += 60.0) {
+            peakRate = max(peakRate, arrivalRate(t));
+        }
+        peakRate *= 1.01;
+        for (SimWaiter& waiter : waiters) {
+            waiter.busy = false;
+            waiter.activeParties = 0;
+            waiter.currentTask = 0;
+        }
+        
+        day.orders.clear();
+        day.items.clear();
+        day.events = 0;
+        day.parties = day.seated = day.takeOuts = day.abandoned = 0;
+        day.tableWaitMinutes = day.takeOutWaitMinutes = 0.0;
+    }
+    
+    void run() {
+        events.reserve(4 * waiters.size() * static_cast<size_t>(config.tablesPerWaiter) + 64);
+        scheduleArrival(config.openHour * 3600.0);
+        while (!events.empty()) {
+            SimulationEvent event = events.pop();
+            day.events++;
+            switch (event.kind) {
+                case SIM_ARRIVAL:
+                    onArrival(event.time);
+                    break;
+                case SIM_ABANDON:
+                    if (!parties[event.subject].seated && !parties[event.subject].abandoned) {
+                        parties[event.subject].abandoned = true;
+                        day.abandoned++;
+                    }
+                    break;
+                case SIM_MEAL_DONE: {
+                    uint32_t w = parties[event.subject].waiter;
+                    waiters[w].tasks.push_back(event.subject << 2 | TASK_SETTLE);
+                    startNextTask(w, event.time);
+                    break;
+                }
+                case SIM_TASK_DONE:
+                    onTaskDone(event.subject, event.time);
+                    break;
+            }
+        }
+    }
+};
+
+struct SimulationSummary {
+    uint64_t events;
+    uint64_t parties;
+    uint64_t seated;
+    uint64_t takeOuts;
+    uint64_t abandoned;
+    uint64_t orders;
+    double tableWaitMinutes;
+    double takeOutWaitMinutes;
+    double simulateSeconds;   // the parallel event loop
+    double totalSeconds;      // including loading the orders into the Restaurant
+    int threads;
+};
+
+// Simulates config.days days into the restaurant, after any orders it
+// already holds (e.g. from a snapshot). Simulated waiters are matched to
+// existing ones by id, as ingest does, and added when missing.
+void runSimulation(Restaurant& restaurant, const SimulationConfig& config, SimulationSummary& summary) {
+    auto start = chrono::steady_clock::now();
+    vector<uint32_t> waiterPositions;
+    for (int i = 1; i <= config.waiters; i++) {
+        const auto& waiters = restaurant.getWaiters();
+        uint32_t position = 0;
+        while (position < waiters.size() && waiters[position]->getWaiterId() != i) {
+            position++;
+        }
+        if (position == waiters.size()) {
+            restaurant.addWaiter(make_shared<Waiter>(i, simulationName(static_cast<uint32_t>(i * 37 + 5))));
+        }
+        waiterPositions.push_back(position);
+    }
+    for (const MenuDish& dish : SIMULATION_MAINS) {
+        restaurant.setMenuPrice(dish.name, dish.price);
+    }
+    for (const MenuDish& dish : SIMULATION_DRINKS) {
+        restaurant.setMenuPrice(dish.name, dish.price);
+    }
+    for (const MenuDish& dish : SIMULATION_DESSERTS) {
+        restaurant.setMenuPrice(dish.name, dish.price);
+    }
+    
+    vector<SimulatedDay> days(static_cast<size_t>(config.days));
+    int threadCount = config.threads > 0 ? config.threads : static_cast<int>(thread::hardware_concurrency());
+    threadCount = max(1, min(threadCount, config.days));
+    atomic<int> nextDay(0);
+    auto worker = [&]() {
+        for (int d = nextDay++; d < config.days; d = nextDay++) {
+            DaySimulation(config, d, days[static_cast<size_t>(d)]).run();
+        }
+    };
+    vector<thread> threads;
+    for (int i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (thread& t : threads) {
+        t.join();
+    }
+    summary.simulateSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    summary.threads = threadCount;
+    
+    summary.events = summary.parties = summary.seated = summary.takeOuts = summary.abandoned = summary.orders = 0;
+    summary.tableWaitMinutes = summary.takeOutWaitMinutes = 0.0;
+    for (const SimulatedDay& day : days) {
+        summary.orders += day.orders.size();
+    }
+    restaurant.reserveOrders(summary.orders);
+    restaurant.reservePatrons(summary.orders);
+    
+    // Every party becomes a new patron; names repeat from a 256-name table
+    vector<string> names;
+    for (uint32_t i = 0; i < 256; i++) {
+        names.push_back(simulationName(i));
+    }
+    string items;
+    for (SimulatedDay& day : days) {
+        for (const SimulatedOrder& order : day.orders) {
+            OrderType type = static_cast<OrderType>(order.orderType);
+            uint32_t patronId = restaurant.addGuest(names[order.patronName], static_cast<PatronType>(order.patronType),
+                                                    order.groupSize, type == OrderType::SIT_IN);
+            items.assign(day.items, order.itemsOffset, order.itemsLength);
+            restaurant.addOrder(patronId, type, order.amount, waiterPositions[order.waiter], items,
+                                Timestamp::fromEpochSeconds(order.timestamp));
+        }
+        summary.events += day.events;
+        summary.parties += day.parties;
+        summary.seated += day.seated;
+        summary.takeOuts += day.takeOuts;
+        summary.abandoned += day.abandoned;
+        summary.tableWaitMinutes += day.tableWaitMinutes;
+        summary.takeOutWaitMinutes += day.takeOutWaitMinutes;
+        vector<SimulatedOrder>().swap(day.orders);
+        string().swap(day.items);
+    }
+    summary.totalSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Thread pool with one task deque per worker. Owners take from the back of
+// their own deque; idle workers steal from the front of the others, so
+// uneven task costs even out. The caller takes part as worker 0.
+class WorkStealingPool {
+private:
+    struct TaskQueue {
+        mutex lock;
+        deque<size_t> tasks;
+    };
+    
+    vector<thread> workers;
+    vector<unique_ptr<TaskQueue>> queues;
+    mutex stateLock;
+    condition_variable wake;
+    condition_variable finished;
+    function<void(size_t)> job;
+    uint64_t generation;
+    int running;
+    bool stopping;
+    
+    bool takeTask(size_t worker, size_t& task) {
+        {
+            TaskQueue& own = *queues[worker];
+            lock_guard<mutex> guard(own.lock);
+            if (!own.tasks.empty()) {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t step = 1; step < queues.size(); step++) {
+            TaskQueue& victim = *queues[(worker + step) % queues.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void work(size_t worker) {
+        size_t task;
+        while (takeTask(worker, task)) {
+            job(task);
+        }
+    }
+    
+    void workerLoop(size_t worker) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> guard(stateLock);
+                wake.wait(guard, [&]() { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            work(worker);
+            lock_guard<mutex> guard(stateLock);
+            if (--running == 0) {
+                finished.notify_one();
+            }
+        }
+    }
+
+public:
+    explicit WorkStealingPool(int threads) : generation(0), running(0), stopping(false) {
+        size_t count = static_cast<size_t>(max(1, threads));
+        for (size_t i = 0; i < count; i++) {
+            queues.emplace_back(new TaskQueue());
+        }
+        for (size_t i = 1; i < count; i++) {
+            workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+    
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> guard(stateLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+    }
+    
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    
+    int size() const { return static_cast<int>(queues.size()); }
+    
+    // Runs fn(0) ... fn(count - 1) across the pool and returns when all are done.
+    // Each worker starts on a contiguous block of indices.
+    void forEach(size_t count, function<void(size_t)> fn) {
+        job = move(fn);
+        const size_t n = queues.size();
+        for (size_t w = 0; w < n; w++) {
+            lock_guard<mutex> guard(queues[w]->lock);
+            for (size_t i = w * count / n; i < (w + 1) * count / n; i++) {
+                queues[w]->tasks.push_back(i);
+            }
+        }
+        {
+            lock_guard<mutex> guard(stateLock);
+            running = static_cast<int>(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+        work(0);
+        unique_lock<mutex> guard(stateLock);
+        finished.wait(guard, [&]() { return running == 0; });
+    }
+};
+
+// Mean with a two-sided 95% confidence interval (Student's t)
+struct ConfidenceInterval {
+    double mean;
+    double stddev;
+    double halfWidth;
+};
+
+// values[i * stride] for i < n, summed in index order so the result does not
+// depend on how the values were computed
+ConfidenceInterval confidenceInterval(const double* values, size_t n, size_t stride) {
+    static const double T_975[] = {0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    ConfidenceInterval interval = {0.0, 0.0, 0.0};
+    if (n == 0) {
+        return interval;
+    }
+    KahanSum sum;
+    for (size_t i = 0; i < n; i++) {
+        sum.add(values[i * stride]);
+    }
+    interval.mean = sum.value() / n;
+    if (n > 1) {
+        KahanSum squares;
+        for (size_t i = 0; i < n; i++) {
+            double d = values[i * stride] - interval.mean;
+            squares.add(d * d);
+        }
+        interval.stddev = sqrt(squares.value() / (n - 1));
+        double t = n - 1 <= 30 ? T_975[n - 1] : 1.96;
+        interval.halfWidth = t * interval.stddev / sqrt(static_cast<double>(n));
+    }
+    return interval;
+}
+
+// Monte Carlo staffing study (--replicate): N independent simulated days
+// per roster size, each in its own Restaurant. The restaurant (tables and
+// demand) is sized for the first roster and the others staff that same
+// floor. Replication i uses the same seed for every roster size (common
+// random numbers), which narrows the differences between roster sizes.
+struct ReplicationStudy {
+    vector<int> rosters;
+    size_t replications;
+    SimulationConfig config;
+    // Per task (roster-major, then replication): the summary metrics followed
+    // by sales and commission for each waiter
+    vector<vector<double>> results;
+    CommissionRule commissionRule;
+    double seconds;
+    int threads;
+};
+
+enum ReplicationMetric {
+    METRIC_ORDERS,
+    METRIC_SALES,
+    METRIC_SIT_IN_SALES,
+    METRIC_TAKE_OUT_SALES,
+    METRIC_COMMISSION_PER_WAITER,
+    METRIC_WALK_OUTS,
+    METRIC_TABLE_WAIT,
+    METRIC_COUNT
+};
+
+static const char* const REPLICATION_METRIC_NAMES[METRIC_COUNT] = {
+    "Orders", "Total sales (R)", "Sit-in sales (R)", "Take-out sales (R)",
+    "Commission per waiter (R)", "Walk-outs", "Mean table wait (min)"
+};
+
+void runReplications(ReplicationStudy& study, int threads) {
+    auto start = chrono::steady_clock::now();
+    const size_t tasks = study.rosters.size() * study.replications;
+    study.results.assign(tasks, vector<double>());
+    WorkStealingPool pool(threads > 0 ? threads : static_cast<int>(thread::hardware_concurrency()));
+    study.threads = pool.size();
+    
+    pool.forEach(tasks, [&study](size_t task) {
+        SimulationConfig config = study.config;
+        config.waiters = study.rosters[task / study.replications];
+        config.days = 1;
+        config.threads = 1;
+        config.seed = SimulationRandom::streamSeed(study.config.seed, task % study.replications);
+        
+        Restaurant restaurant("Replication");
+        restaurant.setCommissionRule(study.commissionRule);
+        SimulationSummary summary;
+        runSimulation(restaurant, config, summary);
+        
+        vector<double>& values = study.results[task];
+        values.resize(METRIC_COUNT + 2 * static_cast<size_t>(config.waiters));
+        values[METRIC_ORDERS] = static_cast<double>(summary.orders);
+        values[METRIC_SALES] = restaurant.getTotalSales();
+        values[METRIC_SIT_IN_SALES] = restaurant.getSales(OrderType::SIT_IN);
+        values[METRIC_TAKE_OUT_SALES] = restaurant.getSales(OrderType::TAKE_OUT);
+        values[METRIC_COMMISSION_PER_WAITER] = restaurant.getTotalCommission() / config.waiters;
+        values[METRIC_WALK_OUTS] = static_cast<double>(summary.abandoned);
+        values[METRIC_TABLE_WAIT] = summary.seated ? summary.tableWaitMinutes / summary.seated : 0.0;
+        const auto& waiters = restaurant.getWaiters();
+        vector<double> commissions;
+        restaurant.getWaiterCommissions(commissions);
+        for (size_t w = 0; w < waiters.size(); w++) {
+            values[METRIC_COUNT + 2 * w] = waiters[w]->getTotalSales();
+            values[METRIC_COUNT + 2 * w + 1] = commissions[w];
+        }
+    });
+    study.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void reportReplications(const ReplicationStudy& study, ReportWriter& out) {
+    const size_t n = study.replications;
+    vector<double> column(n);
+    auto interval = [&](size_t roster, size_t index) {
+        for (size_t i = 0; i < n; i++) {
+            column[i] = study.results[roster * n + i][index];
+        }
+        return confidenceInterval(column.data(), n, 1);
+    };
+    
+    out.newline().text("=== STAFFING REPLICATION REPORT ===").newline();
+    out.number(static_cast<int64_t>(n), 0).text(" simulated days per roster size, means with 95% confidence intervals").newline();
+    out.rule(80, '-').newline();
+    out.left("Waiters", 9).left("Metric", 29).right("Mean", 15).right("+/- 95% CI", 14).right("Std dev", 13).newline();
+    out.rule(80, '-').newline();
+    for (size_t r = 0; r < study.rosters.size(); r++) {
+        for (int metric = 0; metric < METRIC_COUNT; metric++) {
+            ConfidenceInterval ci = interval(r, static_cast<size_t>(metric));
+            if (metric == 0) {
+                out.number(study.rosters[r], 9, true);
+            } else {
+                out.left("", 9);
+            }
+            out.left(REPLICATION_METRIC_NAMES[metric], 29).amount(ci.mean, 15).amount(ci.halfWidth, 14);
+            out.amount(ci.stddev, 13).newline();
+        }
+        out.rule(80, '-').newline();
+    }
+    
+    for (size_t r = 0; r < study.rosters.size(); r++) {
+        out.newline().text("=== WAITER SALES AND COMMISSION (").number(study.rosters[r], 0).text(" waiters) ===").newline();
+        out.rule(80, '-').newline();
+        out.left("ID", 5).right("Sales", 16).right("+/- 95% CI", 14).right("Commission", 16).right("+/- 95% CI", 14).newline();
+        out.rule(80, '-').newline();
+        for (int w = 0; w < study.rosters[r]; w++) {
+            ConfidenceInterval sales = interval(r, METRIC_COUNT + 2 * static_cast<size_t>(w));
+            ConfidenceInterval commission = interval(r, METRIC_COUNT + 2 * static_cast<size_t>(w) + 1);
+            out.number(w + 1, 5, true).amount(sales.mean, 16).amount(sales.halfWidth, 14);
+            out.amount(commission.mean, 16).amount(commission.halfWidth, 14).newline();
+        }
+    }
+}
+
+// One branch's orders for one trading day. Each shard owns its order store,
+// so shards are filled and scanned independently of each other.
+class OrderShard {
+private:
+    OrderStore orders; // waiter ids are positions in the branch roster
+
+public:
+    void reserve(size_t n) { orders.reserve(n); }
+    
+    void add(int orderId, OrderType type, double amount, uint32_t waiterPosition, uint32_t itemId,
+             int64_t epochSeconds) {
+        orders.append(orderId, PatronStore::NO_PATRON, PatronType::INDIVIDUAL, 1, type, amount, waiterPosition,
+                      itemId, epochSeconds);
+    }
+    
+    uint32_t internItems(const string& items) { return orders.internItems(items); }
+    
+    const OrderStore& getOrders() const { return orders; }
+};
+
+// Sales of one branch over a range of days
+struct BranchSales {
+    KahanSum typeSales[2];          // by OrderType
+    uint64_t typeCounts[2];
+    vector<KahanSum> waiterSales;   // by position in the branch roster
+    vector<uint64_t> waiterCounts;
+    vector<KahanSum> waiterCommission;
+    size_t shards;                  // days with orders in the range
+};
+
+// A chain of restaurants with orders sharded by branch and trading day.
+// Each branch keeps its shards in a map keyed by day number, so a query
+// over a range of days finds its shards with one lookup per branch and
+// then only reads the shards in the range, whatever the total history.
+// Branches are scanned in parallel on the group's thread pool with the
+// sales kernels; within a branch, shards are added in day order, and the
+// chain totals add the branches in order, so results do not depend on the
+// number of threads.
+class RestaurantGroup {
+private:
+    struct Branch {
+        string name;
+        vector<pair<int, string>> roster; // waiter id and name, by position
+        map<int64_t, unique_ptr<OrderShard>> days;
+    };
+    
+    vector<Branch> branches;
+    WorkStealingPool pool;
+    int nextOrderId;
+    int64_t firstDay;
+    int64_t lastDay;
+
+public:
+    explicit RestaurantGroup(int threads)
+        : pool(threads > 0 ? threads : static_cast<int>(thread::hardware_concurrency())), nextOrderId(1),
+          firstDay(0), lastDay(-1) {}
+    
+    uint32_t addBranch(const string& name) {
+        branches.push_back(Branch());
+        branches.back().name = name;
+        return static_cast<uint32_t>(branches.size() - 1);
+    }
+    
+    // Returns the waiter's position in the branch roster
+    uint32_t addWaiter(uint32_t branch, int waiterId, const string& name) {
+        branches[branch].roster.push_back(make_pair(waiterId, name));
+        return static_cast<uint32_t>(branches[branch].roster.size() - 1);
+    }
+    
+    // The shard for a branch and day, created empty if needed. Not safe to
+    // call concurrently, but distinct shards can be filled from different
+    // threads once they exist.
+    OrderShard& shard(uint32_t branch, int64_t dayNumber) {
+        unique_ptr<OrderShard>& slot = branches[branch].days[dayNumber];
+        if (!slot) {
+            slot.reset(new OrderShard());
+            if (firstDay > lastDay) {
+                firstDay = lastDay = dayNumber;
+            }
+            firstDay = min(firstDay, dayNumber);
+            lastDay = max(lastDay, dayNumber);
+        }
+        return *slot;
+    }
+    
+    void addOrder(uint32_t branch, OrderType type, double amount, uint32_t waiterPosition, const string& items,
+                  const Timestamp& timestamp) {
+        OrderShard& target = shard(branch, timestamp.getDayNumber());
+        target.add(nextOrderId++, type, amount, waiterPosition, target.internItems(items), timestamp.toEpochSeconds());
+    }
+    
+    // Hands out count consecutive order ids for orders added to shards directly
+    int allocateOrderIds(int count) {
+        int first = nextOrderId;
+        nextOrderId += count;
+        return first;
+    }
+    
+    WorkStealingPool& getPool() { return pool; }
+    size_t getBranchCount() const { return branches.size(); }
+    const string& getBranchName(uint32_t branch) const { return branches[branch].name; }
+    const vector<pair<int, string>>& getRoster(uint32_t branch) const { return branches[branch].roster; }
+    int64_t getFirstDay() const { return firstDay; }
+    int64_t getLastDay() const { return lastDay; }
+    
+    size_t getShardCount() const {
+        size_t count = 0;
+        for (const Branch& branch : branches) {
+            count += branch.days.size();
+        }
+        return count;
+    }
+    
+    size_t getOrderCount() const {
+        size_t count = 0;
+        for (const Branch& branch : branches) {
+            for (const auto& day : branch.days) {
+                count += day.second->getOrders().size();
+            }
+        }
+        return count;
+    }
+    
+    // Sales per branch over days fromDay to toDay (day numbers, inclusive)
+    void scanSales(int64_t fromDay, int64_t toDay, vector<BranchSales>& result,
+                   const SalesKernels& kernels = salesKernels()) {
+        result.assign(branches.size(), BranchSales());
+        pool.forEach(branches.size(), [&](size_t b) {
+            const Branch& branch = branches[b];
+            BranchSales& sales = result[b];
+            const size_t waiterCount = branch.roster.size();
+            sales.typeCounts[0] = sales.typeCounts[1] = 0;
+            sales.waiterSales.assign(waiterCount, KahanSum());
+            sales.waiterCounts.assign(waiterCount, 0);
+            sales.shards = 0;
+            vector<double> waiterSums(waiterCount);
+            vector<uint64_t> waiterCounts(waiterCount);
+            for (auto it = branch.days.lower_bound(fromDay); it != branch.days.end() && it->first <= toDay; ++it) {
+                const OrderStore& orders = it->second->getOrders();
+                double typeSums[2] = {0.0, 0.0};
+                uint64_t typeCounts[2] = {0, 0};
+                fill(waiterSums.begin(), waiterSums.end(), 0.0);
+                fill(waiterCounts.begin(), waiterCounts.end(), 0);
+                kernels.sumByType(orders.amountData(), orders.typeData(), orders.size(), typeSums, typeCounts);
+                kernels.sumByGroup(orders.amountData(), orders.waiterIdData(), orders.size(), waiterSums.data(),
+                                   waiterCounts.data(), waiterCount);
+                for (int t = 0; t < 2; t++) {
+                    sales.typeSales[t].add(typeSums[t]);
+                    sales.typeCounts[t] += typeCounts[t];
+                }
+                for (size_t w = 0; w < waiterCount; w++) {
+                    sales.waiterSales[w].add(waiterSums[w]);
+                    sales.waiterCounts[w] += waiterCounts[w];
+                }
+                sales.shards++;
+            }
+        });
+    }
+    
+    // Chain-wide variant of Restaurant::reportTotalSales, per branch
+    void reportTotalSales(ReportWriter& out, int64_t fromDay, int64_t toDay) {
+        ScopedTimer timer(METRIC_REPORT_SALES);
+        vector<BranchSales> sales;
+        scanSales(fromDay, toDay, sales);
+        
+        out.newline().text("=== CHAIN TOTAL SALES REPORT ===").newline();
+        out.left("Total sales for each branch, divided into sit-in and take-out sales", 50).newline();
+        writeRange(out, sales, fromDay, toDay);
+        out.rule(80, '-').newline();
+        out.left("Branch", 32).right("Sit-in", 16).right("Take-out", 16).right("Total", 16).newline();
+        out.rule(80, '-').newline();
+        KahanSum chain[2];
+        for (size_t b = 0; b < branches.size(); b++) {
+            double sitIn = sales[b].typeSales[0].value();
+            double takeOut = sales[b].typeSales[1].value();
+            out.left(branches[b].name, 32).text("  R").amount(sitIn, 13).text("  R").amount(takeOut, 13)
+               .text("  R").amount(sitIn + takeOut, 13).newline();
+            chain[0].add(sitIn);
+            chain[1].add(takeOut);
+        }
+        out.rule(80, '-').newline();
+        out.left("Chain Total", 32).text("  R").amount(chain[0].value(), 13).text("  R").amount(chain[1].value(), 13)
+           .text("  R").amount(chain[0].value() + chain[1].value(), 13).newline();
+    }
+    
+    // Sales and commission under Rule per branch over days fromDay to toDay.
+    // The rules are per order, so each shard is one aggregation pass and the
+    // shard results add up.
+    template <typename Rule>
+    void scanCommission(int64_t fromDay, int64_t toDay, vector<BranchSales>& result) {
+        result.assign(branches.size(), BranchSales());
+        pool.forEach(branches.size(), [&](size_t b) {
+            const Branch& branch = branches[b];
+            BranchSales& sales = result[b];
+            const size_t waiterCount = branch.roster.size();
+            sales.typeCounts[0] = sales.typeCounts[1] = 0;
+            sales.waiterSales.assign(waiterCount, KahanSum());
+            sales.waiterCounts.assign(waiterCount, 0);
+            sales.waiterCommission.assign(waiterCount, KahanSum());
+            sales.shards = 0;
+            Aggregate<GroupBy<ByWaiter>, Count, Sum<Amount>, Commission<Rule>> commission;
+            for (auto it = branch.days.lower_bound(fromDay); it != branch.days.end() && it->first <= toDay; ++it) {
+                const OrderStore& orders = it->second->getOrders();
+                OrderColumns columns = {orders.amountData(), orders.typeData(), orders.waiterIdData(),
+                                        orders.timestampData(), orders.size(), waiterCount};
+                aggregateOrders(columns, commission);
+                for (size_t w = 0; w < waiterCount; w++) {
+                    sales.waiterSales[w].add(commission.template get<Sum<Amount>>(w));
+                    sales.waiterCounts[w] += commission.template get<Count>(w);
+                    sales.waiterCommission[w].add(commission.template get<Commission<Rule>>(w));
+                }
+                sales.shards++;
+            }
+        });
+    }
+    
+    // Chain-wide variant of Restaurant::reportWaiterCommission. The flat rule
+    // is read from the sales kernels' totals; other rules need the orders.
+    void reportWaiterCommission(ReportWriter& out, int64_t fromDay, int64_t toDay,
+                                CommissionRule rule = CommissionRule::FLAT) {
+        ScopedTimer timer(METRIC_REPORT_COMMISSION);
+        vector<BranchSales> sales;
+        const char* description = FlatCommission::describe();
+        if (rule == CommissionRule::BY_ORDER_TYPE) {
+            scanCommission<OrderTypeCommission>(fromDay, toDay, sales);
+            description = OrderTypeCommission::describe();
+        } else if (rule == CommissionRule::TIERED) {
+            scanCommission<TieredCommission>(fromDay, toDay, sales);
+            description = TieredCommission::describe();
+        } else {
+            scanSales(fromDay, toDay, sales);
+        }
+        
+        out.newline().text("=== CHAIN WAITER COMMISSION REPORT ===").newline();
+        out.text("Commission for each waiter at each branch (").text(description).text(")").newline();
+        writeRange(out, sales, fromDay, toDay);
+        out.rule(80, '-').newline();
+        out.left("ID", 5).left("Waiter Name", 20).right("Total Sales", 15).right("Commission", 15).newline();
+        KahanSum chainSales, chainCommission;
+        for (size_t b = 0; b < branches.size(); b++) {
+            const Branch& branch = branches[b];
+            out.rule(80, '-').newline();
+            out.text(branch.name).newline();
+            for (size_t w = 0; w < branch.roster.size(); w++) {
+                double waiterSales = sales[b].waiterSales[w].value();
+                double commission = rule == CommissionRule::FLAT ? Waiter::commissionOn(waiterSales)
+                                                                 : sales[b].waiterCommission[w].value();
+                out.number(branch.roster[w].first, 5, true)
+                   .left(branch.roster[w].second, 20)
+                   .text("R").amount(waiterSales, 14)
+                   .text("R").amount(commission, 14).newline();
+                chainSales.add(waiterSales);
+                chainCommission.add(commission);
+            }
+        }
+        out.rule(80, '-').newline();
+        double chainTotal = rule == CommissionRule::FLAT ? Waiter::commissionOn(chainSales.value())
+                                                         : chainCommission.value();
+        out.left("Chain Total", 25).text("R").amount(chainSales.value(), 14)
+           .text("R").amount(chainTotal, 14).newline();
+    }
+
+private:
+    void writeRange(ReportWriter& out, const vector<BranchSales>& sales, int64_t fromDay, int64_t toDay) const {
+        size_t shards = 0;
+        for (const BranchSales& branch : sales) {
+            shards += branch.shards;
+        }
+        char date[Timestamp::FORMAT_BUFFER_SIZE];
+        out.text(date, Timestamp::fromEpochSeconds(fromDay * 86400).formatDateTo(date) - date).text(" to ");
+        out.text(date, Timestamp::fromEpochSeconds(toDay * 86400).formatDateTo(date) - date).text(": ");
+        out.number(static_cast<int64_t>(branches.size()), 0).text(" branches, ");
+        out.number(static_cast<int64_t>(shards), 0).text(" branch-days").newline();
+    }
+};
+
+// Simulates config.days days for each of a chain's branches into an empty
+// group. Branch b uses its own seed stream, and every branch-day is one
+// task on the group's pool that fills its own shard; order ids follow
+// branch and day order, so the group is identical for any thread count.
+void runChainSimulation(RestaurantGroup& group, const SimulationConfig& config, int branchCount) {
+    static const char* const CITIES[] = {"Johannesburg", "Cape Town", "Durban", "Pretoria", "Gqeberha",
+                                         "Bloemfontein", "East London", "Polokwane", "Mbombela", "Kimberley"};
+    const size_t cityCount = sizeof(CITIES) / sizeof(CITIES[0]);
+    const size_t days = static_cast<size_t>(config.days);
+    const size_t tasks = static_cast<size_t>(branchCount) * days;
+    vector<OrderShard*> shards(tasks);
+    for (int b = 0; b < branchCount; b++) {
+        string name = string("Mama's Kitchen - ") + CITIES[b % cityCount];
+        if (b >= static_cast<int>(cityCount)) {
+            name += " " + to_string(b / cityCount + 1);
+        }
+        uint32_t branch = group.addBranch(name);
+        for (int i = 1; i <= config.waiters; i++) {
+            group.addWaiter(branch, i, simulationName(static_cast<uint32_t>(b * 1009 + i * 37 + 5)));
+        }
+        int64_t firstDay = Timestamp::daysFromCivil(config.startYear, config.startMonth, config.startDay);
+        for (size_t d = 0; d < days; d++) {
+            shards[b * days + d] = &group.shard(branch, firstDay + static_cast<int64_t>(d));
+        }
+    }
+    
+    vector<SimulatedDay> simulated(tasks);
+    group.getPool().forEach(tasks, [&](size_t task) {
+        SimulationConfig branchConfig = config;
+        branchConfig.seed = SimulationRandom::streamSeed(config.seed, task / days);
+        DaySimulation(branchConfig, static_cast<int>(task % days), simulated[task]).run();
+    });
+    vector<int> firstIds(tasks);
+    for (size_t task = 0; task < tasks; task++) {
+        firstIds[task] = group.allocateOrderIds(static_cast<int>(simulated[task].orders.size()));
+    }
+    group.getPool().forEach(tasks, [&](size_t task) {
+        SimulatedDay& day = simulated[task];
+        OrderShard& shard = *shards[task];
+        shard.reserve(day.orders.size());
+        string items;
+        for (size_t i = 0; i < day.orders.size(); i++) {
+            const SimulatedOrder& order = day.orders[i];
+            items.assign(day.items, order.itemsOffset, order.itemsLength);
+            shard.add(firstIds[task] + static_cast<int>(i), static_cast<OrderType>(order.orderType), order.amount,
+                      order.waiter, shard.internItems(items), order.timestamp);
+        }
+        vector<SimulatedOrder>().swap(day.orders);
+        string().swap(day.items);
+    });
+}
+
+// Function to create sample data for demonstration
+void createSampleData(Restaurant& restaurant) {
+    // Create waiters with South African names
+    auto waiter1 = make_shared<Waiter>(1, "Sipho Ndlovu");
+    auto waiter2 = make_shared<Waiter>(2, "Thandi Maseko");
+    auto waiter3 = make_shared<Waiter>(3, "Lungile Zulu");
+    
+    restaurant.addWaiter(waiter1);
+    restaurant.addWaiter(waiter2);
+    restaurant.addWaiter(waiter3);
+    
+    // Create patrons with South African names
+    auto patron1 = make_shared<Patron>("Nokuthula Dlamini", PatronType::INDIVIDUAL, 1, true);
+    auto patron2 = make_shared<Patron>("Themba Nkosi", PatronType::GROUP, 4, true);
+    auto patron3 = make_shared<Patron>("Zanele Mbatha", PatronType::INDIVIDUAL, 1, false);
+    auto patron4 = make_shared<Patron>("Mandla Cele", PatronType::GROUP, 6, true);
+    auto patron5 = make_shared<Patron>("Lerato Molefe", PatronType::INDIVIDUAL, 1, false);
+    auto patron6 = make_shared<Patron>("Kagiso Mokoena", PatronType::GROUP, 3, true);
+    auto patron7 = make_shared<Patron>("Amahle Ngcobo", PatronType::INDIVIDUAL, 1, true);
+    auto patron8 = make_shared<Patron>("Sibusiso Khumalo", PatronType::GROUP, 5, true);
+    
+    // Add orders with realistic South African prices in Rands and simulated timestamps
+    restaurant.addOrder(patron1, OrderType::SIT_IN, 125.50, waiter1, "Burger, Chips, Coke", Timestamp(2024, 12, 15, 12, 30, 15));
+    restaurant.addOrder(patron2, OrderType::SIT_IN, 489.75, waiter2, "4x Pasta, 4x Wine, 2x Dessert", Timestamp(2024, 12, 15, 13, 15, 42));
+    restaurant.addOrder(patron3, OrderType::TAKE_OUT, 118.25, waiter1, "Pizza Slice, Soda", Timestamp(2024, 12, 15, 13, 45, 23));
+    restaurant.addOrder(patron4, OrderType::SIT_IN, 856.40, waiter3, "6x Steak, 6x Beer, 3x Appetizer", Timestamp(2024, 12, 15, 14, 20, 8));
+    restaurant.addOrder(patron5, OrderType::TAKE_OUT, 232.80, waiter2, "2x Sandwich, Chips, Coffee", Timestamp(2024, 12, 15, 15, 5, 37));
+    restaurant.addOrder(patron6, OrderType::SIT_IN, 367.90, waiter1, "3x Fish, 3x Wine, Salad", Timestamp(2024, 12, 15, 16, 12, 55));
+    restaurant.addOrder(patron7, OrderType::SIT_IN, 242.15, waiter3, "Salmon, Rice, Tea", Timestamp(2024, 12, 15, 17, 30, 12));
+    restaurant.addOrder(patron8, OrderType::SIT_IN, 734.60, waiter2, "5x Chicken, 5x Beer, 2x Dessert", Timestamp(2024, 12, 15, 18, 45, 29));
+    restaurant.addOrder(patron1, OrderType::TAKE_OUT, 128.45, waiter1, "Salad, Soup, Bread", Timestamp(2024, 12, 15, 19, 15, 44));
+    restaurant.addOrder(patron3, OrderType::SIT_IN, 355.30, waiter3, "Pasta, Wine, Tiramisu", Timestamp(2024, 12, 15, 20, 30, 18));
+}
+
+// Menu system functions
+void displayMainMenu() {
+    cout << "\n" << Rule(60, '=') << endl;
+    cout << "    RESTAURANT SIMULATION MANAGEMENT SYSTEM" << endl;
+    cout << Rule(60, '=') << endl;
+    cout << "1. View All Reports" << endl;
+    cout << "2. View Order Count Report" << endl;
+    cout << "3. View Total Sales Report" << endl;
+    cout << "4. View Waiter Sales Report" << endl;
+    cout << "5. View Waiter Commission Report" << endl;
+    cout << "6. View Detailed Order Report" << endl;
+    cout << "7. Add New Order" << endl;
+    cout << "8. View Restaurant Statistics" << endl;
+    cout << "9. View Orders by Time Range" << endl;
+    cout << "10. Clear Screen" << endl;
+    cout << "11. View Top Patrons" << endl;
+    cout << "12. View Order Value Distribution" << endl;
+    cout << "13. View Sales by Hour" << endl;
+    cout << "14. View Metrics" << endl;
+    cout << "15. Save Snapshot" << endl;
+    cout << "16. View Item Sales" << endl;
+    cout << "0. Exit Program" << endl;
+    cout << Rule(60, '=') << endl;
+    cout << "Enter your choice (0-16): ";
+}
+
+void clearScreen() {
+    #ifdef _WIN32
+        system("cls");
+    #else
+        system("clear");
+    #endif
+}
+
+int getValidChoice() {
+    int choice;
+    while (!(cin >> choice) || choice < 0 || choice > 16) {
+        cout << "Invalid input! Please enter a number between 0 and 16: ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    return choice;
+}
+
+void displayRestaurantStats(const Restaurant& restaurant) {
+    ScopedTimer timer(METRIC_REPORT_STATISTICS);
+    cout << "\n=== RESTAURANT STATISTICS ===" << endl;
+    cout << Rule(50, '-') << endl;
+    cout << "Restaurant Name: " << restaurant.getName() << endl;
+    cout << "Total Waiters: " << restaurant.getWaiters().size() << endl;
+    cout << "Total Orders: " << restaurant.getOrders().size() << endl;
+    
+    cout << "Total Sales: R" << fixed << setprecision(2) << restaurant.getTotalSales() << endl;
+    cout << "Total Commission Paid: R" << fixed << setprecision(2) << restaurant.getTotalCommission() << endl;
+    cout << Rule(50, '-') << endl;
+}
+
+void addNewOrder(Restaurant& restaurant) {
     cout << "\n=== ADD NEW ORDER ===" << endl;
-    cout << string(40, '-') << endl;
+    cout << Rule(40, '-') << endl;
+    
+    // Get patron information
+    string patronName;
+    cout << "Enter patron name: ";
+    cin.ignore();
+    getline(cin, patronName);
+    
+    int patronTypeChoice;
+    cout << "Patron type:\n1. Individual\n2. Group\nEnter choice (1-2): ";
+    cin >> patronTypeChoice;
+    
+    PatronType patronType = (patronTypeChoice == 1) ? PatronType::INDIVIDUAL : PatronType::GROUP;
+    
+    int groupSize = 1;
+    if (patronType == PatronType::GROUP) {
+        cout << "Enter group size: ";
+        cin >> groupSize;
+    }
+    
+    int orderTypeChoice;
+    cout << "Order type:\n1. Sit-in\n2. Take-out\nEnter choice (1-2): ";
+    cin >> orderTypeChoice;
+    
+    OrderType orderType = (orderTypeChoice == 1) ? OrderType::SIT_IN : OrderType::TAKE_OUT;
+    
+    // Select waiter
+    const auto& waiters = restaurant.getWaiters();
+    const size_t waiterCount = restaurant.getWaiterCount();
+    if (waiterCount == 0) {
+        cout << "No waiters on the roster; the order was not added." << endl;
+        return;
+    }
+    cout << "\nAvailable waiters:" << endl;
+    for (const auto& waiter : waiters) {
+        cout << waiter->getWaiterId() << ". " << waiter->getName() << endl;
+    }
+    
+    // Waiters are chosen by id, which need not match their position
+    size_t waiterPosition = waiterCount;
+    cout << "Select waiter ID: ";
+    while (waiterPosition == waiterCount) {
+        int waiterChoice;
+        if (cin >> waiterChoice) {
+            waiterPosition = 0;
+            while (waiterPosition < waiterCount && waiters[waiterPosition]->getWaiterId() != waiterChoice) {
+                waiterPosition++;
+            }
+        } else if (cin.eof()) {
+            return;
+        }
+        if (waiterPosition == waiterCount) {
+            cout << "Invalid input! Please enter one of the waiter IDs listed above: ";
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+    }
+    
+    // Get order details
+    double amount;
+    cout << "Enter order amount (R): ";
+    cin >> amount;
+    
+    string items;
+    cout << "Enter order items: ";
+    cin.ignore();
+    getline(cin, items);
+    
+    // Create patron and add order
+    uint32_t patronId = restaurant.addPatron(patronName, patronType, groupSize, (orderType == OrderType::SIT_IN));
+    restaurant.addOrder(patronId, patronType, groupSize, orderType, amount, static_cast<uint32_t>(waiterPosition),
+                        items, Timestamp());
+    
+    cout << "\n✅ Order added successfully!" << endl;
+    Order order = restaurant.getOrder(restaurant.getOrders().size() - 1);
+    cout << "Order ID: " << order.getOrderId() << endl;
+    cout << "Timestamp: " << order.getTimestamp().toString() << endl;
+}
+
+// Parses "HH", "HH:MM" or a "DD/MM/YYYY" date token; returns false on malformed input
+bool parseTimeOfDay(const string& text, int& seconds, bool endOfRange) {
+    int hour = 0, minute = 0;
+    char extra;
+    int fields = sscanf(text.c_str(), "%d:%d%c", &hour, &minute, &extra);
+    if (fields < 1 || fields > 2 || hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return false;
+    }
+    // An end time covers the whole hour or minute that was entered
+    int slack = endOfRange ? (fields == 1 ? 3599 : 59) : 0;
+    seconds = hour * 3600 + minute * 60 + slack;
+    return true;
+}
+
+bool parseDate(const string& text, int64_t& dayNumber) {
+    int day = 0, month = 0, year = 0;
+    char extra;
+    if (sscanf(text.c_str(), "%d/%d/%d%c", &day, &month, &year, &extra) != 3 ||
+        month < 1 || month > 12 || day < 1 || day > 31) {
+        return false;
+    }
+    dayNumber = Timestamp::daysFromCivil(year, month, day);
+    return true;
+}
+
+// Reads "[DD/MM/YYYY] HH[:MM]"; hasDate is false when only a time of day was given
+bool readTimeRangeBound(const char* prompt, bool endOfRange, bool& hasDate, int64_t& dayNumber, int& seconds) {
+    cout << prompt;
+    string token;
+    cin >> token;
+    hasDate = token.find('/') != string::npos;
+    if (hasDate) {
+        if (!parseDate(token, dayNumber)) {
+            return false;
+        }
+        cin >> token;
+    }
+    return parseTimeOfDay(token, seconds, endOfRange);
+}
+
+void printTimeRangeRows(const Restaurant& restaurant, const OrderRange& range, ReportWriter& out, int& count) {
+    for (Order order : range) {
+        restaurant.writeOrderRow(out, order);
+        count++;
+    }
+}
+
+void displayOrdersByTimeRange(const Restaurant& restaurant) {
+    cout << "\n=== ORDERS BY TIME RANGE ===" << endl;
+    cout << Rule(50, '-') << endl;
+    cout << "Times may be HH, HH:MM or DD/MM/YYYY HH:MM" << endl;
+    
+    bool startHasDate, endHasDate;
+    int64_t startDay = 0, endDay = 0;
+    int startSeconds, endSeconds;
+    if (!readTimeRangeBound("Enter start time: ", false, startHasDate, startDay, startSeconds) ||
+        !readTimeRangeBound("Enter end time: ", true, endHasDate, endDay, endSeconds)) {
+        cout << "Invalid time entered." << endl;
+        cin.clear();
+        return;
+    }
+    
+    const bool dated = startHasDate || endHasDate;
+    if (!startHasDate) {
+        startDay = endDay;
+    }
+    if (!endHasDate) {
+        endDay = startDay;
+    }
+    
+    cout << "\nOrders from ";
+    if (dated) {
+        cout << Timestamp::fromEpochSeconds(startDay * 86400 + startSeconds).toString() << " to "
+             << Timestamp::fromEpochSeconds(endDay * 86400 + endSeconds).toString() << ":" << endl;
+    } else {
+        cout << Timestamp::fromEpochSeconds(startSeconds).toTimeString() << " to "
+             << Timestamp::fromEpochSeconds(endSeconds).toTimeString() << " on every day:" << endl;
+    }
+    
+    ReportWriter out(stdout);
+    Restaurant::writeOrderHeader(out);
+    int count = 0;
+    if (dated) {
+        printTimeRangeRows(restaurant, restaurant.getOrdersBetween(startDay * 86400 + startSeconds,
+                                                                   endDay * 86400 + endSeconds), out, count);
+    } else if (!restaurant.getOrders().empty()) {
+        // Same time-of-day window on every day that has orders; a window whose
+        // end is before its start runs past midnight into the next day
+        int64_t windowLength = endSeconds - startSeconds;
+        if (windowLength < 0) {
+            windowLength += 86400;
+        }
+        int64_t firstDay = restaurant.getFirstOrderTime() / 86400 - (windowLength + startSeconds >= 86400 ? 1 : 0);
+        int64_t lastDay = restaurant.getLastOrderTime() / 86400;
+        for (int64_t day = firstDay; day <= lastDay; day++) {
+            int64_t from = day * 86400 + startSeconds;
+            printTimeRangeRows(restaurant, restaurant.getOrdersBetween(from, from + windowLength), out, count);
+        }
+    }
+    
+    if (count == 0) {
+        out.text("No orders found in the specified time range.").newline();
+    } else {
+        out.rule(120, '-').newline();
+        out.text("Total orders in time range: ").number(count, 0).newline();
+    }
+}
+
+// Keeps a Prometheus text file up to date, for a node exporter textfile
+// collector or a cron job to pick up. Each update writes a temporary file
+// and renames it over the old one, so readers never see a partial dump.
+class MetricsFile {
+private:
+    string path;
+
+public:
+    explicit MetricsFile(const string& p) : path(p) {}
+    
+    ~MetricsFile() { update(); }
+    
+    MetricsFile(const MetricsFile&) = delete;
+    MetricsFile& operator=(const MetricsFile&) = delete;
+    
+    bool update() const {
+        if (path.empty()) {
+            return true;
+        }
+        const string temporary = path + ".tmp";
+        {
+            ReportWriter out(temporary);
+            if (!out.isOpen()) {
+                cerr << "Cannot write metrics to " << temporary << endl;
+                return false;
+            }
+            writeMetrics(out);
+        }
+        #ifdef _WIN32
+            remove(path.c_str());
+        #endif
+        if (rename(temporary.c_str(), path.c_str()) != 0) {
+            cerr << "Cannot write metrics to " << path << endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+// Serves the metrics on a local Unix socket: every connection gets one
+// Prometheus text dump and is closed, e.g. `socat - UNIX-CONNECT:PATH`.
+// The accept loop runs on its own thread and checks for stop() every 200 ms.
+class MetricsServer {
+private:
+    string path;
+    int listener;
+    atomic<bool> serving;
+    thread acceptor;
+    
+    void serve() {
+        #ifndef _WIN32
+            while (serving.load()) {
+                pollfd ready = {listener, POLLIN, 0};
+                if (poll(&ready, 1, 200) <= 0) {
+                    continue;
+                }
+                int client = accept(listener, nullptr, nullptr);
+                if (client < 0) {
+                    continue;
+                }
+                // A client that stops reading is dropped after the timeout
+                // instead of holding up stop(); one that has hung up makes
+                // the write fail with EPIPE, as SIGPIPE is ignored
+                timeval timeout = {1, 0};
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                FILE* stream = fdopen(client, "w");
+                if (!stream) {
+                    ::close(client);
+                    continue;
+                }
+                {
+                    ReportWriter out(stream);
+                    writeMetrics(out);
+                }
+                fclose(stream);
+            }
+        #endif
+    }
+
+public:
+    MetricsServer() : listener(-1), serving(false) {}
+    
+    ~MetricsServer() { stop(); }
+    
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+    
+    bool start(const string& socketPath) {
+        #ifdef _WIN32
+            cerr << "Metrics sockets are not supported on Windows; use --metrics=FILE" << endl;
+            (void)socketPath;
+            return false;
+        #else
+            sockaddr_un address;
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (socketPath.size() >= sizeof(address.sun_path)) {
+                cerr << "Metrics socket path too long: " << socketPath << endl;
+                return false;
+            }
+            memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+            listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listener < 0) {
+                cerr << "Cannot create metrics socket: " << strerror(errno) << endl;
+                return false;
+            }
+            // A socket file left behind by an earlier run would make bind
+            // fail; anything else at the path is not ours to remove
+            struct stat existing;
+            if (lstat(socketPath.c_str(), &existing) == 0) {
+                if (!S_ISSOCK(existing.st_mode)) {
+                    cerr << "Cannot listen on " << socketPath << ": path exists" << endl;
+                    ::close(listener);
+                    listener = -1;
+                    return false;
+                }
+                unlink(socketPath.c_str());
+            }
+            // Clients that hang up mid-dump must not take the process down
+            signal(SIGPIPE, SIG_IGN);
+            if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+                listen(listener, 8) != 0) {
+                cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << endl;
+                ::close(listener);
+                listener = -1;
+                return false;
+            }
+            path = socketPath;
+            serving = true;
+            acceptor = thread(&MetricsServer::serve, this);
+            return true;
+        #endif
+    }
+    
+    void stop() {
+        if (!serving.exchange(false)) {
+            return;
+        }
+        acceptor.join();
+        #ifndef _WIN32
+            ::close(listener);
+            unlink(path.c_str());
+        #endif
+        listener = -1;
+    }
+};
+
+// State the menu actions share with the interactive session in main
+struct MenuSession {
+    const MetricsFile* metricsFile;
+    BackgroundSnapshot* snapshot;
+    string snapshotPath;   // --snapshot, or DEFAULT_SNAPSHOT_PATH
+    bool snapshotPending;  // started, outcome not yet shown
+    
+    MenuSession() : metricsFile(nullptr), snapshot(nullptr), snapshotPending(false) {}
+};
+
+static const char* const DEFAULT_SNAPSHOT_PATH = "restaurant.snapshot";
+
+// Menu choice: turns collection on if it was off, then prints the metrics
+void displayMetrics(const MetricsFile* file) {
+    cout << "\n=== METRICS ===" << endl;
+    if (!Metrics::enabled()) {
+        Metrics::enable();
+        cout << "Metrics collection was off and has been turned on; figures start from now." << endl;
+        cout << "Start with --metrics=FILE or --metrics-socket=PATH to collect from startup." << endl;
+    }
+    cout << Rule(50, '-') << endl;
+    {
+        ReportWriter out(stdout);
+        writeMetrics(out);
+    }
+    if (file) {
+        file->update();
+    }
+}
+
+// Menu choice: starts a background snapshot; main reports how it went
+void saveSnapshotInBackground(const Restaurant& restaurant, MenuSession& session) {
+    cout << "\n=== SAVE SNAPSHOT ===" << endl;
+    if (session.snapshot->isRunning()) {
+        cout << "A snapshot is still being written to " << session.snapshot->getPath() << "." << endl;
+        return;
+    }
+    auto start = chrono::steady_clock::now();
+    if (!session.snapshot->start(restaurant, session.snapshotPath)) {
+        cout << "Cannot start a snapshot to " << session.snapshotPath << "." << endl;
+        return;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    session.snapshotPending = true;
+    cout << "Writing " << restaurant.getOrders().size() << " orders to " << session.snapshotPath
+         << " in the background (menu paused " << fixed << setprecision(1) << ms << " ms)." << endl;
+    cout << "Restore it with --snapshot=" << session.snapshotPath << endl;
+}
+
+void processMenuChoice(int choice, Restaurant& restaurant, MenuSession* session = nullptr) {
+    ScopedTimer timer(Metrics::menuTimer(choice));
+    switch (choice) {
+        case 1:
+            restaurant.generateAllReports();
+            break;
+        case 2:
+            restaurant.reportOrderCounts();
+            break;
+        case 3:
+            restaurant.reportTotalSales();
+            break;
+        case 4:
+            restaurant.reportWaiterSales();
+            break;
+        case 5:
+            restaurant.reportWaiterCommission();
+            break;
+        case 6:
+            restaurant.displayAllOrders();
+            break;
+        case 7:
+            addNewOrder(restaurant);
+            break;
+        case 8:
+            displayRestaurantStats(restaurant);
+            break;
+        case 9:
+            displayOrdersByTimeRange(restaurant);
+            break;
+        case 10:
+            clearScreen();
+            break;
+        case 11:
+            restaurant.reportTopPatrons();
+            break;
+        case 12:
+            restaurant.reportOrderValues();
+            break;
+        case 13:
+            restaurant.reportSalesByHour();
+            break;
+        case 14:
+            displayMetrics(session ? session->metricsFile : nullptr);
+            break;
+        case 15:
+            if (session) {
+                saveSnapshotInBackground(restaurant, *session);
+            }
+            break;
+        case 16:
+            restaurant.reportTopItems();
+            restaurant.reportItemSalesByHour();
+            break;
+        case 0:
+            cout << "\nThank you for using the Restaurant Simulation System!" << endl;
+            cout << "Goodbye! 👋" << endl;
+            break;
+        default:
+            cout << "Invalid choice!" << endl;
+    }
+}
+
+// Command line options; with no options the interactive menu runs
+struct CommandLineOptions {
+    bool exportReports;
+    ReportFormat format;
+    string outputPath;
+    string inspectPath;
+    ReportSelection report;
+    string journalPath;
+    uint64_t journalSegmentBytes;
+    string ingestPath;
+    bool simulate;
+    bool reportChosen;
+    SimulationConfig simulation;
+    vector<int> rosters;      // --waiters, one or more roster sizes
+    size_t replications;      // --replicate
+    int branches;             // --branches: simulate a chain
+    int lastDays;             // --last-days: chain reports cover only these days
+    CommissionRule commissionRule;
+    string metricsPath;
+    string metricsSocket;
+    string snapshotPath;
     
-    // Get patron information
-    string patronName;
-    cout << "Enter patron name: ";
-    cin.ignore();
-    getline(cin, patronName);
+    CommandLineOptions()
+        : exportReports(false), format(ReportFormat::TEXT), report(ReportSelection::ALL),
+          journalSegmentBytes(OrderJournal::DEFAULT_SEGMENT_BYTES), simulate(false), reportChosen(false),
+          replications(0), branches(0), lastDays(0), commissionRule(CommissionRule::FLAT) {}
+};
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options]" << endl;
+    cerr << "  (no options)                 Run the interactive menu" << endl;
+    cerr << "  --format=text|csv|jsonl|bin  Write all reports in the given format and exit" << endl;
+    cerr << "  --output=FILE                Write exported reports to FILE instead of stdout" << endl;
+    cerr << "  --report=NAME                Text report to print and exit: all, summary, counts," << endl;
+    cerr << "                               sales, waiters, commission, orders, patrons, values," << endl;
+    cerr << "                               hours, items or none (default all)" << endl;
+    cerr << "  --commission=RULE            Rule for every commission figure: flat (15%, default)," << endl;
+    cerr << "                               by-type (15% sit-in, 10% take-out) or tiered (by ticket size)" << endl;
+    cerr << "  --ingest=FILE                Add the orders in a CSV or JSON Lines file, then report" << endl;
+    cerr << "  --ingest=-                   Same for a live feed on stdin, through the order pipeline" << endl;
+    cerr << "  --simulate=DAYS              Simulate DAYS days of trading, then report (default summary)" << endl;
+    cerr << "  --replicate=N                Simulate N independent days per roster size and report" << endl;
+    cerr << "                               means with 95% confidence intervals" << endl;
+    cerr << "  --waiters=N[,N...]           Waiters on the simulated roster (default 10); several" << endl;
+    cerr << "                               sizes can be compared with --replicate" << endl;
+    cerr << "  --branches=N                 With --simulate, simulate a chain of N branches and print" << endl;
+    cerr << "                               chain-wide sales and commission reports" << endl;
+    cerr << "  --last-days=N                Chain reports cover only the last N simulated days" << endl;
+    cerr << "  --seed=S                     Random seed for the simulation (default 42)" << endl;
+    cerr << "  --threads=N                  Simulation threads (default: all hardware threads)" << endl;
+    cerr << "  --inspect=FILE               List the columns of a binary report dump or snapshot" << endl;
+    cerr << "  --journal=DIR                Keep orders in an append-only journal in DIR" << endl;
+    cerr << "  --journal-segment-mb=N       Start a new journal segment every N MiB (default 64)" << endl;
+    cerr << "  --snapshot=FILE              Restore from FILE at startup if it exists and save to it" << endl;
+    cerr << "                               on exit (menu option 15 saves in the background)" << endl;
+    cerr << "  --metrics=FILE               Collect metrics and keep FILE updated in Prometheus text" << endl;
+    cerr << "                               format (after each menu action and at exit)" << endl;
+    cerr << "  --metrics-socket=PATH        Collect metrics and serve them on a Unix socket at PATH" << endl;
+    cerr << "  --help                       Show this help message" << endl;
+}
+
+// Accepts both "--name=value" and "--name value"
+bool optionValue(int argc, char* argv[], int& i, const string& name, string& value) {
+    string arg = argv[i];
+    if (arg.compare(0, name.size(), name) != 0) {
+        return false;
+    }
+    if (arg.size() > name.size() && arg[name.size()] == '=') {
+        value = arg.substr(name.size() + 1);
+        return true;
+    }
+    if (arg.size() == name.size() && i + 1 < argc) {
+        value = argv[++i];
+        return true;
+    }
+    return false;
+}
+
+bool positiveOption(const char* name, const string& value, int& result) {
+    char* end;
+    long parsed = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || parsed <= 0 || parsed > 1000000) {
+        cerr << "Invalid " << name << ": " << value << endl;
+        return false;
+    }
+    result = static_cast<int>(parsed);
+    return true;
+}
+
+bool parseCommandLine(int argc, char* argv[], CommandLineOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string value;
+        if (optionValue(argc, argv, i, "--format", value)) {
+            options.exportReports = true;
+            if (value == "text") {
+                options.format = ReportFormat::TEXT;
+            } else if (value == "csv") {
+                options.format = ReportFormat::CSV;
+            } else if (value == "jsonl") {
+                options.format = ReportFormat::JSONL;
+            } else if (value == "bin") {
+                options.format = ReportFormat::BINARY;
+            } else {
+                cerr << "Unknown report format: " << value << endl;
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--report", value)) {
+            options.exportReports = true;
+            const char* const names[] = {"all", "summary", "counts", "sales", "waiters", "commission", "orders",
+                                         "patrons", "values", "hours", "items", "none"};
+            const ReportSelection selections[] = {ReportSelection::ALL, ReportSelection::SUMMARY, ReportSelection::COUNTS,
+                                                  ReportSelection::SALES, ReportSelection::WAITERS,
+                                                  ReportSelection::COMMISSION, ReportSelection::ORDERS,
+                                                  ReportSelection::PATRONS, ReportSelection::VALUES,
+                                                  ReportSelection::HOURS, ReportSelection::ITEMS,
+                                                  ReportSelection::NONE};
+            const size_t count = sizeof(names) / sizeof(names[0]);
+            size_t match = 0;
+            while (match < count && value != names[match]) {
+                match++;
+            }
+            if (match == count) {
+                cerr << "Unknown report: " << value << endl;
+                return false;
+            }
+            options.report = selections[match];
+            options.reportChosen = true;
+        } else if (optionValue(argc, argv, i, "--commission", value)) {
+            if (value == "flat") {
+                options.commissionRule = CommissionRule::FLAT;
+            } else if (value == "by-type") {
+                options.commissionRule = CommissionRule::BY_ORDER_TYPE;
+            } else if (value == "tiered") {
+                options.commissionRule = CommissionRule::TIERED;
+            } else {
+                cerr << "Unknown commission rule: " << value << endl;
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--simulate", value)) {
+            options.simulate = true;
+            if (!positiveOption("--simulate", value, options.simulation.days)) {
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--replicate", value)) {
+            int replications;
+            if (!positiveOption("--replicate", value, replications)) {
+                return false;
+            }
+            options.replications = static_cast<size_t>(replications);
+        } else if (optionValue(argc, argv, i, "--waiters", value)) {
+            options.rosters.clear();
+            size_t begin = 0;
+            while (begin <= value.size()) {
+                size_t comma = value.find(',', begin);
+                if (comma == string::npos) {
+                    comma = value.size();
+                }
+                int waiters;
+                if (!positiveOption("--waiters", value.substr(begin, comma - begin), waiters)) {
+                    return false;
+                }
+                options.rosters.push_back(waiters);
+                begin = comma + 1;
+            }
+            options.simulation.waiters = options.rosters.front();
+        } else if (optionValue(argc, argv, i, "--branches", value)) {
+            if (!positiveOption("--branches", value, options.branches)) {
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--last-days", value)) {
+            if (!positiveOption("--last-days", value, options.lastDays)) {
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--threads", value)) {
+            if (!positiveOption("--threads", value, options.simulation.threads)) {
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--seed", value)) {
+            char* end;
+            options.simulation.seed = strtoull(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0') {
+                cerr << "Invalid --seed: " << value << endl;
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--ingest", value)) {
+            options.ingestPath = value;
+        } else if (optionValue(argc, argv, i, "--output", value)) {
+            options.exportReports = true;
+            options.outputPath = value;
+        } else if (optionValue(argc, argv, i, "--inspect", value)) {
+            options.inspectPath = value;
+        } else if (optionValue(argc, argv, i, "--journal-segment-mb", value)) {
+            long megabytes = strtol(value.c_str(), nullptr, 10);
+            if (megabytes <= 0) {
+                cerr << "Invalid journal segment size: " << value << endl;
+                return false;
+            }
+            options.journalSegmentBytes = static_cast<uint64_t>(megabytes) * 1024 * 1024;
+        } else if (optionValue(argc, argv, i, "--journal", value)) {
+            options.journalPath = value;
+        } else if (optionValue(argc, argv, i, "--snapshot", value)) {
+            options.snapshotPath = value;
+        } else if (optionValue(argc, argv, i, "--metrics-socket", value)) {
+            options.metricsSocket = value;
+        } else if (optionValue(argc, argv, i, "--metrics", value)) {
+            options.metricsPath = value;
+        } else {
+            if (string(argv[i]) != "--help") {
+                cerr << "Unknown option: " << argv[i] << endl;
+            }
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Replays the journal into the restaurant and attaches it for new records
+bool openJournal(Restaurant& restaurant, OrderJournal& journal) {
+    auto start = chrono::steady_clock::now();
+    size_t replayed;
+    if (!journal.open(restaurant, replayed)) {
+        cerr << "Cannot open journal: " << journal.getDirectory() << endl;
+        return false;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    restaurant.attachJournal(&journal);
+    if (restaurant.getWaiterCount() > 0) {
+        cerr << "Replayed " << replayed << " orders from the journal in " << fixed << setprecision(1) << ms << " ms" << endl;
+    }
+    return true;
+}
+
+// Restores the snapshot at path into an empty restaurant; a missing file
+// is not an error, the restaurant just stays empty
+bool restoreSnapshot(Restaurant& restaurant, const string& path) {
+    if (path.empty() || !fileExists(path)) {
+        return true;
+    }
+    auto start = chrono::steady_clock::now();
+    string error;
+    if (!RestaurantSnapshot::restore(restaurant, path, error)) {
+        cerr << "Cannot restore snapshot " << path << ": " << error << endl;
+        return false;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cerr << "Restored " << restaurant.getOrders().size() << " orders from " << path << " in " << fixed
+         << setprecision(1) << ms << " ms" << endl;
+    return true;
+}
+
+bool saveSnapshot(const Restaurant& restaurant, const string& path) {
+    if (path.empty()) {
+        return true;
+    }
+    auto start = chrono::steady_clock::now();
+    if (!RestaurantSnapshot::save(restaurant, path)) {
+        cerr << "Cannot save snapshot " << path << endl;
+        return false;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cerr << "Saved " << restaurant.getOrders().size() << " orders to " << path << " in " << fixed << setprecision(1)
+         << ms << " ms" << endl;
+    return true;
+}
+
+// Replays the journal or restores the snapshot if one is given and holds
+// data; otherwise loads the sample data, which goes into the journal when
+// one is attached
+bool loadRestaurant(Restaurant& restaurant, OrderJournal* journal, const string& snapshotPath) {
+    if (journal && !openJournal(restaurant, *journal)) {
+        return false;
+    }
+    if (!restoreSnapshot(restaurant, snapshotPath)) {
+        return false;
+    }
+    if (restaurant.getWaiterCount() == 0) {
+        createSampleData(restaurant);
+        if (journal && !journal->commit()) {
+            cerr << "Journal write failed in " << journal->getDirectory() << ": " << journal->getErrorText() << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void writeSelectedReports(const Restaurant& restaurant, const CommandLineOptions& options, ReportWriter& out) {
+    if (options.format == ReportFormat::TEXT) {
+        writeTextReport(restaurant, options.report, out);
+    } else {
+        exportReports(restaurant, options.format, out);
+    }
+}
+
+int runExport(const Restaurant& restaurant, const CommandLineOptions& options) {
+    if (options.outputPath.empty()) {
+        ReportWriter out(stdout);
+        writeSelectedReports(restaurant, options, out);
+        return 0;
+    }
+    ReportWriter out(options.outputPath);
+    if (!out.isOpen()) {
+        cerr << "Cannot open output file: " << options.outputPath << endl;
+        return 1;
+    }
+    writeSelectedReports(restaurant, options, out);
+    return 0;
+}
+
+// Headless bulk load: the restaurant starts empty (or from the journal),
+// takes every order in the file and prints the requested reports
+int runIngest(const CommandLineOptions& options, OrderJournal* journal) {
+    Restaurant restaurant("Mama's Kitchen - Johannesburg");
+    restaurant.setCommissionRule(options.commissionRule);
+    if ((journal && !openJournal(restaurant, *journal)) || !restoreSnapshot(restaurant, options.snapshotPath)) {
+        return 1;
+    }
+    
+    size_t ordersBefore = restaurant.getOrders().size();
+    auto start = chrono::steady_clock::now();
+    IngestResult result;
+    bool feed = options.ingestPath == "-";
+    if (!(feed ? ingestFeed(restaurant, stdin, journal, result) : ingestOrders(restaurant, options.ingestPath, result))) {
+        return 1;
+    }
+    if (journal && !journal->commit()) {
+        cerr << "Journal write failed in " << journal->getDirectory() << ": " << journal->getErrorText() << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    size_t added = restaurant.getOrders().size() - ordersBefore;
+    cerr << "Ingested " << added << " orders from " << (feed ? "stdin" : options.ingestPath) << " in " << fixed << setprecision(1)
+         << seconds * 1000.0 << " ms (" << setprecision(0) << (seconds > 0 ? added / seconds : 0.0) << " orders/s)";
+    if (result.skipped > 0) {
+        cerr << ", " << result.skipped << " rows skipped";
+    }
+    cerr << endl;
+    
+    if (!saveSnapshot(restaurant, options.snapshotPath)) {
+        return 1;
+    }
+    return runExport(restaurant, options);
+}
+
+// Staffing study: replications of one simulated day for each roster size
+int runReplicationReport(const CommandLineOptions& options) {
+    ReplicationStudy study;
+    study.rosters = options.rosters.empty() ? vector<int>(1, options.simulation.waiters) : options.rosters;
+    study.replications = options.replications;
+    study.config = options.simulation;
+    study.commissionRule = options.commissionRule;
+    study.config.tables = study.rosters.front() * study.config.tablesPerWaiter;
+    study.config.demandScale = study.rosters.front();
+    runReplications(study, options.simulation.threads);
+    
+    size_t runs = study.rosters.size() * study.replications;
+    cerr << "Ran " << runs << " replications on " << study.threads << " threads in " << fixed << setprecision(1)
+         << study.seconds * 1000.0 << " ms (" << setprecision(0) << runs / max(study.seconds, 1e-9)
+         << " replications/s)" << endl;
+    
+    if (options.outputPath.empty()) {
+        ReportWriter out(stdout);
+        reportReplications(study, out);
+        return 0;
+    }
+    ReportWriter out(options.outputPath);
+    if (!out.isOpen()) {
+        cerr << "Cannot open output file: " << options.outputPath << endl;
+        return 1;
+    }
+    reportReplications(study, out);
+    return 0;
+}
+
+// Headless simulation: builds the restaurant from simulated trading days
+int runSimulationReports(CommandLineOptions options) {
+    if (!options.reportChosen) {
+        options.report = ReportSelection::SUMMARY;
+    }
+    Restaurant restaurant("Mama's Kitchen - Johannesburg");
+    restaurant.setCommissionRule(options.commissionRule);
+    if (!restoreSnapshot(restaurant, options.snapshotPath)) {
+        return 1;
+    }
+    SimulationSummary summary;
+    runSimulation(restaurant, options.simulation, summary);
+    
+    cerr << "Simulated " << options.simulation.days << " days with " << options.simulation.waiters << " waiters on "
+         << summary.threads << " threads: " << summary.events << " events, " << summary.orders << " orders" << endl;
+    cerr << fixed << setprecision(1) << "  Event loop " << summary.simulateSeconds * 1000.0 << " ms ("
+         << setprecision(0) << summary.events / max(summary.simulateSeconds, 1e-9) << " events/s), total "
+         << setprecision(1) << summary.totalSeconds * 1000.0 << " ms" << endl;
+    cerr << "  " << summary.parties << " parties: " << summary.seated << " seated (mean wait "
+         << (summary.seated ? summary.tableWaitMinutes / summary.seated : 0.0) << " min), " << summary.takeOuts
+         << " take-out (mean queue " << (summary.takeOuts ? summary.takeOutWaitMinutes / summary.takeOuts : 0.0)
+         << " min), " << summary.abandoned << " left before a table was free" << endl;
+    
+    if (!saveSnapshot(restaurant, options.snapshotPath)) {
+        return 1;
+    }
+    return runExport(restaurant, options);
+}
+
+// Headless chain simulation (--branches): sales and commission across all
+// branches, over every simulated day or the last --last-days of them
+int runChainReports(const CommandLineOptions& options) {
+    if (options.exportReports && options.format != ReportFormat::TEXT) {
+        cerr << "Chain reports are only available as text" << endl;
+        return 1;
+    }
+    bool sales = true, commission = true;
+    if (options.reportChosen) {
+        sales = options.report == ReportSelection::ALL || options.report == ReportSelection::SUMMARY ||
+                options.report == ReportSelection::SALES;
+        commission = options.report == ReportSelection::ALL || options.report == ReportSelection::SUMMARY ||
+                     options.report == ReportSelection::COMMISSION;
+        if (!sales && !commission && options.report != ReportSelection::NONE) {
+            cerr << "Chain reports: choose all, summary, sales, commission or none" << endl;
+            return 1;
+        }
+    }
+    
+    auto start = chrono::steady_clock::now();
+    RestaurantGroup group(options.simulation.threads);
+    runChainSimulation(group, options.simulation, options.branches);
+    double simulateSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "Simulated " << options.simulation.days << " days at " << options.branches << " branches with "
+         << options.simulation.waiters << " waiters each on " << group.getPool().size() << " threads: "
+         << group.getShardCount() << " branch-days, " << group.getOrderCount() << " orders in " << fixed
+         << setprecision(1) << simulateSeconds * 1000.0 << " ms" << endl;
+    
+    const int64_t toDay = group.getLastDay();
+    const int64_t fromDay = options.lastDays > 0 ? max(group.getFirstDay(), toDay - options.lastDays + 1)
+                                                 : group.getFirstDay();
+    unique_ptr<ReportWriter> file;
+    if (!options.outputPath.empty()) {
+        file.reset(new ReportWriter(options.outputPath));
+        if (!file->isOpen()) {
+            cerr << "Cannot open output file: " << options.outputPath << endl;
+            return 1;
+        }
+    }
+    ReportWriter console(stdout);
+    ReportWriter& out = file ? *file : console;
+    start = chrono::steady_clock::now();
+    if (sales) {
+        group.reportTotalSales(out, fromDay, toDay);
+    }
+    if (commission) {
+        group.reportWaiterCommission(out, fromDay, toDay, options.commissionRule);
+    }
+    out.flush();
+    cerr << "Reports over " << toDay - fromDay + 1 << " days in " << fixed << setprecision(1)
+         << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+    return 0;
+}
+
+int inspectColumnarDump(const string& path) {
+    ColumnarDump dump;
+    if (!dump.open(path) && !dump.open(path, SNAPSHOT_MAGIC, SNAPSHOT_VERSION)) {
+        cerr << "Not a valid binary report dump or snapshot: " << path << endl;
+        return 1;
+    }
+    cout << setw(24) << left << "Column" << setw(10) << right << "Bytes/el" << setw(14) << right << "Elements" << endl;
+    cout << Rule(48, '-') << endl;
+    for (const auto& column : dump.getColumns()) {
+        cout << setw(24) << left << column.name << setw(10) << right << column.elementSize
+             << setw(14) << right << column.count() << endl;
+    }
+    
+    size_t count;
+    const double* amounts = dump.values<double>("order.amount", count);
+    KahanSum total;
+    for (size_t i = 0; i < count; i++) {
+        total.add(amounts[i]);
+    }
+    cout << Rule(48, '-') << endl;
+    cout << "Orders: " << count << ", total sales: R" << fixed << setprecision(2) << total.value() << endl;
+    return 0;
+}
+
+#ifdef RESTAURANT_BENCH
+// Benchmark build (make bench): times the reports and counts heap allocations
+
+static atomic<size_t> benchAllocations(0); // terminals allocate from several threads
+
+void* operator new(size_t size) {
+    benchAllocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+// GCC 11+ cannot see that operator new above also uses malloc
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+    free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// Stream buffer that discards everything written to it
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+// Size and seed of a synthetic workload
+struct BenchWorkload {
+    size_t orders;
+    int waiters;
+    int patrons;
+    int days;
+    uint64_t seed;
+    
+    BenchWorkload() : orders(100000), waiters(20), patrons(5000), days(7), seed(42) {}
+};
+
+// Seeded synthetic workload. Every field of order i is a hash of (seed, i),
+// so any slice of a workload from 1K to 100M orders can be regenerated
+// without storing it, and the same seed always gives the same orders.
+// Orders are spread evenly over the days from 15 December 2024.
+class WorkloadGenerator {
+private:
+    BenchWorkload workload;
+    int64_t start;
+    
+    static const string MENU[4];
+    
+    uint64_t patronBits(uint32_t patron) const {
+        return SimulationRandom::streamSeed(workload.seed ^ 0x5041545230ULL, patron);
+    }
+    
+    // Uniform in [0, n) from the high half of a hash
+    static uint32_t scale(uint64_t bits, uint32_t n) {
+        return static_cast<uint32_t>((bits >> 32) * n >> 32);
+    }
+
+public:
+    struct GeneratedOrder {
+        uint32_t patron;   // index into the generated patrons
+        uint32_t waiter;   // index into the generated waiters
+        OrderType type;
+        double amount;
+        int64_t timestamp;
+        const string* items;
+    };
+    
+    explicit WorkloadGenerator(const BenchWorkload& workload)
+        : workload(workload), start(Timestamp(2024, 12, 15, 0, 0, 0).toEpochSeconds()) {}
+    
+    const BenchWorkload& getWorkload() const { return workload; }
+    int64_t getStart() const { return start; }
+    
+    // A third of the patrons are groups of 2-7; three in four sit in
+    void patron(uint32_t index, PatronType& type, int& groupSize, bool& sitIn) const {
+        uint64_t bits = patronBits(index);
+        bool group = bits % 3 == 0;
+        type = group ? PatronType::GROUP : PatronType::INDIVIDUAL;
+        groupSize = group ? 2 + static_cast<int>((bits >> 8) % 6) : 1;
+        sitIn = (bits >> 16) % 4 != 0;
+    }
+    
+    void order(size_t index, GeneratedOrder& out) const {
+        uint64_t bits = SimulationRandom::streamSeed(workload.seed, index);
+        out.patron = scale(bits, static_cast<uint32_t>(workload.patrons));
+        out.waiter = scale(bits << 32, static_cast<uint32_t>(workload.waiters));
+        out.type = (patronBits(out.patron) >> 16) % 4 != 0 ? OrderType::SIT_IN : OrderType::TAKE_OUT;
+        out.amount = static_cast<double>(5000 + (bits >> 8) % 80000) / 100.0;
+        out.timestamp = start + static_cast<int64_t>(static_cast<double>(index) * workload.days * 86400 /
+                                                     static_cast<double>(workload.orders));
+        out.items = &MENU[(bits >> 4) & 3];
+    }
+};
+
+const string WorkloadGenerator::MENU[4] = {"Burger, Chips, Coke", "2x Pasta, 2x Wine", "Pizza Slice, Soda",
+                                           "Salmon, Rice, Tea"};
+
+// Fills a restaurant with a synthetic workload: waiters "Waiter 1".."Waiter N",
+// patrons "Patron 1".."Patron M" in the PatronStore, then every order
+void createBenchData(Restaurant& restaurant, const BenchWorkload& workload) {
+    WorkloadGenerator generator(workload);
+    uint32_t firstWaiter = static_cast<uint32_t>(restaurant.getWaiters().size());
+    for (int i = 1; i <= workload.waiters; i++) {
+        restaurant.addWaiter(make_shared<Waiter>(i, "Waiter " + to_string(i)));
+    }
+    vector<uint32_t> patronIds;
+    patronIds.reserve(static_cast<size_t>(workload.patrons));
+    restaurant.reservePatrons(static_cast<size_t>(workload.patrons));
+    for (int i = 0; i < workload.patrons; i++) {
+        PatronType type;
+        int groupSize;
+        bool sitIn;
+        generator.patron(static_cast<uint32_t>(i), type, groupSize, sitIn);
+        patronIds.push_back(restaurant.addPatron("Patron " + to_string(i + 1), type, groupSize, sitIn));
+    }
+    restaurant.reserveOrders(workload.orders);
+    WorkloadGenerator::GeneratedOrder order;
+    for (size_t i = 0; i < workload.orders; i++) {
+        generator.order(i, order);
+        restaurant.addOrder(patronIds[order.patron], order.type, order.amount, firstWaiter + order.waiter,
+                            *order.items, Timestamp::fromEpochSeconds(order.timestamp));
+    }
+}
+
+// The iostream renderer displayAllOrders used before ReportWriter, kept for comparison
+void displayAllOrdersIostream(const Restaurant& restaurant, ostream& os) {
+    os << "\n=== DETAILED ORDER REPORT ===" << endl;
+    for (size_t row = 0; row < restaurant.getOrders().size(); row++) {
+        Order order = restaurant.getOrder(row);
+        PatronRef patron = restaurant.getPatron(order.getPatronId());
+        os << setw(8) << left << order.getOrderId()
+           << setw(20) << left << patron.getName()
+           << setw(15) << left << order.getPartyTypeString()
+           << setw(15) << left << order.getTypeString()
+           << setw(20) << left << restaurant.getWaiterAt(order.getWaiterId()).getName()
+           << setw(20) << left << order.getTimestamp().toString()
+           << "R" << setw(14) << right << fixed << setprecision(2) << order.getTotalAmount() << endl;
+    }
+}
+
+static const char* const BENCH_JOURNAL = "restaurant_bench_journal";
+static const char* const BENCH_ORDERS_CSV = "restaurant_bench_orders.csv";
+static const char* const BENCH_SNAPSHOT = "restaurant_bench.snapshot";
+
+#ifdef _WIN32
+static const char* const NULL_DEVICE = "NUL";
+#else
+static const char* const NULL_DEVICE = "/dev/null";
+#endif
+
+// One benchmark's timings: per-call microseconds over the timed samples
+struct BenchResult {
+    string name;
+    string unit;
+    double median;
+    double mad;             // median absolute deviation from the median
+    double min;
+    double max;
+    int samples;
+    size_t callsPerSample;
+    double allocations;     // heap allocations per call, or -1 when not counted
+};
+
+struct BenchOptions {
+    BenchWorkload workload;
+    int warmup;             // untimed samples after calibration
+    int repetitions;        // timed samples per benchmark
+    double minSampleMs;     // calls per sample are doubled until one sample takes this long
+    size_t kernelOrders;
+    string jsonPath;
+    vector<string> sections;  // empty runs every section
+    
+    BenchOptions() : warmup(2), repetitions(15), minSampleMs(2.0), kernelOrders(100000000) {}
+    
+    bool runs(const char* section) const {
+        return sections.empty() || find(sections.begin(), sections.end(), section) != sections.end();
+    }
+};
+
+// Microbenchmark harness. Each benchmark is calibrated (calls per sample
+// doubled until a sample takes minSampleMs, which also warms caches and
+// the allocator), run for the warmup samples, then timed over the given
+// number of samples. The median and the median absolute deviation are
+// reported rather than the mean, so one preempted sample cannot move the
+// result. Console output is discarded while a benchmark runs.
+class BenchSuite {
+private:
+    const BenchOptions& options;
+    vector<BenchResult> results;
+    vector<pair<string, bool>> checks;
+    
+    static double median(vector<double> values) {
+        size_t middle = values.size() / 2;
+        nth_element(values.begin(), values.begin() + middle, values.end());
+        double upper = values[middle];
+        if (values.size() % 2) {
+            return upper;
+        }
+        return (*max_element(values.begin(), values.begin() + middle) + upper) / 2;
+    }
+    
+    void print(const BenchResult& result) const {
+        cout << setw(32) << left << result.name << setw(14) << right << fixed << setprecision(3) << result.median
+             << setw(12) << right << result.mad;
+        if (result.allocations >= 0) {
+            cout << setw(14) << right << setprecision(2) << result.allocations;
+        }
+        cout << endl;
+    }
+
+public:
+    explicit BenchSuite(const BenchOptions& options) : options(options) {}
+    
+    void printHeader() const {
+        cout << setw(32) << left << "Benchmark" << setw(14) << right << "median us" << setw(12) << right << "MAD us"
+             << setw(14) << right << "allocs/call" << endl;
+        cout << Rule(72, '-') << endl;
+    }
+    
+    // Times body() and reports per-item figures, for bodies that process
+    // `items` orders per call
+    template <typename Body>
+    void run(const string& name, Body body, size_t items = 1) {
+        NullBuffer null;
+        streambuf* console = cout.rdbuf(&null);
+        typedef chrono::steady_clock Clock;
+        auto timeCalls = [&body](size_t calls) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < calls; i++) {
+                body();
+            }
+            return chrono::duration<double, micro>(Clock::now() - start).count();
+        };
+        size_t calls = 1;
+        while (timeCalls(calls) < options.minSampleMs * 1000 && calls < (size_t(1) << 30)) {
+            calls *= 2;
+        }
+        for (int i = 0; i < options.warmup; i++) {
+            timeCalls(calls);
+        }
+        vector<double> samples;
+        samples.reserve(static_cast<size_t>(options.repetitions));
+        size_t allocationsBefore = benchAllocations;
+        for (int i = 0; i < options.repetitions; i++) {
+            samples.push_back(timeCalls(calls) / static_cast<double>(calls * items));
+        }
+        size_t allocations = benchAllocations - allocationsBefore;
+        cout.rdbuf(console);
+        
+        BenchResult result;
+        result.name = name;
+        result.unit = "us";
+        result.median = median(samples);
+        vector<double> deviations;
+        for (double sample : samples) {
+            deviations.push_back(fabs(sample - result.median));
+        }
+        result.mad = median(deviations);
+        result.min = *min_element(samples.begin(), samples.end());
+        result.max = *max_element(samples.begin(), samples.end());
+        result.samples = options.repetitions;
+        result.callsPerSample = calls;
+        result.allocations = static_cast<double>(allocations) /
+                             static_cast<double>(static_cast<size_t>(options.repetitions) * calls * items);
+        results.push_back(result);
+        print(result);
+    }
+    
+    // A figure measured by the benchmark itself, such as GB/s or orders/s
+    void record(const string& name, const string& unit, double value) {
+        BenchResult result;
+        result.name = name;
+        result.unit = unit;
+        result.median = result.min = result.max = value;
+        result.mad = 0.0;
+        result.samples = 1;
+        result.callsPerSample = 1;
+        result.allocations = -1;
+        results.push_back(result);
+    }
+    
+    void check(const string& name, bool passed) { checks.push_back(make_pair(name, passed)); }
+    
+    bool passed() const {
+        for (const auto& entry : checks) {
+            if (!entry.second) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Results as one JSON document, for comparing runs between versions
+    bool writeJson(const string& path) const {
+        ReportWriter out(path);
+        if (!out.isOpen()) {
+            return false;
+        }
+        char number[64];
+        auto real = [&out, &number](double value) -> ReportWriter& {
+            snprintf(number, sizeof(number), "%.6g", value);
+            return out.text(number);
+        };
+        const BenchWorkload& workload = options.workload;
+        out.text("{\"schema\":1,\"program\":\"restaurant_simulation\",\"compiler\":").jsonString(__VERSION__);
+        out.text(",\"kernels\":").jsonString(salesKernels().name);
+        out.text(",\"workload\":{\"orders\":").number(static_cast<int64_t>(workload.orders), 0);
+        out.text(",\"waiters\":").number(workload.waiters, 0);
+        out.text(",\"patrons\":").number(workload.patrons, 0);
+        out.text(",\"days\":").number(workload.days, 0);
+        out.text(",\"seed\":").text(to_string(workload.seed));
+        out.text("},\"warmup\":").number(options.warmup, 0);
+        out.text(",\"repetitions\":").number(options.repetitions, 0);
+        out.text(",\"results\":[");
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& result = results[i];
+            out.text(i ? ",\n{" : "\n{").text("\"name\":").jsonString(result.name);
+            out.text(",\"unit\":").jsonString(result.unit);
+            out.text(",\"median\":");
+            real(result.median).text(",\"mad\":");
+            real(result.mad).text(",\"min\":");
+            real(result.min).text(",\"max\":");
+            real(result.max).text(",\"samples\":").number(result.samples, 0);
+            out.text(",\"calls_per_sample\":").number(static_cast<int64_t>(result.callsPerSample), 0);
+            if (result.allocations >= 0) {
+                out.text(",\"allocs_per_call\":");
+                real(result.allocations);
+            }
+            out.text("}");
+        }
+        out.text("],\"checks\":{");
+        for (size_t i = 0; i < checks.size(); i++) {
+            out.text(i ? "," : "").jsonString(checks[i].first).text(checks[i].second ? ":true" : ":false");
+        }
+        out.text("}}").newline();
+        return true;
+    }
+};
+
+// Heap allocations per order over two trading days of the same orders, with
+// closeDay() in between: once through the shared_ptr<Patron> interface (a
+// heap patron per order, as the interactive menu used to do) and once through
+// the CSV ingester, which resolves patrons in the restaurant's PatronStore
+void benchDayAllocations(const Restaurant& source, BenchSuite& suite) {
+    const OrderStore& orders = source.getOrders();
+    {
+        ReportWriter csv(BENCH_ORDERS_CSV);
+        exportCsv(source, csv);
+    }
+    cout << setw(28) << left << "Path" << setw(14) << right << "day 1" << setw(18) << right << "day 2" << endl;
+    cout << Rule(72, '-') << endl;
+    
+    Restaurant legacy("Legacy Kitchen");
+    for (const auto& waiter : source.getWaiters()) {
+        legacy.addWaiter(make_shared<Waiter>(waiter->getWaiterId(), waiter->getName()));
+    }
+    double legacyPerOrder[2];
+    for (int day = 0; day < 2; day++) {
+        size_t allocationsBefore = benchAllocations;
+        for (size_t row = 0; row < orders.size(); row++) {
+            Order order(orders, row);
+            PatronRef patron = source.getPatron(order.getPatronId());
+            legacy.addOrder(make_shared<Patron>(patron.getName().str(), patron.getType(), patron.getGroupSize(),
+                                                patron.isSitInOrder()),
+                            order.getType(), order.getTotalAmount(), legacy.getWaiters()[order.getWaiterId()],
+                            order.getItems().str(), order.getTimestamp());
+        }
+        legacyPerOrder[day] = static_cast<double>(benchAllocations - allocationsBefore) / orders.size();
+        legacy.closeDay();
+    }
+    cout << setw(28) << left << "make_shared<Patron>" << setw(14) << right << fixed << setprecision(3)
+         << legacyPerOrder[0] << setw(18) << right << legacyPerOrder[1] << endl;
+    suite.record("allocations/make_shared<Patron> day 2", "allocs/order", legacyPerOrder[1]);
+    
+    Restaurant ingested("Ingest Kitchen");
+    double ingestPerOrder[2];
+    for (int day = 0; day < 2; day++) {
+        IngestResult result;
+        size_t allocationsBefore = benchAllocations;
+        ingestOrders(ingested, BENCH_ORDERS_CSV, result);
+        ingestPerOrder[day] = static_cast<double>(benchAllocations - allocationsBefore) / result.rows;
+        ingested.closeDay();
+    }
+    cout << setw(28) << left << "ingest (PatronStore)" << setw(14) << right << fixed << setprecision(3)
+         << ingestPerOrder[0] << setw(18) << right << ingestPerOrder[1] << endl;
+    suite.record("allocations/ingest day 2", "allocs/order", ingestPerOrder[1]);
+    remove(BENCH_ORDERS_CSV);
+}
+
+// Runs every kernel set this CPU supports over orderCount synthetic orders
+// (20 waiters, two years of timestamps), reports GB/s per kernel and checks
+// each against the scalar kernels: counts must match exactly, sums to a
+// relative 1e-12. Hour bucketing is also checked against Timestamp::getHour
+// on edge cases, including times before 1970.
+bool benchSalesKernels(size_t orderCount, uint64_t seed, BenchSuite& suite) {
+    vector<double> amounts(orderCount);
+    vector<uint8_t> types(orderCount);
+    vector<uint32_t> waiters(orderCount);
+    vector<int64_t> timestamps(orderCount);
+    BenchWorkload workload;
+    workload.orders = orderCount;
+    workload.waiters = 20;
+    workload.days = 2 * 365;
+    workload.seed = seed;
+    WorkloadGenerator generator(workload);
+    const int64_t start = generator.getStart();
+    WorkloadGenerator::GeneratedOrder order;
+    for (size_t i = 0; i < orderCount; i++) {
+        generator.order(i, order);
+        amounts[i] = order.amount;
+        types[i] = static_cast<uint8_t>(order.type);
+        waiters[i] = order.waiter;
+        timestamps[i] = order.timestamp;
+    }
+    
+    const int64_t edges[] = {0, -1, -3600, -3601, -86400, -86401, 3599, 3600, 86399, 86400,
+                             start - 1, start, start + 23 * 3600, start + 86399, -62135596800LL, 253402300799LL};
+    const size_t edgeCount = sizeof(edges) / sizeof(edges[0]);
+    
+    bool ok = true;
+    struct Result {
+        double typeSales[2];
+        uint64_t typeCounts[2];
+        double waiterSales[20];
+        uint64_t waiterCounts[20];
+        double hourSales[24];
+        uint64_t hourCounts[24];
+    };
+    Result reference;
+    auto close = [](double a, double b) { return fabs(a - b) <= 1e-12 * max(fabs(a), fabs(b)); };
+    for (const SalesKernels* kernels : supportedSalesKernels()) {
+        Result result = {};
+        double seconds[3];
+        for (int kernel = 0; kernel < 3; kernel++) {
+            double best = 1e30;
+            for (int repetition = 0; repetition < 3; repetition++) {
+                // Kernels add into their outputs, so only the first run is kept
+                Result scratch = {};
+                Result& out = repetition == 0 ? result : scratch;
+                auto begin = chrono::steady_clock::now();
+                if (kernel == 0) {
+                    kernels->sumByType(amounts.data(), types.data(), orderCount, out.typeSales, out.typeCounts);
+                } else if (kernel == 1) {
+                    kernels->sumByGroup(amounts.data(), waiters.data(), orderCount, out.waiterSales,
+                                        out.waiterCounts, 20);
+                } else {
+                    kernels->bucketByHour(timestamps.data(), amounts.data(), orderCount, out.hourSales, out.hourCounts);
+                }
+                best = min(best, chrono::duration<double>(chrono::steady_clock::now() - begin).count());
+            }
+            seconds[kernel] = best;
+        }
+        if (kernels == &SCALAR_SALES_KERNELS) {
+            reference = result;
+        }
+        bool match = true;
+        for (int t = 0; t < 2; t++) {
+            match = match && close(result.typeSales[t], reference.typeSales[t]) &&
+                    result.typeCounts[t] == reference.typeCounts[t];
+        }
+        for (int w = 0; w < 20; w++) {
+            match = match && close(result.waiterSales[w], reference.waiterSales[w]) &&
+                    result.waiterCounts[w] == reference.waiterCounts[w];
+        }
+        for (int h = 0; h < 24; h++) {
+            match = match && close(result.hourSales[h], reference.hourSales[h]) &&
+                    result.hourCounts[h] == reference.hourCounts[h];
+        }
+        for (size_t e = 0; e < edgeCount; e++) {
+            double hourSales[24] = {};
+            uint64_t hourCounts[24] = {};
+            // Placed last in a block of four so the vector loop, not the tail, handles it
+            int64_t block[4] = {start, start, start, edges[e]};
+            double blockAmounts[4] = {0.0, 0.0, 0.0, 1.0};
+            kernels->bucketByHour(block, blockAmounts, 4, hourSales, hourCounts);
+            match = match && hourSales[Timestamp::fromEpochSeconds(edges[e]).getHour()] == 1.0;
+        }
+        ok = ok && match;
+        
+        const double gigabyte = 1e9;
+        cout << setw(10) << left << kernels->name << fixed << setprecision(2)
+             << setw(11) << right << orderCount * (sizeof(double) + sizeof(uint8_t)) / seconds[0] / gigabyte
+             << setw(11) << right << orderCount * (sizeof(double) + sizeof(uint32_t)) / seconds[1] / gigabyte
+             << setw(11) << right << orderCount * (sizeof(double) + sizeof(int64_t)) / seconds[2] / gigabyte
+             << "   " << (match ? "ok" : "MISMATCH") << endl;
+        const char* const kernelNames[] = {"by type", "by waiter", "by hour"};
+        const size_t bytesPerOrder[] = {sizeof(double) + sizeof(uint8_t), sizeof(double) + sizeof(uint32_t),
+                                        sizeof(double) + sizeof(int64_t)};
+        for (int kernel = 0; kernel < 3; kernel++) {
+            suite.record(string("kernels/") + kernels->name + "/" + kernelNames[kernel], "GB/s",
+                         orderCount * bytesPerOrder[kernel] / seconds[kernel] / gigabyte);
+        }
+    }
+    return ok;
+}
+
+// Streams sampleCount log-normal amounts into four histograms, merges them
+// and compares the quantiles with exact nearest-rank quantiles of the sorted
+// amounts; fails if any is outside the documented 1/256 bound or the merge
+// differs from a single histogram fed every amount
+bool benchQuantileAccuracy(size_t sampleCount, BenchSuite& suite) {
+    SimulationRandom random(7);
+    vector<double> amounts;
+    amounts.reserve(sampleCount);
+    for (size_t i = 0; i < sampleCount; i++) {
+        // Sum of uniforms stands in for a normal: median R150, long right tail
+        double normal = random.uniform() + random.uniform() + random.uniform() + random.uniform() - 2.0;
+        amounts.push_back(round(15000.0 * exp(1.6 * normal)) / 100.0);
+    }
     
-    int patronTypeChoice;
-    cout << "Patron type:\n1. Individual\n2. Group\nEnter choice (1-2): ";
-    cin >> patronTypeChoice;
+    AmountHistogram single;
+    AmountHistogram parts[4];
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < sampleCount; i++) {
+        parts[i % 4].add(amounts[i]);
+    }
+    double addSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    AmountHistogram merged;
+    for (const AmountHistogram& part : parts) {
+        merged.merge(part);
+    }
+    for (double amount : amounts) {
+        single.add(amount);
+    }
     
-    PatronType patronType = (patronTypeChoice == 1) ? PatronType::INDIVIDUAL : PatronType::GROUP;
+    vector<int64_t> cents;
+    cents.reserve(sampleCount);
+    for (double amount : amounts) {
+        cents.push_back(llround(amount * 100.0));
+    }
+    sort(cents.begin(), cents.end());
     
-    int groupSize = 1;
-    if (patronType == PatronType::GROUP) {
-        cout << "Enter group size: ";
-        cin >> groupSize;
+    bool ok = merged.count() == sampleCount && merged.minAmount() == cents.front() / 100.0 &&
+              merged.maxAmount() == cents.back() / 100.0;
+    const double quantiles[] = {0.001, 0.5, 0.9, 0.99, 0.999};
+    for (double q : quantiles) {
+        size_t rank = static_cast<size_t>(ceil(q * sampleCount));
+        double exact = cents[rank - 1] / 100.0;
+        double estimate = merged.quantile(q);
+        double error = fabs(estimate - exact) / exact;
+        bool within = error <= 1.0 / 256 && estimate == single.quantile(q);
+        ok = ok && within;
+        char label[16];
+        snprintf(label, sizeof(label), "p%g", q * 100);
+        cout << setw(8) << left << label << setw(12) << right << fixed << setprecision(2) << exact
+             << setw(12) << right << estimate << setw(11) << right << setprecision(3) << error * 100 << "%"
+             << (within ? "" : "  FAILED") << endl;
     }
     
-    int orderTypeChoice;
-    cout << "Order type:\n1. Sit-in\n2. Take-out\nEnter choice (1-2): ";
-    cin >> orderTypeChoice;
+    // Below R2.56 every cent has its own bucket, so quantiles are exact
+    AmountHistogram small;
+    for (int c = 1; c <= 255; c++) {
+        small.add(c / 100.0);
+    }
+    for (int c = 1; c <= 255; c++) {
+        ok = ok && small.quantile(c / 255.0) == c / 100.0;
+    }
+    cout << setw(28) << left << "AmountHistogram::add" << setw(14) << right << fixed << setprecision(3)
+         << addSeconds * 1e9 / sampleCount << " ns  " << (ok ? "ok" : "FAILED") << endl;
+    suite.record("AmountHistogram::add", "ns", addSeconds * 1e9 / sampleCount);
+    return ok;
+}
+
+// Registers patronCount distinct named patrons with one order each, then a
+// second visit for every tenth, and times the registry and the top-10 query.
+// The heap-based ranking is checked against a full sort.
+bool benchPatronRegistry(size_t patronCount, BenchSuite& suite) {
+    Restaurant restaurant("Loyalty Kitchen");
+    restaurant.addWaiter(make_shared<Waiter>(1, "Waiter 1"));
+    restaurant.reservePatrons(patronCount);
+    restaurant.reserveOrders(patronCount + patronCount / 10);
+    vector<string> names;
+    names.reserve(patronCount);
+    for (size_t i = 0; i < patronCount; i++) {
+        names.push_back("Patron " + to_string(i));
+    }
+    const Timestamp timestamp(2024, 12, 15, 12, 0, 0);
     
-    OrderType orderType = (orderTypeChoice == 1) ? OrderType::SIT_IN : OrderType::TAKE_OUT;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < patronCount; i++) {
+        uint32_t patronId = restaurant.addPatron(names[i], PatronType::INDIVIDUAL, 1, true);
+        restaurant.addOrder(patronId, i % 4 ? OrderType::SIT_IN : OrderType::TAKE_OUT,
+                            static_cast<double>((i * 7919) % 100000) / 100.0, 0, "Coffee", timestamp);
+    }
+    double insertSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
     
-    // Select waiter
-    cout << "\nAvailable waiters:" << endl;
-    for (const auto& waiter : restaurant.getWaiters()) {
-        cout << waiter->getWaiterId() << ". " << waiter->getName() << endl;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < patronCount; i += 10) {
+        uint32_t patronId = restaurant.addPatron(names[i], PatronType::INDIVIDUAL, 1, true);
+        restaurant.addOrder(patronId, OrderType::TAKE_OUT, 12.5, 0, "Muffin", timestamp);
     }
+    double repeatSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
     
-    int waiterChoice;
-    cout << "Select waiter ID: ";
-    cin >> waiterChoice;
+    start = chrono::steady_clock::now();
+    vector<uint32_t> top = restaurant.getTopPatronsBySpend(10);
+    double topSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
     
-    auto selectedWaiter = restaurant.getWaiters()[waiterChoice - 1];
+    vector<pair<double, uint32_t>> all;
+    all.reserve(restaurant.getPatronCount());
+    for (uint32_t row = 0; row < restaurant.getPatronCount(); row++) {
+        all.push_back(make_pair(-restaurant.getPatron(row).getLifetimeSpend(), row));
+    }
+    sort(all.begin(), all.end());
+    bool ok = restaurant.getPatronCount() == patronCount && restaurant.getRepeatPatronCount() == (patronCount + 9) / 10 &&
+              top.size() == 10;
+    for (size_t i = 0; ok && i < top.size(); i++) {
+        ok = top[i] == all[i].second;
+    }
     
-    // Get order details
-    double amount;
-    cout << "Enter order amount (R): ";
-    cin >> amount;
+    cout << setw(28) << left << "new patron + order" << setw(14) << right << fixed << setprecision(3)
+         << insertSeconds * 1e9 / patronCount << " ns" << endl;
+    cout << setw(28) << left << "repeat patron + order" << setw(14) << right << fixed << setprecision(3)
+         << repeatSeconds * 1e9 / ((patronCount + 9) / 10) << " ns" << endl;
+    cout << setw(28) << left << "top 10 by spend" << setw(14) << right << fixed << setprecision(3)
+         << topSeconds * 1e3 << " ms  " << (ok ? "ok" : "FAILED") << endl;
+    suite.record("registry/new patron + order", "ns", insertSeconds * 1e9 / patronCount);
+    suite.record("registry/repeat patron + order", "ns", repeatSeconds * 1e9 / ((patronCount + 9) / 10));
+    suite.record("registry/top 10 by spend", "ms", topSeconds * 1e3);
+    return ok;
+}
+
+// Concurrent intake stress test: writer threads submit through their own
+// terminals while the publisher runs and a reader keeps taking snapshots.
+// Checks that every order arrives, ids are unique and snapshots add up.
+bool benchConcurrentIntake(int writers, size_t totalOrders, BenchSuite& suite) {
+    Restaurant restaurant("Intake Kitchen");
+    for (int i = 1; i <= 8; i++) {
+        restaurant.addWaiter(make_shared<Waiter>(i, "Waiter " + to_string(i)));
+    }
+    OrderIntake intake(restaurant);
+    vector<OrderIntake::Terminal*> terminals;
+    for (int i = 0; i < writers; i++) {
+        terminals.push_back(&intake.openTerminal());
+    }
+    const size_t perWriter = totalOrders / static_cast<size_t>(writers);
     
-    string items;
-    cout << "Enter order items: ";
-    cin.ignore();
-    getline(cin, items);
+    atomic<bool> writing(true);
+    atomic<bool> consistent(true);
+    size_t snapshots = 0;
+    thread reader([&]() {
+        while (writing.load()) {
+            intake.readSnapshot([&](const Restaurant& r) {
+                size_t byWaiter = 0;
+                for (const auto& waiter : r.getWaiters()) {
+                    byWaiter += waiter->getOrderCount();
+                }
+                size_t byType = r.getOrderCount(OrderType::SIT_IN) + r.getOrderCount(OrderType::TAKE_OUT);
+                if (byWaiter != r.getOrders().size() || byType != r.getOrders().size()) {
+                    consistent = false;
+                }
+            });
+            snapshots++;
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+    });
     
-    // Create patron and add order
-    auto patron = make_shared<Patron>(patronName, patronType, groupSize, (orderType == OrderType::SIT_IN));
-    restaurant.addOrder(patron, orderType, amount, selectedWaiter, items);
+    auto start = chrono::steady_clock::now();
+    intake.start();
+    vector<thread> threads;
+    for (int w = 0; w < writers; w++) {
+        threads.emplace_back([&, w]() {
+            auto patron = make_shared<Patron>("Terminal " + to_string(w), PatronType::INDIVIDUAL, 1, true);
+            for (size_t i = 0; i < perWriter; i++) {
+                terminals[static_cast<size_t>(w)]->submit(patron, i % 3 ? OrderType::SIT_IN : OrderType::TAKE_OUT,
+                                                          static_cast<double>(i % 1000) / 4.0,
+                                                          static_cast<uint32_t>(i % 8), "Coffee",
+                                                          Timestamp::fromEpochSeconds(1734220800 + static_cast<int64_t>(i)));
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    intake.stop();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    writing = false;
+    reader.join();
     
-    cout << "\n✅ Order added successfully!" << endl;
-    cout << "Order ID: " << restaurant.getOrders().back()->getOrderId() << endl;
-    cout << "Timestamp: " << restaurant.getOrders().back()->getTimestamp().toString() << endl;
+    const size_t expected = perWriter * static_cast<size_t>(writers);
+    const OrderStore& orders = restaurant.getOrders();
+    vector<int> ids(orders.orderIdData(), orders.orderIdData() + orders.size());
+    sort(ids.begin(), ids.end());
+    bool idsOk = ids.size() == expected;
+    for (size_t i = 0; idsOk && i < ids.size(); i++) {
+        idsOk = ids[i] == ids[0] + static_cast<int>(i);
+    }
+    double expectedSales = 0.0;
+    for (size_t i = 0; i < perWriter; i++) {
+        expectedSales += static_cast<double>(i % 1000) / 4.0;
+    }
+    expectedSales *= writers;
+    bool ok = idsOk && consistent.load() && restaurant.getTotalSales() == expectedSales;
+    
+    cout << setw(9) << right << writers << setw(12) << right << orders.size()
+         << setw(16) << right << fixed << setprecision(0) << expected / seconds
+         << setw(12) << right << snapshots << "  " << (ok ? "ok" : "FAILED") << endl;
+    suite.record("intake/" + to_string(writers) + " writers", "orders/s", expected / seconds);
+    return ok;
 }
 
-void displayOrdersByTimeRange(const Restaurant& restaurant) {
-    cout << "\n=== ORDERS BY TIME RANGE ===" << endl;
-    cout << string(50, '-') << endl;
+// Saves and restores source, comparing restore speed with just reading the
+// mapped file and with copying it into newly allocated memory (the floor for
+// anything that keeps the data), and checks that the restored restaurant has
+// exactly the same state: equal columns, working patron lookups and the
+// same next order id.
+bool benchSnapshot(Restaurant& source, BenchSuite& suite) {
+    const int rounds = 3;
+    double saveSeconds = 1e30, readSeconds = 1e30, copySeconds = 1e30, restoreSeconds = 1e30;
+    for (int round = 0; round < rounds; round++) {
+        auto start = chrono::steady_clock::now();
+        if (!RestaurantSnapshot::save(source, BENCH_SNAPSHOT)) {
+            cerr << "Cannot write " << BENCH_SNAPSHOT << endl;
+            return false;
+        }
+        saveSeconds = min(saveSeconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
     
-    cout << "Enter start hour (0-23): ";
-    int startHour;
-    cin >> startHour;
+    size_t fileSize = 0;
+    uint64_t sum = 0;
+    for (int round = 0; round < rounds; round++) {
+        auto start = chrono::steady_clock::now();
+        MappedFile file;
+        file.open(BENCH_SNAPSHOT);
+        fileSize = file.size();
+        for (size_t offset = 0; offset + sizeof(uint64_t) <= fileSize; offset += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, file.data() + offset, sizeof(word));
+            sum += word;
+        }
+        readSeconds = min(readSeconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    for (int round = 0; round < rounds; round++) {
+        auto start = chrono::steady_clock::now();
+        MappedFile file;
+        file.open(BENCH_SNAPSHOT);
+        vector<char> copy(file.data(), file.data() + file.size());
+        sum += copy.empty() ? 0 : static_cast<uint64_t>(copy.back());
+        copySeconds = min(copySeconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
     
-    cout << "Enter end hour (0-23): ";
-    int endHour;
-    cin >> endHour;
+    bool ok = true;
+    string error;
+    for (int round = 0; round < rounds; round++) {
+        Restaurant restored("Restored Kitchen");
+        auto start = chrono::steady_clock::now();
+        ok = RestaurantSnapshot::restore(restored, BENCH_SNAPSHOT, error) && ok;
+        restoreSeconds = min(restoreSeconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        if (round == 0 && ok) {
+            ColumnarDumpWriter expected, actual;
+            RestaurantSnapshot::collect(source, expected);
+            RestaurantSnapshot::collect(restored, actual);
+            ok = expected.checksum() == actual.checksum() && restored.getPatronCount() == source.getPatronCount();
+            for (uint32_t row = 0; ok && row < restored.getPatronCount(); row += 97) {
+                StringRef patronName = source.getPatron(row).getName();
+                ok = restored.findPatron(patronName.data(), patronName.size()) ==
+                     source.findPatron(patronName.data(), patronName.size());
+            }
+            ok = ok && restored.allocateOrderIds(0) == source.allocateOrderIds(0);
+        }
+    }
+    if (!error.empty()) {
+        cerr << "Cannot restore " << BENCH_SNAPSHOT << ": " << error << endl;
+    }
     
-    cout << "\nOrders between " << startHour << ":00 and " << endHour << ":00:" << endl;
-    cout << string(120, '-') << endl;
-    cout << setw(8) << left << "Order ID" << setw(20) << left << "Patron" 
-         << setw(15) << left << "Type" << setw(15) << left << "Order Type"
-         << setw(20) << left << "Waiter" << setw(20) << left << "Timestamp"
-         << setw(15) << right << "Amount" << endl;
-    cout << string(120, '-') << endl;
+    BackgroundSnapshot background;
+    auto start = chrono::steady_clock::now();
+    bool started = background.start(source, BENCH_SNAPSHOT);
+    double pauseSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    ok = started && background.wait() && ok;
+    remove(BENCH_SNAPSHOT);
     
-    int count = 0;
-    for (const auto& order : restaurant.getOrders()) {
-        int orderHour = order->getTimestamp().toString().substr(11, 2)[0] - '0' * 10 + 
-                       order->getTimestamp().toString().substr(12, 1)[0] - '0';
-        if (orderHour >= startHour && orderHour <= endHour) {
-            cout << setw(8) << left << order->getOrderId()
-                 << setw(20) << left << order->getPatron()->getName()
-                 << setw(15) << left << order->getPatron()->getTypeString()
-                 << setw(15) << left << order->getTypeString()
-                 << setw(20) << left << order->getWaiter()->getName()
-                 << setw(20) << left << order->getTimestamp().toString()
-                 << "R" << setw(14) << right << fixed << setprecision(2) << order->getTotalAmount() << endl;
-            count++;
+    const double megabytes = fileSize / 1e6;
+    volatile uint64_t sink = sum; // keeps the read loop
+    (void)sink;
+    cout << "Snapshot size " << fixed << setprecision(1) << megabytes << " MB" << endl;
+    cout << setw(28) << left << "save (fsync)" << setw(14) << right << fixed << setprecision(1)
+         << megabytes / saveSeconds << " MB/s" << endl;
+    cout << setw(28) << left << "read mapped file" << setw(14) << right << fixed << setprecision(1)
+         << megabytes / readSeconds << " MB/s" << endl;
+    cout << setw(28) << left << "copy into new memory" << setw(14) << right << fixed << setprecision(1)
+         << megabytes / copySeconds << " MB/s" << endl;
+    cout << setw(28) << left << "restore" << setw(14) << right << fixed << setprecision(1)
+         << megabytes / restoreSeconds << " MB/s" << endl;
+    cout << setw(28) << left << "background save pause" << setw(14) << right << fixed << setprecision(3)
+         << pauseSeconds * 1e3 << " ms  " << (ok ? "ok" : "FAILED") << endl;
+    suite.record("snapshot/save", "MB/s", megabytes / saveSeconds);
+    suite.record("snapshot/read mapped file", "MB/s", megabytes / readSeconds);
+    suite.record("snapshot/copy into new memory", "MB/s", megabytes / copySeconds);
+    suite.record("snapshot/restore", "MB/s", megabytes / restoreSeconds);
+    suite.record("snapshot/background save pause", "ms", pauseSeconds * 1e3);
+    return ok;
+}
+
+// The aggregation engine: three report aggregates in one fused pass against
+// a pass each, with the vectorised scan for comparison. The results are
+// checked against the running totals the restaurant keeps.
+bool benchAggregation(const Restaurant& restaurant, BenchSuite& suite) {
+    typedef Aggregate<GroupBy<ByOrderType>, Count, Sum<Amount>> TypeSales;
+    typedef Aggregate<GroupBy<ByWaiter, ByOrderType>, Sum<Amount>, Commission<FlatCommission>> WaiterSales;
+    typedef Aggregate<GroupBy<ByHour>, Count, Sum<Amount>> HourSales;
+    const size_t n = restaurant.getOrders().size();
+    TypeSales types;
+    WaiterSales waiters;
+    HourSales hours;
+    
+    suite.printHeader();
+    suite.run("type, waiter x type, hour fused", [&]() { restaurant.aggregate(types, waiters, hours); }, n);
+    suite.run("type, waiter x type, hour apart", [&]() {
+        restaurant.aggregate(types);
+        restaurant.aggregate(waiters);
+        restaurant.aggregate(hours);
+    }, n);
+    suite.run("waiter x type + commission", [&]() { restaurant.aggregate(waiters); }, n);
+    SalesScan scan;
+    suite.run("scanSales (kernels)", [&]() { restaurant.scanSales(scan); }, n);
+    
+    restaurant.aggregate(types, waiters, hours);
+    auto close = [](double a, double b) { return fabs(a - b) <= 1e-9 * max(1.0, fabs(b)); };
+    bool ok = true;
+    for (int t = 0; t < 2; t++) {
+        OrderType type = static_cast<OrderType>(t);
+        ok = ok && types.get<Count>(t) == restaurant.getOrderCount(type) &&
+             close(types.get<Sum<Amount>>(t), restaurant.getSales(type));
+    }
+    const auto& staff = restaurant.getWaiters();
+    for (size_t w = 0; w < staff.size(); w++) {
+        double sales = waiters.get<Sum<Amount>>(w * 2) + waiters.get<Sum<Amount>>(w * 2 + 1);
+        double commission = waiters.get<Commission<FlatCommission>>(w * 2) +
+                            waiters.get<Commission<FlatCommission>>(w * 2 + 1);
+        ok = ok && close(sales, staff[w]->getTotalSales()) && close(commission, staff[w]->getCommission());
+    }
+    for (int hour = 0; hour < 24; hour++) {
+        ok = ok && hours.get<Count>(hour) == scan.hourCounts[hour] && close(hours.get<Sum<Amount>>(hour), scan.hourSales[hour]);
+    }
+    cout << "Time per order; checked against the running totals and the kernels: " << (ok ? "ok" : "FAILED") << endl;
+    return ok;
+}
+
+// Line items: the "Nx Item" parser on its own and the per-item scan behind
+// the item reports. Item revenue must add up to the restaurant's sales.
+bool benchItems(const Restaurant& restaurant, BenchSuite& suite) {
+    const char* const lists[] = {"Burger, Chips, Coke", "4x Pasta, 4x Wine, 2x Dessert",
+                                 "3x Bunny Chow, Bobotie, 2x Castle Lager, Rooibos Tea, 3x Koeksisters",
+                                 " 12x Vetkoek ,, Coke, coke, 2X Coke"};
+    const size_t listCount = sizeof(lists) / sizeof(lists[0]);
+    vector<string> samples(lists, lists + listCount);
+    MenuCatalog menu;
+    vector<LineItem> lines;
+    const size_t rounds = 10000;
+    
+    suite.printHeader();
+    suite.run("parse item list", [&]() {
+        for (size_t r = 0; r < rounds; r++) {
+            for (const string& sample : samples) {
+                lines.clear();
+                parseLineItems(sample, menu, lines);
+            }
         }
+    }, rounds * listCount);
+    ItemScan scan;
+    suite.run("scan items (per order)", [&]() { restaurant.scanItems(scan); }, restaurant.getOrders().size());
+    
+    // The last sample has a padded count, an empty entry and a repeated item
+    lines.clear();
+    parseLineItems(samples[3], menu, lines);
+    bool ok = lines.size() == 3 && menu.name(lines[0].item) == "Vetkoek" && lines[0].quantity == 12 &&
+              menu.name(lines[1].item) == "Coke" && lines[1].quantity == 3 && menu.name(lines[2].item) == "coke";
+    
+    restaurant.scanItems(scan);
+    KahanSum revenue;
+    for (double r : scan.revenue) {
+        revenue.add(r);
+    }
+    double sales = restaurant.getTotalSales();
+    auto close = [](double a, double b) { return fabs(a - b) <= 1e-9 * max(1.0, fabs(b)); };
+    ok = ok && close(revenue.value(), sales) && close(scan.totalRevenue, sales);
+    cout << "Item revenue " << fixed << setprecision(2) << revenue.value() << " against sales " << sales << ": "
+         << (ok ? "ok" : "FAILED") << endl;
+    return ok;
+}
+
+// Recomputes the totals addOrder keeps running from a plain pass over the
+// order columns: counts must match exactly, sums to a relative 1e-9
+bool runningTotalsMatch(const Restaurant& restaurant) {
+    const OrderStore& orders = restaurant.getOrders();
+    const auto& waiters = restaurant.getWaiters();
+    KahanSum typeSales[2];
+    size_t typeCounts[2] = {0, 0};
+    vector<KahanSum> waiterSales(waiters.size());
+    vector<int> waiterCounts(waiters.size(), 0);
+    for (size_t row = 0; row < orders.size(); row++) {
+        int type = static_cast<int>(orders.type(row));
+        typeSales[type].add(orders.amount(row));
+        typeCounts[type]++;
+        waiterSales[orders.waiterId(row)].add(orders.amount(row));
+        waiterCounts[orders.waiterId(row)]++;
     }
     
-    if (count == 0) {
-        cout << "No orders found in the specified time range." << endl;
-    } else {
-        cout << string(120, '-') << endl;
-        cout << "Total orders in time range: " << count << endl;
+    auto close = [](double a, double b) { return fabs(a - b) <= 1e-9 * max(1.0, fabs(b)); };
+    const OrderType types[] = {OrderType::SIT_IN, OrderType::TAKE_OUT};
+    bool ok = true;
+    for (OrderType type : types) {
+        int t = static_cast<int>(type);
+        ok = ok && restaurant.getOrderCount(type) == typeCounts[t] && close(restaurant.getSales(type), typeSales[t].value());
     }
+    for (size_t w = 0; ok && w < waiters.size(); w++) {
+        double sales = waiterSales[w].value();
+        ok = waiters[w]->getOrderCount() == waiterCounts[w] && close(waiters[w]->getTotalSales(), sales) &&
+             close(waiters[w]->getCommission(), Waiter::commissionOn(sales));
+    }
+    return ok;
 }
 
-void processMenuChoice(int choice, Restaurant& restaurant) {
-    switch (choice) {
-        case 1:
-            restaurant.generateAllReports();
-            break;
-        case 2:
-            restaurant.reportOrderCounts();
-            break;
-        case 3:
-            restaurant.reportTotalSales();
-            break;
-        case 4:
-            restaurant.reportWaiterSales();
-            break;
-        case 5:
-            restaurant.reportWaiterCommission();
-            break;
-        case 6:
-            restaurant.displayAllOrders();
-            break;
-        case 7:
-            addNewOrder(restaurant);
-            break;
-        case 8:
-            displayRestaurantStats(restaurant);
-            break;
-        case 9:
-            displayOrdersByTimeRange(restaurant);
-            break;
-        case 10:
-            clearScreen();
-            break;
-        case 0:
-            cout << "\nThank you for using the Restaurant Simulation System!" << endl;
-            cout << "Goodbye! 👋" << endl;
+// Running totals after a mix of every way orders arrive (bulk addOrder, a
+// day close, ingest, the shared_ptr addOrder), then after replaying the
+// journal those orders went to. Both must match a rescan of the columns.
+bool benchRunningTotals(const BenchWorkload& workload) {
+    const string directory = string(BENCH_JOURNAL) + "/totals";
+    if (!makeDirectory(BENCH_JOURNAL) || !makeDirectory(directory)) {
+        cerr << "Cannot create " << directory << endl;
+        return false;
+    }
+    for (int number = 1;; number++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/journal-%06d.seg", number);
+        if (remove((directory + name).c_str()) != 0) {
             break;
-        default:
-            cout << "Invalid choice!" << endl;
+        }
+    }
+    remove((directory + "/strings.pool").c_str());
+    
+    Restaurant live("Totals Kitchen");
+    bool ok;
+    {
+        OrderJournal journal(directory);
+        size_t replayed;
+        if (!journal.open(live, replayed) || replayed != 0) {
+            cerr << "Cannot start an empty journal in " << directory << endl;
+            return false;
+        }
+        live.attachJournal(&journal);
+        createBenchData(live, workload);
+        {
+            ReportWriter csv(BENCH_ORDERS_CSV);
+            exportCsv(live, csv);
+        }
+        ok = runningTotalsMatch(live);
+        live.closeDay();
+        IngestResult result;
+        ok = ingestOrders(live, BENCH_ORDERS_CSV, result) && result.skipped == 0 &&
+             live.getOrders().size() == workload.orders && ok;
+        remove(BENCH_ORDERS_CSV);
+        const size_t ingested = live.getOrders().size();
+        for (size_t row = 0; row < ingested; row += 7) {
+            Order order = live.getOrder(row);
+            PatronRef patron = live.getPatron(order.getPatronId());
+            live.addOrder(make_shared<Patron>(patron.getName().str(), order.getPartyType(), order.getPartySize(),
+                                              patron.isSitInOrder()),
+                          order.getType(), order.getTotalAmount() + 0.25, live.getWaiters()[order.getWaiterId()],
+                          order.getItems().str(), order.getTimestamp());
+        }
+        ok = ok && runningTotalsMatch(live) && journal.commit();
+    }
+    cout << setw(28) << left << "addOrder, closeDay, ingest" << setw(10) << right << live.getOrders().size()
+         << "  " << (ok ? "ok" : "FAILED") << endl;
+    
+    Restaurant replayed("Totals Kitchen");
+    OrderJournal journal(directory);
+    size_t replayedOrders;
+    bool replayOk = journal.open(replayed, replayedOrders) && replayed.getOrders().size() == live.getOrders().size() &&
+                    runningTotalsMatch(replayed) &&
+                    replayed.getTotalSales() == live.getTotalSales();
+    cout << setw(28) << left << "journal replay" << setw(10) << right << replayed.getOrders().size() << "  "
+         << (replayOk ? "ok" : "FAILED") << endl;
+    return ok && replayOk;
+}
+
+// The order pipeline under a feed paced at rate lines per second: intake
+// latency (feed to order in the restaurant) alone, while the write stage
+// exports the detailed order report chunk by chunk, and while the same
+// report is taken in one lock hold through readSnapshot. The restaurant
+// starts with the workload, so each export is a long one. The p99 ratio is
+// recorded, not checked: wall-clock latency depends on the machine. Fails if
+// orders go missing or the chunked export differs from the one-hold export.
+bool benchPipeline(const BenchWorkload& workload, double rate, double seconds, BenchSuite& suite) {
+    Restaurant restaurant("Pipeline Kitchen");
+    createBenchData(restaurant, workload);
+    const size_t perScenario = static_cast<size_t>(rate * seconds);
+    const size_t burst = 16;
+    vector<string> feed;
+    feed.reserve(perScenario);
+    for (size_t i = 0; i < perScenario; i++) {
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "{\"patron\":\"Patron %d\",\"order_type\":\"%s\",\"waiter_id\":%d,\"amount\":%zu.%02zu,"
+                 "\"items\":\"2x Pasta, 2x Wine\",\"timestamp\":\"2024-12-15T%02zu:%02zu:00\"}",
+                 static_cast<int>(i % static_cast<size_t>(workload.patrons)) + 1, i % 4 ? "Sit-in" : "Take-out",
+                 static_cast<int>(i % static_cast<size_t>(workload.waiters)) + 1, 50 + i % 400, i % 100,
+                 10 + i % 12, i % 60);
+        feed.push_back(line);
+    }
+    
+    const char* const scenarios[] = {"no export", "chunked export", "export in one lock hold"};
+    cout << setw(26) << left << "Scenario" << setw(10) << right << "Orders" << setw(10) << right << "Exports"
+         << setw(12) << right << "p50 us" << setw(12) << right << "p99 us" << setw(12) << right << "max us" << endl;
+    cout << string(82, '-') << endl;
+    bool ok = true;
+    double p99[3];
+    for (int scenario = 0; scenario < 3; scenario++) {
+        size_t before = restaurant.getOrders().size();
+        vector<uint64_t> latencies;
+        latencies.reserve(perScenario);
+        OrderPipeline pipeline(restaurant);
+        pipeline.logLatencies(&latencies);
+        
+        atomic<bool> feeding(true);
+        size_t lockedExports = 0;
+        thread exporter;
+        if (scenario == 2) {
+            exporter = thread([&]() {
+                ReportWriter sink(NULL_DEVICE);
+                while (feeding.load()) {
+                    pipeline.readSnapshot([&](const Restaurant& r) { r.displayAllOrders(sink); });
+                    lockedExports++;
+                }
+            });
+        }
+        size_t queued = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < perScenario; i += burst) {
+            this_thread::sleep_until(start + chrono::nanoseconds(static_cast<int64_t>(i / rate * 1e9)));
+            if (scenario == 1 && pipeline.getExportsWritten() + pipeline.getExportsFailed() == queued) {
+                pipeline.queueExport(NULL_DEVICE);
+                queued++;
+            }
+            for (size_t j = i; j < min(perScenario, i + burst); j++) {
+                pipeline.feed(feed[j]);
+            }
+        }
+        feeding = false;
+        if (exporter.joinable()) {
+            exporter.join();
+        }
+        pipeline.finish();
+        
+        sort(latencies.begin(), latencies.end());
+        auto quantile = [&latencies](double q) {
+            return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(q * (latencies.size() - 1))] / 1e3;
+        };
+        size_t exports = scenario == 1 ? pipeline.getExportsWritten() : lockedExports;
+        ok = ok && restaurant.getOrders().size() - before == perScenario && pipeline.getResult().skipped == 0 &&
+             latencies.size() == perScenario && pipeline.getExportsFailed() == 0 && (scenario == 0 || exports > 0);
+        cout << setw(26) << left << scenarios[scenario] << setw(10) << right << perScenario << setw(10) << right
+             << exports << setw(12) << right << fixed << setprecision(1) << quantile(0.5) << setw(12) << right
+             << quantile(0.99) << setw(12) << right << quantile(1.0) << endl;
+        suite.record(string("pipeline/") + scenarios[scenario] + " p99", "us", quantile(0.99));
+        p99[scenario] = quantile(0.99);
+    }
+    
+    const double slowdown = p99[0] > 0.0 ? p99[1] / p99[0] : 0.0;
+    suite.record("pipeline/chunked export p99 ratio", "x", slowdown);
+    
+    // A chunked export matches the report taken in one go
+    FILE* chunked = tmpfile();
+    FILE* whole = tmpfile();
+    bool same = chunked && whole;
+    if (same) {
+        OrderPipeline pipeline(restaurant);
+        ReportWriter a(chunked), b(whole);
+        pipeline.exportOrders(a);
+        restaurant.displayAllOrders(b);
+        a.flush();
+        b.flush();
+        same = ftell(chunked) == ftell(whole) && ftell(chunked) > 0;
+        rewind(chunked);
+        rewind(whole);
+        vector<char> x(64 * 1024), y(64 * 1024);
+        size_t n;
+        while (same && (n = fread(x.data(), 1, x.size(), chunked)) > 0) {
+            same = fread(y.data(), 1, n, whole) == n && memcmp(x.data(), y.data(), n) == 0;
+        }
+    }
+    if (chunked) {
+        fclose(chunked);
+    }
+    if (whole) {
+        fclose(whole);
+    }
+    ok = ok && same;
+    
+    // A feed with quoted fields spanning lines gives the same orders as --ingest of the file
+    {
+        ReportWriter csv(BENCH_ORDERS_CSV);
+        csv.text("patron,order_type,waiter_id,amount,items,timestamp\n");
+        csv.text("Anna,Sit-in,1,10.00,\"Burger\nChips\",2024-12-15T12:00:00\n");
+        csv.text("Ben,Take-out,2,12.50,\"Say \"\"hi\"\"\n\nthere\",2024-12-15T12:05:00\n");
+        csv.text("Cara,Sit-in,1,7.00,Tea,2024-12-15T12:10:00\n");
+    }
+    Restaurant fromFile("Feed Kitchen"), fromFeed("Feed Kitchen");
+    IngestResult fileResult, feedResult;
+    FILE* in = fopen(BENCH_ORDERS_CSV, "rb");
+    bool feedOk = ingestOrders(fromFile, BENCH_ORDERS_CSV, fileResult) && in &&
+                  ingestFeed(fromFeed, in, nullptr, feedResult) && fileResult.skipped == 0 &&
+                  feedResult.skipped == 0 && fromFile.getOrders().size() == 3 &&
+                  fromFeed.getOrders().size() == 3 && fromFile.getOrder(0).getItems() == "Burger\nChips";
+    for (size_t row = 0; feedOk && row < fromFile.getOrders().size(); row++) {
+        Order a = fromFile.getOrder(row), b = fromFeed.getOrder(row);
+        feedOk = a.getItems() == b.getItems() && a.getTotalAmount() == b.getTotalAmount() &&
+                 a.getType() == b.getType() && a.getWaiterId() == b.getWaiterId() &&
+                 a.getTimestamp().toEpochSeconds() == b.getTimestamp().toEpochSeconds() &&
+                 fromFile.getPatron(a.getPatronId()).getName() == fromFeed.getPatron(b.getPatronId()).getName();
+    }
+    if (in) {
+        fclose(in);
+    }
+    remove(BENCH_ORDERS_CSV);
+    cout << "Fed at " << fixed << setprecision(0) << rate << " orders/s in bursts of " << burst
+         << "; all orders in, chunked export matches: " << (ok ? "ok" : "FAILED") << endl;
+    cout << "Quoted fields spanning lines, file against feed: " << (feedOk ? "ok" : "FAILED") << endl;
+    cout << "p99 with a chunked export " << fixed << setprecision(2) << slowdown << "x the no-export p99" << endl;
+    return ok && feedOk;
+}
+
+// Chain reports over a simulated chain: the cost of a query should follow
+// the branch-days it covers, not the history held. The per-branch sums are
+// checked against a plain loop over every order of the covered shards.
+bool benchChain(int branchCount, int days, uint64_t seed, BenchSuite& suite) {
+    SimulationConfig config;
+    config.days = days;
+    config.seed = seed;
+    RestaurantGroup group(0);
+    auto start = chrono::steady_clock::now();
+    runChainSimulation(group, config, branchCount);
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << group.getShardCount() << " branch-days, " << group.getOrderCount() << " orders simulated on "
+         << group.getPool().size() << " threads in " << fixed << setprecision(1) << buildSeconds * 1e3 << " ms"
+         << endl;
+    
+    bool ok = true;
+    const int64_t lastDay = group.getLastDay();
+    const int spans[] = {1, 7, days};
+    suite.printHeader();
+    for (int span : spans) {
+        const int64_t fromDay = lastDay - span + 1;
+        vector<BranchSales> sales;
+        suite.run("chain sales, last " + to_string(span) + (span == 1 ? " day" : " days"), [&]() {
+            group.scanSales(fromDay, lastDay, sales);
+            cout << sales.size();
+        }, static_cast<size_t>(branchCount) * span);
+        
+        group.scanSales(fromDay, lastDay, sales);
+        for (uint32_t b = 0; ok && b < group.getBranchCount(); b++) {
+            KahanSum expected;
+            uint64_t orders = 0, waiterOrders = 0;
+            for (int64_t day = fromDay; day <= lastDay; day++) {
+                const OrderStore& store = group.shard(b, day).getOrders();
+                for (size_t row = 0; row < store.size(); row++) {
+                    expected.add(store.amount(row));
+                }
+                orders += store.size();
+            }
+            KahanSum actual;
+            for (size_t w = 0; w < sales[b].waiterSales.size(); w++) {
+                actual.add(sales[b].waiterSales[w].value());
+                waiterOrders += sales[b].waiterCounts[w];
+            }
+            double typeTotal = sales[b].typeSales[0].value() + sales[b].typeSales[1].value();
+            ok = sales[b].shards == static_cast<size_t>(span) && waiterOrders == orders &&
+                 sales[b].typeCounts[0] + sales[b].typeCounts[1] == orders &&
+                 fabs(typeTotal - expected.value()) <= 1e-9 * expected.value() &&
+                 fabs(actual.value() - expected.value()) <= 1e-9 * expected.value();
+        }
+        
+        // Per-order commission rules go through the aggregation engine per shard
+        vector<BranchSales> tiered;
+        group.scanCommission<TieredCommission>(fromDay, lastDay, tiered);
+        for (uint32_t b = 0; ok && b < group.getBranchCount(); b++) {
+            vector<KahanSum> expected(tiered[b].waiterCommission.size());
+            for (int64_t day = fromDay; day <= lastDay; day++) {
+                const OrderStore& store = group.shard(b, day).getOrders();
+                for (size_t row = 0; row < store.size(); row++) {
+                    expected[store.waiterId(row)].add(TieredCommission::onOrder(store.type(row), store.amount(row)));
+                }
+            }
+            for (size_t w = 0; ok && w < expected.size(); w++) {
+                double sold = sales[b].waiterSales[w].value();
+                ok = tiered[b].waiterCounts[w] == sales[b].waiterCounts[w] &&
+                     fabs(tiered[b].waiterSales[w].value() - sold) <= 1e-9 * max(1.0, sold) &&
+                     fabs(tiered[b].waiterCommission[w].value() - expected[w].value()) <=
+                         1e-9 * max(1.0, expected[w].value());
+            }
+        }
+    }
+    cout << "Time per branch-day scanned; sums and tiered commission checked against every order: "
+         << (ok ? "ok" : "FAILED") << endl;
+    return ok;
+}
+
+void printBenchUsage(const char* program) {
+    cerr << "Usage: " << program << " [options]" << endl;
+    cerr << "  --orders=N                   Orders in the synthetic workload (default 100000)" << endl;
+    cerr << "  --waiters=N                  Waiters in the workload (default 20)" << endl;
+    cerr << "  --patrons=N                  Distinct patrons in the workload (default 5000)" << endl;
+    cerr << "  --days=N                     Days the orders are spread over (default 7)" << endl;
+    cerr << "  --seed=S                     Workload seed (default 42)" << endl;
+    cerr << "  --warmup=N                   Untimed samples per benchmark (default 2)" << endl;
+    cerr << "  --repetitions=N              Timed samples per benchmark (default 15)" << endl;
+    cerr << "  --kernel-orders=N            Orders for the sales kernel section (default 100000000)" << endl;
+    cerr << "  --only=SECTION[,SECTION...]  Run only these sections: reports, ingest, journal," << endl;
+    cerr << "                               allocations, kernels, quantiles, registry, intake," << endl;
+    cerr << "                               snapshot, chain, aggregate, items, pipeline, totals" << endl;
+    cerr << "  --json=FILE                  Also write the results to FILE as JSON" << endl;
+    cerr << "  --help                       Show this help message" << endl;
+}
+
+bool countOption(const char* name, const string& value, size_t& result) {
+    char* end;
+    unsigned long long parsed = strtoull(value.c_str(), &end, 10);
+    if (value.empty() || value[0] == '-' || *end != '\0' || parsed == 0 || parsed > 10000000000ULL) {
+        cerr << "Invalid " << name << ": " << value << endl;
+        return false;
+    }
+    result = static_cast<size_t>(parsed);
+    return true;
+}
+
+bool parseBenchOptions(int argc, char* argv[], BenchOptions& options) {
+    const char* const sections[] = {"reports", "ingest", "journal", "allocations", "kernels", "quantiles",
+                                    "registry", "intake", "snapshot", "chain", "aggregate", "items", "pipeline",
+                                    "totals"};
+    for (int i = 1; i < argc; i++) {
+        string value;
+        size_t count;
+        if (optionValue(argc, argv, i, "--orders", value)) {
+            if (!countOption("--orders", value, options.workload.orders)) {
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--kernel-orders", value)) {
+            if (!countOption("--kernel-orders", value, options.kernelOrders)) {
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--patrons", value)) {
+            if (!countOption("--patrons", value, count) || count > 100000000) {
+                return false;
+            }
+            options.workload.patrons = static_cast<int>(count);
+        } else if (optionValue(argc, argv, i, "--waiters", value)) {
+            if (!positiveOption("--waiters", value, options.workload.waiters)) {
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--days", value)) {
+            if (!positiveOption("--days", value, options.workload.days)) {
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--repetitions", value)) {
+            if (!positiveOption("--repetitions", value, options.repetitions)) {
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--warmup", value)) {
+            // Zero is allowed: calibration alone then warms up
+            if (value != "0" && !positiveOption("--warmup", value, options.warmup)) {
+                return false;
+            }
+            if (value == "0") {
+                options.warmup = 0;
+            }
+        } else if (optionValue(argc, argv, i, "--seed", value)) {
+            char* end;
+            options.workload.seed = strtoull(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0') {
+                cerr << "Invalid --seed: " << value << endl;
+                return false;
+            }
+        } else if (optionValue(argc, argv, i, "--json", value)) {
+            options.jsonPath = value;
+        } else if (optionValue(argc, argv, i, "--only", value)) {
+            size_t begin = 0;
+            while (begin <= value.size()) {
+                size_t comma = value.find(',', begin);
+                if (comma == string::npos) {
+                    comma = value.size();
+                }
+                string section = value.substr(begin, comma - begin);
+                const size_t sectionCount = sizeof(sections) / sizeof(sections[0]);
+                if (find(sections, sections + sectionCount, section) == sections + sectionCount) {
+                    cerr << "Unknown section: " << section << endl;
+                    return false;
+                }
+                options.sections.push_back(section);
+                begin = comma + 1;
+            }
+        } else {
+            if (string(argv[i]) != "--help") {
+                cerr << "Unknown option: " << argv[i] << endl;
+            }
+            printBenchUsage(argv[0]);
+            return false;
+        }
     }
+    return true;
+}
+
+void printSection(const string& title) {
+    cout << endl << title << endl;
+    cout << Rule(72, '-') << endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseBenchOptions(argc, argv, options)) {
+        return 1;
+    }
+    const BenchWorkload& workload = options.workload;
+    BenchSuite suite(options);
+    WorkloadGenerator generator(workload);
+    
+    cout << "Restaurant Simulation Benchmarks (" << workload.orders << " orders, " << workload.waiters << " waiters, "
+         << workload.patrons << " patrons over " << workload.days << " days, seed " << workload.seed << ")" << endl;
+    cout << "Median and MAD of " << options.repetitions << " samples after " << options.warmup
+         << " warmup samples; sales kernels: " << salesKernels().name << endl;
+    
+    Restaurant restaurant("Benchmark Kitchen");
+    const bool needsRestaurant = options.runs("reports") || options.runs("ingest") || options.runs("allocations") ||
+                                 options.runs("snapshot") || options.runs("aggregate") || options.runs("items");
+    if (needsRestaurant) {
+        createBenchData(restaurant, workload);
+    }
+    
+    if (options.runs("reports")) {
+        printSection("Reports and queries");
+        suite.printHeader();
+        ReportWriter sink(NULL_DEVICE);
+        suite.run("reportOrderCounts", [&]() { restaurant.reportOrderCounts(sink); });
+        suite.run("reportTotalSales", [&]() { restaurant.reportTotalSales(sink); });
+        suite.run("reportWaiterSales", [&]() { restaurant.reportWaiterSales(sink); });
+        suite.run("reportWaiterCommission", [&]() { restaurant.reportWaiterCommission(sink); });
+        suite.run("reportTopPatrons", [&]() { restaurant.reportTopPatrons(sink); });
+        suite.run("reportOrderValues", [&]() { restaurant.reportOrderValues(sink); });
+        suite.run("reportSalesByHour", [&]() { restaurant.reportSalesByHour(sink); });
+        suite.run("displayRestaurantStats", [&]() { displayRestaurantStats(restaurant); });
+        suite.run("getOrdersBetween (shift)", [&]() {
+            // End-of-shift slice: 14:00-22:00 on the last day of the workload
+            int64_t from = generator.getStart() + (workload.days - 1) * 86400LL + 14 * 3600;
+            double total = 0.0;
+            for (Order order : restaurant.getOrdersBetween(from, from + 8 * 3600)) {
+                total += order.getTotalAmount();
+            }
+            cout << total;
+        });
+        suite.run("Timestamp::toString", [&]() {
+            cout << Timestamp(2024, 12, 15, 13, 15, 42).toString();
+        });
+        suite.run("Timestamp::formatTo", [&]() {
+            char buffer[Timestamp::FORMAT_BUFFER_SIZE];
+            Timestamp(2024, 12, 15, 13, 15, 42).formatTo(buffer);
+            cout << buffer;
+        });
+        suite.run("Timestamp::now", [&]() {
+            cout << Timestamp().getHour();
+        });
+        suite.run("displayAllOrders (iostream)", [&]() {
+            ofstream file(NULL_DEVICE);
+            displayAllOrdersIostream(restaurant, file);
+        });
+        suite.run("displayAllOrders", [&]() {
+            ReportWriter file(NULL_DEVICE);
+            restaurant.displayAllOrders(file);
+        });
+    }
+    
+    if (options.runs("ingest")) {
+        printSection("Ingest (per order)");
+        suite.printHeader();
+        suite.run("WorkloadGenerator::order", [&]() {
+            WorkloadGenerator::GeneratedOrder order;
+            double total = 0.0;
+            for (size_t i = 0; i < workload.orders; i++) {
+                generator.order(i, order);
+                total += order.amount;
+            }
+            cout << total;
+        }, workload.orders);
+        // Includes generating the orders, timed above
+        suite.run("addOrder", [&]() {
+            Restaurant ingested("Ingest Kitchen");
+            createBenchData(ingested, workload);
+        }, workload.orders);
+        // Same with the intake latency histogram and report timers recording
+        Metrics::enable();
+        suite.run("addOrder (metrics on)", [&]() {
+            Restaurant ingested("Ingest Kitchen");
+            createBenchData(ingested, workload);
+        }, workload.orders);
+        suite.run("writeMetrics", [&]() {
+            ReportWriter out(NULL_DEVICE);
+            writeMetrics(out);
+        });
+        Metrics::disable();
+        {
+            ReportWriter csv(BENCH_ORDERS_CSV);
+            exportCsv(restaurant, csv);
+        }
+        suite.run("ingestOrders (CSV)", [&]() {
+            Restaurant ingested("Ingest Kitchen");
+            IngestResult result;
+            ingestOrders(ingested, BENCH_ORDERS_CSV, result);
+        }, workload.orders);
+        remove(BENCH_ORDERS_CSV);
+    }
+    
+    if (options.runs("journal")) {
+        // Journal the workload once per workload, then time replaying it from scratch
+        printSection("Journal replay (per order)");
+        suite.printHeader();
+        const string journalPath = string(BENCH_JOURNAL) + "/" + to_string(workload.orders) + "-" +
+                                   to_string(workload.waiters) + "-" + to_string(workload.patrons) + "-" +
+                                   to_string(workload.days) + "-" + to_string(workload.seed);
+        {
+            OrderJournal journal(journalPath);
+            Restaurant journaled("Benchmark Kitchen");
+            size_t replayed;
+            if (!makeDirectory(BENCH_JOURNAL) || !journal.open(journaled, replayed)) {
+                cerr << "Cannot create " << journalPath << endl;
+                return 1;
+            }
+            if (replayed == 0) {
+                journaled.attachJournal(&journal);
+                createBenchData(journaled, workload);
+            } else if (replayed != workload.orders) {
+                cerr << journalPath << " holds " << replayed << " orders; remove it (make clean)" << endl;
+                return 1;
+            }
+        }
+        suite.run("journal replay", [&]() {
+            OrderJournal journal(journalPath);
+            Restaurant replayedRestaurant("Benchmark Kitchen");
+            size_t replayed;
+            journal.open(replayedRestaurant, replayed);
+            cout << replayed;
+        }, workload.orders);
+    }
+    
+    if (options.runs("allocations")) {
+        printSection("Heap allocations per order (" + to_string(workload.orders) +
+                     " orders a day, closeDay in between)");
+        benchDayAllocations(restaurant, suite);
+    }
+    
+    if (options.runs("kernels")) {
+        printSection("Sales kernels over " + to_string(options.kernelOrders) + " orders (GB/s read, best of 3)");
+        cout << setw(10) << left << "Kernels" << setw(11) << right << "by type" << setw(11) << right << "by waiter"
+             << setw(11) << right << "by hour" << endl;
+        cout << Rule(72, '-') << endl;
+        suite.check("kernels", benchSalesKernels(options.kernelOrders, workload.seed, suite));
+    }
+    
+    if (options.runs("quantiles")) {
+        const size_t quantileSamples = 1000000;
+        printSection("Order value quantiles (" + to_string(quantileSamples) + " amounts, 4 merged histograms)");
+        cout << setw(8) << left << "Quantile" << setw(12) << right << "exact" << setw(12) << right << "histogram"
+             << setw(12) << right << "error" << endl;
+        cout << Rule(72, '-') << endl;
+        suite.check("quantiles", benchQuantileAccuracy(quantileSamples, suite));
+    }
+    
+    if (options.runs("registry")) {
+        const size_t registryPatrons = 1000000;
+        printSection("Patron registry (" + to_string(registryPatrons) + " distinct patrons, every tenth returns)");
+        suite.check("registry", benchPatronRegistry(registryPatrons, suite));
+    }
+    
+    if (options.runs("intake")) {
+        printSection("Concurrent intake (orders lost, duplicate ids and torn snapshots fail the run)");
+        cout << setw(9) << right << "Writers" << setw(12) << right << "Orders" << setw(16) << right << "orders/s"
+             << setw(12) << right << "Snapshots" << endl;
+        cout << Rule(72, '-') << endl;
+        bool intakeOk = true;
+        const int writerCounts[] = {1, 4, 16, 64};
+        for (int writers : writerCounts) {
+            intakeOk = benchConcurrentIntake(writers, 512000, suite) && intakeOk;
+        }
+        suite.check("intake", intakeOk);
+    }
+    
+    if (options.runs("snapshot")) {
+        printSection("Snapshot of the workload (best of 3; restore should keep up with copying the file)");
+        suite.check("snapshot", benchSnapshot(restaurant, suite));
+    }
+    
+    if (options.runs("chain")) {
+        const int chainBranches = 200, chainDays = 30;
+        printSection("Restaurant chain (" + to_string(chainBranches) + " branches, " + to_string(chainDays) +
+                     " simulated days)");
+        suite.check("chain", benchChain(chainBranches, chainDays, workload.seed, suite));
+    }
+    
+    if (options.runs("aggregate")) {
+        printSection("Aggregation engine (" + to_string(workload.orders) + " orders)");
+        suite.check("aggregate", benchAggregation(restaurant, suite));
+    }
+    
+    if (options.runs("items")) {
+        printSection("Line items (" + to_string(workload.orders) + " orders)");
+        suite.check("items", benchItems(restaurant, suite));
+    }
+    
+    if (options.runs("pipeline")) {
+        printSection("Order pipeline (" + to_string(workload.orders) + " orders, then a paced feed)");
+        suite.check("pipeline", benchPipeline(workload, 20000.0, 0.5, suite));
+    }
+    
+    if (options.runs("totals")) {
+        printSection("Running totals against a rescan of the order columns");
+        cout << setw(28) << left << "After" << setw(10) << right << "Orders" << endl;
+        cout << Rule(72, '-') << endl;
+        suite.check("totals", benchRunningTotals(workload));
+    }
+    
+    if (!options.jsonPath.empty()) {
+        if (!suite.writeJson(options.jsonPath)) {
+            cerr << "Cannot write " << options.jsonPath << endl;
+            return 1;
+        }
+        cout << endl << "Results written to " << options.jsonPath << endl;
+    }
+    return suite.passed() ? 0 : 1;
+}
+#else
+int main(int argc, char* argv[]) {
+    CommandLineOptions options;
+    if (!parseCommandLine(argc, argv, options)) {
+        return 1;
+    }
+    if (!options.inspectPath.empty()) {
+        return inspectColumnarDump(options.inspectPath);
+    }
+    // Declared before everything it measures, so the final dump sees it all
+    MetricsFile metricsFile(options.metricsPath);
+    MetricsServer metricsServer;
+    if (!options.metricsPath.empty() || !options.metricsSocket.empty()) {
+        Metrics::enable();
+    }
+    if (!options.metricsSocket.empty() && !metricsServer.start(options.metricsSocket)) {
+        return 1;
+    }
+    if (!options.snapshotPath.empty() && !options.journalPath.empty()) {
+        cerr << "--snapshot cannot be combined with --journal" << endl;
+        return 1;
+    }
+    unique_ptr<OrderJournal> journal;
+    if (!options.journalPath.empty()) {
+        journal.reset(new OrderJournal(options.journalPath, options.journalSegmentBytes));
+    }
+    if (options.replications > 0) {
+        return runReplicationReport(options);
+    }
+    if (options.simulate) {
+        if (options.rosters.size() > 1) {
+            cerr << "--simulate takes a single --waiters value" << endl;
+            return 1;
+        }
+        if (journal || !options.ingestPath.empty()) {
+            cerr << "--simulate cannot be combined with --journal or --ingest" << endl;
+            return 1;
+        }
+        if (options.branches > 0) {
+            if (!options.snapshotPath.empty()) {
+                cerr << "--branches cannot be combined with --snapshot" << endl;
+                return 1;
+            }
+            return runChainReports(options);
+        }
+        return runSimulationReports(options);
+    }
+    if (options.branches > 0 || options.lastDays > 0) {
+        cerr << "--branches and --last-days need --simulate" << endl;
+        return 1;
+    }
+    if (!options.ingestPath.empty()) {
+        return runIngest(options, journal.get());
+    }
+    if (options.exportReports) {
+        Restaurant restaurant("Mama's Kitchen - Johannesburg");
+        restaurant.setCommissionRule(options.commissionRule);
+        if (!loadRestaurant(restaurant, journal.get(), options.snapshotPath)) {
+            return 1;
+        }
+        return runExport(restaurant, options);
+    }
+    
     cout << "Restaurant Simulation Program" << endl;
     cout << "Algorithm Analysis and Program Design - Data Structures" << endl;
-    cout << string(50, '=') << endl;
+    cout << Rule(50, '=') << endl;
     
     // Create restaurant
     Restaurant restaurant("Mama's Kitchen - Johannesburg");
+    restaurant.setCommissionRule(options.commissionRule);
     
-    // Create sample data
-    createSampleData(restaurant);
+    // Replay the journal, restore the snapshot or create sample data
+    if (!loadRestaurant(restaurant, journal.get(), options.snapshotPath)) {
+        return 1;
+    }
     
     cout << "✅ Sample data loaded successfully!" << endl;
     cout << "Welcome to " << restaurant.getName() << " Management System" << endl;
     
+    BackgroundSnapshot snapshot;
+    MenuSession session;
+    session.metricsFile = &metricsFile;
+    session.snapshot = &snapshot;
+    session.snapshotPath = options.snapshotPath.empty() ? DEFAULT_SNAPSHOT_PATH : options.snapshotPath;
+    
     int choice;
     do {
+        if (session.snapshotPending && !snapshot.isRunning()) {
+            session.snapshotPending = false;
+            cout << (snapshot.wait() ? "\nSnapshot saved to " : "\nSnapshot failed: ") << snapshot.getPath() << endl;
+        }
         displayMainMenu();
         choice = getValidChoice();
-        processMenuChoice(choice, restaurant);
+        processMenuChoice(choice, restaurant, &session);
+        if (journal && !journal->commit()) {
+            // Carrying on would take orders that are never saved
+            cerr << "\nJournal write failed in " << journal->getDirectory() << ": " << journal->getErrorText()
+                 << "; stopping. Orders up to the last successful save are in the journal." << endl;
+            snapshot.wait();
+            return 1;
+        }
+        metricsFile.update();
         
         if (choice != 0 && choice != 10) {
             cout << "\nPress Enter to continue...";
@@ -576,5 +9442,7 @@ int main() {
         }
     } while (choice != 0);
     
-    return 0;
-} 
\ No newline at end of file
+    snapshot.wait();
+    return saveSnapshot(restaurant, options.snapshotPath) ? 0 : 1;
+} 
+#endif